@@ -3,7 +3,6 @@
 #include <QtCore/QObject>
 #include <QtCore/QUuid>
 #include <QtCore/QVariant>
-#include <QUndoCommand>
 
 #include "PortType.hpp"
 #include "NodeData.hpp"
@@ -11,8 +10,10 @@
 #include "Serializable.hpp"
 #include "ConnectionState.hpp"
 #include "ConnectionGeometry.hpp"
+#include "ItemGraphics.hpp"
 #include "TypeConverter.hpp"
 #include "QUuidStdHash.hpp"
+#include "SlotMap.hpp"
 #include "memory.hpp"
 
 class QPointF;
@@ -22,17 +23,15 @@ namespace QtNodes
 
 class Node;
 class NodeData;
-class ConnectionGraphicsObject;
-class FlowScene;
+class FlowGraph;
 
-///
+/// Not a QObject: a dense graph holds many connections, so they report
+/// completion to their FlowGraph directly. Their graphics object is
+/// created by the FlowScene showing them, if any.
 class Connection
-  : public QObject
-  , public Serializable
+  : public Serializable
 {
 
-  Q_OBJECT
-
 public:
 
   /// New Connection is attached to the port of the given Node.
@@ -52,7 +51,7 @@ public:
   Connection(const Connection&) = delete;
   Connection operator=(const Connection&) = delete;
 
-  ~Connection() override;
+  ~Connection();
 
 public:
 
@@ -64,6 +63,14 @@ public:
   QUuid
   id() const;
 
+  /// Handle into the FlowGraph storage, assigned by the graph.
+  /// Unlike the id, it changes when the item is restored.
+  SlotHandle
+  handle() const;
+
+  void
+  setHandle(SlotHandle handle);
+
   /// Remembers the end being dragged.
   /// Invalidates Node address.
   /// Grabs mouse.
@@ -72,9 +79,6 @@ public:
   PortType
   requiredPort() const;
 
-  void
-  setGraphicsObject(std::unique_ptr<ConnectionGraphicsObject>&& graphics);
-
   /// Assigns a node to the required port.
   /// It is assumed that there is a required port, no extra checks
   void
@@ -87,8 +91,30 @@ public:
 
 public:
 
-  ConnectionGraphicsObject&
-  getConnectionGraphicsObject() const;
+  /// Null unless a FlowScene shows the connection
+  ConnectionGraphics *
+  graphics() const;
+
+  void
+  setGraphics(std::unique_ptr<ConnectionGraphics>&& graphics);
+
+  /// The NodeEditor library reaches a FlowScene's graphics object with
+  /// connectionGraphicsObject(Connection const&), see
+  /// ConnectionGraphicsObject.hpp
+  bool
+  hasGraphicsObject() const;
+
+  /// The graph of the attached node(s). Needs at least one end.
+  FlowGraph&
+  getGraph() const;
+
+  /// Whether the graph emitted connectionCreated for this connection.
+  /// From then on, losing an end emits connectionDeleted.
+  bool
+  announced() const;
+
+  void
+  setAnnounced(bool announced);
 
   ConnectionState const &
   connectionState() const;
@@ -127,29 +153,37 @@ public:
 
 public: // data propagation
 
+  /// Hands the data to the IN node. In pull mode the IN port is
+  /// only marked dirty.
   void
   setInData(std::shared_ptr<NodeData> nodeData) const;
 
+  /// Fetches the current output of the OUT node and hands it to the IN
+  /// node, whatever the graph's propagation mode.
+  void
+  pull() const;
+
   void
   propagateData( std::shared_ptr<NodeData> nodeData ) const;
 
   void
   propagateEmptyData() const;
 
-Q_SIGNALS:
+private:
 
-  void
-  connectionCompleted(Connection const&) const;
+  void commandSetup();
 
-  void
-  connectionMadeIncomplete(Connection const&) const;
+  void connectConverter();
 
-private:
+  void deliverData(std::shared_ptr<NodeData> nodeData) const;
 
-  void commandSetup();
+  /// Stops counting the conversion under way, if any
+  void endConversion() const;
 
   QUuid _uid;
 
+  SlotHandle _handle;
+
 private:
 
   Node* _outNode = nullptr;
@@ -163,49 +197,19 @@ private:
   ConnectionState    _connectionState;
   ConnectionGeometry _connectionGeometry;
 
-  std::unique_ptr<ConnectionGraphicsObject>_connectionGraphicsObject;
-
   SharedTypeConverter _converter;
 
-private:
+  /// Context of the converter's finished connection, only made with a
+  /// converter. Connections are not QObjects.
+  std::unique_ptr<QObject> _converterContext;
 
-Q_SIGNALS:
+  bool _announced = false;
 
-  void
-  updated(Connection& conn) const;
-};
-
-
-/*
- * Commands
- */
+  /// Handed data to the converter, which has not reported back yet
+  mutable bool _converting = false;
 
-class ConnectionAddCommand : public QUndoCommand
-{
-public:
-	ConnectionAddCommand( Connection & c, QUndoCommand * parent = nullptr );
-
-	void undo() override;
-	void redo() override;
-
-private:
-	FlowScene & scene;
-	QJsonObject connectionJson; //Stores everything needed to reconstruct
-	bool firstRun = true;
-};
-
-class ConnectionRemoveCommand : public QUndoCommand
-{
-public:
-	ConnectionRemoveCommand( Connection & c, QUndoCommand * parent = nullptr );
-
-	void undo() override;
-	void redo() override;
-
-private:
-	FlowScene & scene;
-	QJsonObject connectionJson; //Stores everything needed to reconstruct
-	bool firstRun = true;
+  /// Last, so it goes before the state it shows
+  std::unique_ptr<ConnectionGraphics> _graphics;
 };
 
 }
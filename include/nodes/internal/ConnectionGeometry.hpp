@@ -4,6 +4,8 @@
 
 #include <QtCore/QPointF>
 #include <QtCore/QRectF>
+#include <QtGui/QPainterPath>
+#include <QtGui/QPolygonF>
 
 #include <iostream>
 
@@ -33,6 +35,20 @@ public:
   std::pair<QPointF, QPointF>
   pointsC1C2() const;
 
+  /// The curve from source to sink
+  QPainterPath const &
+  cubicPath() const;
+
+  /// The curve as polylineSegments straight segments of equal length
+  QPolygonF const &
+  polyline() const;
+
+  /// Area around the curve taking clicks
+  QPainterPath const &
+  stroke() const;
+
+  static constexpr int polylineSegments = 60;
+
   QPointF
   source() const { return _out; }
   QPointF
@@ -56,5 +72,20 @@ private:
   double _lineWidth;
 
   bool _hovered;
+
+  // Built on first use after an end point moved
+
+  mutable bool         _pathValid;
+  mutable QPainterPath _cubicPath;
+  mutable QPolygonF    _polyline;
+
+  mutable bool         _strokeValid;
+  mutable QPainterPath _stroke;
+
+  void
+  updatePath() const;
+
+  void
+  invalidate();
 };
 }
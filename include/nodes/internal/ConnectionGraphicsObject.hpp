@@ -4,6 +4,8 @@
 
 #include <QtWidgets/QGraphicsObject>
 
+#include "ItemGraphics.hpp"
+
 class QGraphicsSceneMouseEvent;
 
 namespace QtNodes
@@ -14,9 +16,11 @@ class Connection;
 class ConnectionGeometry;
 class Node;
 
-/// Graphic Object for connection. Adds itself to scene
+/// Graphic Object for connection. Adds itself to scene, the connection
+/// owns it, see FlowScene
 class ConnectionGraphicsObject
   : public QGraphicsObject
+  , public ConnectionGraphics
 {
   Q_OBJECT
 
@@ -50,6 +54,16 @@ public:
   void
   move();
 
+  /// Schedules a repaint, of the scene's connection layer when it
+  /// draws the connection. Use instead of update().
+  void
+  repaint();
+
+  /// Leaves painting to the scene's connection layer, see
+  /// FlowScene::setConnectionLayerEnabled()
+  void
+  setDrawnByLayer(bool drawnByLayer);
+
   void
   lock(bool locked);
 
@@ -78,6 +92,9 @@ protected:
   void
   hoverLeaveEvent(QGraphicsSceneHoverEvent* event) override;
 
+  QVariant
+  itemChange(GraphicsItemChange change, const QVariant &value) override;
+
 private:
 
   void
@@ -88,5 +105,14 @@ private:
   FlowScene & _scene;
 
   Connection& _connection;
+
+  /// Scene area of the last repaint through the connection layer, which
+  /// the next one clears
+  QRectF _layerRect;
 };
+
+/// The graphics object of a connection shown by a FlowScene; asserts there
+/// is one
+ConnectionGraphicsObject &
+connectionGraphicsObject(Connection const & connection);
 }
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QPointF>
+#include <QtCore/QUuid>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <tuple>
+#include <functional>
+
+#include "QUuidStdHash.hpp"
+#include "DataModelRegistry.hpp"
+#include "TypeConverter.hpp"
+#include "SlotMap.hpp"
+#include "memory.hpp"
+
+namespace QtNodes
+{
+
+class NodeDataModel;
+class Node;
+class Connection;
+class TopologicalScheduler;
+class DataflowExecutor;
+class BlockPool;
+class UndoPayloadStore;
+class SceneJournal;
+class GraphFrontEnd;
+
+/// Holds the nodes and connections, propagates their data and
+/// serializes them. Needs no QtWidgets: on its own it evaluates graphs
+/// without a window, under a QCoreApplication. A FlowScene shows it.
+class FlowGraph
+  : public QObject
+{
+  Q_OBJECT
+public:
+
+  FlowGraph(std::shared_ptr<DataModelRegistry> registry,
+            QObject * parent = Q_NULLPTR);
+
+  FlowGraph(QObject * parent = Q_NULLPTR);
+
+  ~FlowGraph();
+
+public:
+
+  /// Told about items as they are added, see GraphFrontEnd. Null when
+  /// nothing shows the graph.
+  void setFrontEnd(GraphFrontEnd * frontEnd);
+
+  GraphFrontEnd * frontEnd() const;
+
+public:
+
+  enum class ExecutionMode
+  {
+    /// Models compute on the GUI thread, as data arrives
+    Synchronous,
+    /// Models reporting NodeDataModel::threadSafe() compute on a thread pool
+    Parallel
+  };
+
+  void setExecutionMode(ExecutionMode mode);
+
+  ExecutionMode executionMode() const;
+
+  /// Null unless the execution mode is Parallel
+  DataflowExecutor * executor() const;
+
+  /// Times every synchronous NodeDataModel::setInData call, see
+  /// Node::evaluationTime()
+  void setProfiling(bool profiling);
+
+  bool profiling() const;
+
+  enum class PropagationMode
+  {
+    /// New output data is pushed downstream right away
+    Push,
+    /// New output data only marks downstream nodes dirty. Sinks, selected
+    /// and visible nodes pull what they need.
+    Pull,
+    /// Output updates raised within one event loop iteration are pushed
+    /// as one wave, once per port, in topological order
+    Coalesced
+  };
+
+  /// Leaving Pull evaluates every dirty node, leaving
+  /// Coalesced pushes the queued updates.
+  void setPropagationMode(PropagationMode mode);
+
+  PropagationMode propagationMode() const;
+
+  /// Brings the node's inputs up to date, evaluating only the
+  /// dirty nodes upstream of it.
+  void pullNode(Node& node);
+
+  /// Pulls the node once control returns to the event loop.
+  void requestPull(Node& node);
+
+  /// Coalesced mode: pushes the port's data with the next wave.
+  void queueDataUpdate(Node& node, PortIndex index);
+
+  /// Number of dataUpdated emissions absorbed by an already queued update.
+  std::size_t coalescedUpdateCount() const;
+
+  void resetCoalescedUpdateCount();
+
+  /// True while output updates are queued rather than pushed: in coalesced
+  /// mode, during a batch, and while a queued wave is being pushed.
+  bool queuesDataUpdates() const;
+
+  /// True once nothing is left to evaluate: no open batch or streaming
+  /// load, no queued wave or pull, no task on the executor and no type
+  /// conversion under way. Until then results still travel through the
+  /// event loop. Dirty nodes nobody pulls do not count.
+  bool isIdle() const;
+
+public:
+
+  /// Starts a batch of graph mutations. Until the matching commitBatch(),
+  /// new nodes and connections are not shown, their data is not
+  /// propagated and nodeCreated/connectionCreated are held back.
+  /// Batches nest.
+  void beginBatch();
+
+  /// Shows the batch's items, emits the held back signals, then pushes
+  /// every updated output port once, in topological order.
+  void commitBatch();
+
+  bool isBatching() const;
+
+  /// Loads restore the whole graph in a batch, so every output is pushed
+  /// once, in topological order, after the graph is complete.
+  struct LoadStatistics
+  {
+    /// Inputs fed by the ordered pass
+    std::size_t evaluations = 0;
+
+    /// Inputs that pushing every update on arrival would have fed again.
+    /// The cascades such pushes would have caused are not counted.
+    std::size_t savedEvaluations = 0;
+  };
+
+  LoadStatistics const & lastLoadStatistics() const;
+
+  /// Bytes of the pooled block holding a connection together with its
+  /// shared_ptr control block, zero before the first connection
+  std::size_t connectionBlockSize() const;
+
+public:
+
+  /// A connection with one end, being dragged out of the node's port
+  std::shared_ptr<Connection>
+  createConnection(PortType connectedPort,
+                   Node& node,
+                   PortIndex portIndex);
+
+  std::shared_ptr<Connection>
+  createConnection(Node& nodeIn,
+                   PortIndex portIndexIn,
+                   Node& nodeOut,
+                   PortIndex portIndexOut,
+				   SharedTypeConverter converter = nullptr,
+				   QUuid id = QUuid(),
+				   bool sendSignal = false);
+
+  std::shared_ptr<Connection> restoreConnection(QJsonObject const &connectionJson, bool sendSignal = false);
+
+  void deleteConnection(Connection& connection, bool sendSignal = false);
+
+  /// Called by a stored connection whose second end just got attached.
+  /// Orders it and emits connectionCreated.
+  void connectionMadeComplete(Connection& connection);
+
+  /// Called by a complete connection about to lose an end, or destroyed.
+  /// Drops its edge if still stored. Emits connectionDeleted if
+  /// connectionCreated was emitted for it, and clears its announced flag.
+  void connectionMadeIncomplete(Connection& connection);
+
+  /// Called by a connection handing data to its type converter, and
+  /// once the converter reported back or the result has nowhere to go
+  void conversionStarted();
+
+  void conversionFinished();
+
+  Node&createNode(std::unique_ptr<NodeDataModel> && dataModel);
+
+  Node&restoreNode(QJsonObject const& nodeJson);
+
+  void removeNode(Node& node);
+
+  /// Removes the nodes, their connections and the given connections in one
+  /// batch. Inputs left unconnected get empty data once, and what they
+  /// recompute is pushed downstream in a single wave.
+  void removeNodes(std::vector<Node*> const & nodes,
+                   std::vector<Connection*> const & connections = {});
+
+  /// True for the nodes of a removeNodes() call in progress
+  bool isRemoving(Node const & node) const;
+
+  DataModelRegistry&registry() const;
+
+  void setRegistry(std::shared_ptr<DataModelRegistry> registry);
+
+  void iterateOverNodes(std::function<void(Node*)> const & visitor);
+
+  void iterateOverNodeData(std::function<void(NodeDataModel*)> const & visitor);
+
+  /// Visits every node after all of its upstream nodes. Nodes on a cycle, or
+  /// downstream of one, are skipped, see nodesInCycles().
+  void iterateOverNodeDataDependentOrder(std::function<void(NodeDataModel*)> const & visitor);
+
+  /// Nodes left out of the dependent order because of a cycle.
+  std::vector<Node*> nodesInCycles() const;
+
+  QPointF getNodePosition(Node const& node) const;
+
+  void setNodePosition(Node& node, QPointF const& pos) const;
+
+public:
+
+  /// Nodes in dense storage. Iteration follows the order of creation,
+  /// except that removing a node moves the last one into its place.
+  SlotMap<std::unique_ptr<Node> > const & nodes() const;
+
+  SlotMap<std::shared_ptr<Connection> > const & connections() const;
+
+  /// Null if the handle is stale.
+  Node * node(SlotHandle handle) const;
+
+  /// Looks the id up in the persistent index. Null if unknown.
+  Node * node(QUuid const & id) const;
+
+  /// Null if the handle is stale.
+  Connection * connection(SlotHandle handle) const;
+
+  /// Looks the id up in the persistent index. Null if unknown.
+  Connection * connection(QUuid const & id) const;
+
+  std::vector<Node*> allNodes() const;
+
+public:
+
+  /// Frees every node and connection without propagating empty data or
+  /// repainting. nodeDeleted and connectionDeleted are still emitted,
+  /// their slots must not change the graph. Also run on destruction.
+  void clear();
+
+  /// True while clear() runs
+  bool isTearingDown() const;
+
+  enum class SceneFormat
+  {
+    /// Indented JSON text
+    Json,
+    /// CBOR, starting with the self-describe tag. Ids are stored as
+    /// 16 byte UUIDs and numbers as binary values.
+    Cbor,
+    /// CBOR blocks of spatially grouped nodes behind an index of their
+    /// ids and positions, see load()
+    Chunked
+  };
+
+  bool save( QString filename, SceneFormat format = SceneFormat::Json ) const;
+
+  /// Detects the format of the file. A chunked file is memory mapped: the
+  /// nodes around the view saved with it are restored first, the others
+  /// stream in from the event loop, nearest first. Connections follow
+  /// their second node. The whole load is one batch: streamed nodes show
+  /// up as they come, but data is pushed once, after the last chunk, and
+  /// loadFinished() is emitted then.
+  bool load( const QString & filename );
+
+  /// True while a chunked file is streaming in
+  bool isLoading() const;
+
+  QByteArray saveToMemory( SceneFormat format = SceneFormat::Json ) const;
+
+  /// Detects the format of the data. For CBOR data, loading() receives
+  /// the top level entries other than the nodes and connections.
+  void loadFromMemory(const QByteArray& data);
+
+public:
+
+  /// Journals the changes made through the undo commands next to a
+  /// snapshot of the current graph at fileName, see SceneJournal.
+  /// clear() and loads stop the journal.
+  bool startJournal(QString const & fileName);
+
+  /// Leaves the snapshot and the journal on disk
+  void stopJournal();
+
+  /// Null unless journaling
+  SceneJournal * journal() const;
+
+  /// Folds the journal into the snapshot on a worker thread. Also runs
+  /// once the journal grows past its threshold.
+  void compactJournal();
+
+  /// Restores the snapshot at fileName and the journal after it, then
+  /// keeps journaling there
+  bool recover(QString const & fileName);
+
+public:
+
+  /// Model payloads kept by the undo commands, shared between them and
+  /// held within a memory budget
+  UndoPayloadStore & undoPayloads() const;
+
+Q_SIGNALS:
+
+  /**
+   * @brief Node has been created but not placed yet.
+   * @see nodePlaced()
+   */
+  void nodeCreated(Node &n);
+
+  /**
+   * @brief Node has been placed.
+   * @details Connect to this signal if need a correct position of node.
+   * @see nodeCreated()
+   */
+  void nodePlaced(Node &n);
+
+  void nodeDeleted(Node &n);
+
+  void connectionCreated(Connection const &c);
+  void connectionDeleted(Connection const &c);
+
+  void nodeMoved(Node& n, const QPointF& newLocation);
+
+  void saving( QJsonObject & json ) const;
+
+  void loading( const QJsonObject & json );
+
+  /// Every node of the last load is restored and has been told so
+  void loadFinished();
+
+private:
+
+  using SharedConnection = std::shared_ptr<Connection>;
+  using UniqueNode       = std::unique_ptr<Node>;
+
+  SlotMap<SharedConnection>          _connections;
+  SlotMap<UniqueNode>                _nodes;
+  std::shared_ptr<DataModelRegistry> _registry;
+
+  /// Ids outlive handles: they are saved, and the undo stack restores
+  /// items under the same id
+  std::unordered_map<QUuid, SlotHandle> _connectionIds;
+  std::unordered_map<QUuid, SlotHandle> _nodeIds;
+
+  /// Connections and their shared_ptr control blocks
+  std::shared_ptr<BlockPool> _connectionPool;
+
+  std::unique_ptr<TopologicalScheduler>       _scheduler;
+  std::unique_ptr<DataflowExecutor>           _executor;
+  std::unique_ptr<UndoPayloadStore>           _undoPayloads;
+  std::unique_ptr<SceneJournal>               _journal;
+
+  GraphFrontEnd * _frontEnd;
+
+  bool _profiling;
+
+  bool           _countingLoad;
+  LoadStatistics _loadStatistics;
+
+  bool _tearingDown;
+
+  /// Nodes of the removeNodes() call in progress
+  std::unordered_set<Node const*> _removing;
+
+  PropagationMode _propagationMode;
+
+  std::vector<SlotHandle> _pullRequests;
+
+  /// Coalesced wave, keyed by topological position first
+  std::set<std::tuple<unsigned int, Node*, PortIndex>> _queuedUpdates;
+
+  bool        _updateWaveScheduled;
+  bool        _processingUpdateWave;
+  std::size_t _coalescedUpdateCount;
+
+  /// Connections waiting for their type converter
+  std::size_t _pendingConversions;
+
+  struct Batch
+  {
+    unsigned int depth = 0;
+
+    /// Node handle, and whether nodePlaced is due as well
+    std::vector<std::pair<SlotHandle, bool>> nodes;
+    std::vector<SlotHandle>                  connections;
+  };
+
+  Batch _batch;
+
+  /// A chunked file still streaming in
+  struct ContainerLoad;
+
+  std::unique_ptr<ContainerLoad> _containerLoad;
+
+private:
+
+  Node & storeNode(UniqueNode node);
+
+  void storeConnection(SharedConnection const & connection);
+
+  /// Adds or removes the scheduler edge of a complete connection. Called
+  /// where connections are stored, completed and unlinked, not from the
+  /// signals, which batches defer.
+  void scheduleConnection(Connection const& connection);
+
+  void unscheduleConnection(Connection const& connection);
+
+  void announceConnection(Connection& connection);
+
+  /// In the layout of a JSON scene file
+  QJsonObject saveToJson() const;
+
+  /// A batch counted in the load statistics
+  void beginLoad();
+
+  void endLoad();
+
+  /// Shows the items of the open batch and emits their signals, leaving
+  /// the batch open and its updates queued
+  void publishBatch();
+
+  QByteArray saveToCbor() const;
+
+  QByteArray saveToContainer() const;
+
+  void startContainerLoad(std::unique_ptr<ContainerLoad> load, bool stream);
+
+  void restoreChunk(std::size_t chunkIndex);
+
+  void streamChunks();
+
+  void finishContainerLoad();
+
+  /// Restores the nodes and connections, returns the remaining entries
+  QJsonObject restoreFromCbor(QByteArray const& data);
+
+  void processPullRequests();
+
+  void processUpdateWave();
+
+};
+}
@@ -2,173 +2,215 @@
 
 #include <QtCore/QUuid>
 #include <QtWidgets/QGraphicsScene>
+#include <QUndoCommand>
 #include <QUndoStack>
 
-#include <unordered_map>
-#include <tuple>
 #include <functional>
 
-#include "QUuidStdHash.hpp"
+#include "FlowGraph.hpp"
+#include "GraphFrontEnd.hpp"
 #include "DataModelRegistry.hpp"
 #include "TypeConverter.hpp"
+#include "SlotMap.hpp"
+#include "UndoPayloadStore.hpp"
 #include "memory.hpp"
 
 namespace QtNodes
 {
 
 class NodeDataModel;
-class FlowItemInterface;
 class Node;
 class NodeGraphicsObject;
 class Connection;
 class ConnectionGraphicsObject;
-class NodeStyle;
-
-/// Scene holds connections and nodes.
+class SceneJournal;
+class SceneIndex;
+class SceneTiles;
+class ConnectionLayer;
+
+/// Shows a FlowGraph: every node and connection gets its graphics item
+/// as it is added. The graph is edited, saved and observed through
+/// graph(); the scene adds what needs graphics. To evaluate a graph
+/// without graphics, use a FlowGraph on its own.
 class FlowScene
   : public QGraphicsScene
+  , private GraphFrontEnd
 {
   Q_OBJECT
 public:
 
+  /// With a graph of its own
   FlowScene(std::shared_ptr<DataModelRegistry> registry,
             QObject * parent = Q_NULLPTR);
 
   FlowScene(QObject * parent = Q_NULLPTR);
 
+  /// Shows the graph, which must outlive the scene. One scene at a time:
+  /// the graph's items lose their graphics again with the scene.
+  FlowScene(FlowGraph & graph,
+            QObject * parent = Q_NULLPTR);
+
   ~FlowScene();
 
 public:
 
-  std::shared_ptr<Connection>
-  createConnection(PortType connectedPort,
-                   Node& node,
-                   PortIndex portIndex);
-
-  std::shared_ptr<Connection>
-  createConnection(Node& nodeIn,
-                   PortIndex portIndexIn,
-                   Node& nodeOut,
-                   PortIndex portIndexOut,
-				   SharedTypeConverter converter = nullptr,
-				   QUuid id = QUuid(),
-				   bool sendSignal = false);
-
-  std::shared_ptr<Connection> restoreConnection(QJsonObject const &connectionJson, bool sendSignal = false);
-
-  void deleteConnection(Connection& connection, bool sendSignal = false);
-
-  Node&createNode(std::unique_ptr<NodeDataModel> && dataModel);
-
-  Node & createNodeFromName( const QString & name, const QPointF & pos );
-
-  Node&restoreNode(QJsonObject const& nodeJson);
+  FlowGraph & graph() const;
 
-  void removeNode(Node& node);
+  /// Draws all connections from one item instead of each from its own:
+  /// every repaint strokes the connections near the exposed rect, one pen
+  /// at a time. The connection items stay, without contents, for hover,
+  /// selection and dragging.
+  void setConnectionLayerEnabled(bool enabled);
 
-  DataModelRegistry&registry() const;
+  bool connectionLayerEnabled() const;
 
-  void setRegistry(std::shared_ptr<DataModelRegistry> registry);
+  /// Null unless the connection layer is enabled
+  ConnectionLayer * connectionLayer() const;
 
-  void iterateOverNodes(std::function<void(Node*)> const & visitor);
+  /// Grid of the node and connection graphics, for hit tests and
+  /// selection. Graphics objects keep it up to date themselves.
+  SceneIndex & index() const;
 
-  void iterateOverNodeData(std::function<void(NodeDataModel*)> const & visitor);
+  /// Tile items holding the node and connection graphics, which keep
+  /// Qt's hit tests and painting from visiting every item
+  SceneTiles & tiles() const;
 
-  void iterateOverNodeDataDependentOrder(std::function<void(NodeDataModel*)> const & visitor);
-
-  QPointF getNodePosition(Node const& node) const;
+  Node & createNodeFromName( const QString & name, const QPointF & pos );
 
-  void setNodePosition(Node& node, QPointF const& pos) const;
+  std::vector<Node*> selectedNodes() const;
 
   QSizeF getNodeSize(Node const& node) const;
 
 public:
 
-  std::unordered_map<QUuid, std::unique_ptr<Node> > const & nodes() const;
+  // Loton note: This object doesn't own the undo stack, but I need to inject a pointer to my undo stack
+  // that is accessible from many objects within the flow scene. This is that injection.
+  QUndoStack * undoStack = nullptr;
 
-  std::unordered_map<QUuid, std::shared_ptr<Connection> > const & connections() const;
+Q_SIGNALS:
 
-  std::vector<Node*> allNodes() const;
+  void nodeDoubleClicked(Node& n);
 
-  std::vector<Node*> selectedNodes() const;
+  void connectionHovered(Connection& c, QPoint screenPos);
 
-public:
+  void nodeHovered(Node& n, QPoint screenPos);
 
-  void clearScene();
+  void connectionHoverLeft(Connection& c);
 
-  bool save( QString filename ) const;
+  void nodeHoverLeft(Node& n);
 
-  bool load( const QString & filename );
+  void nodeContextMenu(Node& n, const QPointF& pos);
 
-  QByteArray saveToMemory() const;
+private: // GraphFrontEnd
 
-  void loadFromMemory(const QByteArray& data);
+  void showNode(Node & node) override;
 
-public:
+  void showConnection(Connection & connection) override;
 
-  // Loton note: This object doesn't own the undo stack, but I need to inject a pointer to my undo stack
-  // that is accessible from many objects within the flow scene. This is that injection.
-  QUndoStack * undoStack = nullptr;
+  void removingItems() override;
 
-Q_SIGNALS:
+  QRectF visibleRect() const override;
 
-  /**
-   * @brief Node has been created but not on the scene yet.
-   * @see nodePlaced()
-   */
-  void nodeCreated(Node &n);
+private:
 
-  /**
-   * @brief Node has been added to the scene.
-   * @details Connect to this signal if need a correct position of node.
-   * @see nodeCreated()
-   */
-  void nodePlaced(Node &n);
+  /// Shows the graph's items and keeps showing new ones
+  void attachGraph();
 
-  void nodeDeleted(Node &n);
+  /// Null when showing a graph owned elsewhere
+  std::unique_ptr<FlowGraph> _ownedGraph;
 
-  void connectionCreated(Connection const &c);
-  void connectionDeleted(Connection const &c);
+  FlowGraph & _graph;
 
-  void nodeMoved(Node& n, const QPointF& newLocation);
+  std::unique_ptr<SceneIndex>      _index;
+  std::unique_ptr<SceneTiles>      _tiles;
+  std::unique_ptr<ConnectionLayer> _connectionLayer;
+};
 
-  void nodeDoubleClicked(Node& n);
+Node*
+locateNodeAt(QPointF scenePoint, FlowScene &scene,
+             QTransform const & viewTransform);
 
-  void connectionHovered(Connection& c, QPoint screenPos);
 
-  void nodeHovered(Node& n, QPoint screenPos);
+/*
+ * Commands
+ */
 
-  void connectionHoverLeft(Connection& c);
+class ConnectionAddCommand : public QUndoCommand
+{
+public:
+	ConnectionAddCommand( Connection & c, QUndoCommand * parent = nullptr );
 
-  void nodeHoverLeft(Node& n);
+	void undo() override;
+	void redo() override;
 
-  void nodeContextMenu(Node& n, const QPointF& pos);
+private:
+	FlowGraph & graph;
+	UndoConnectionRecord record; //Stores everything needed to reconstruct
+	bool firstRun = true;
+};
 
-  void saving( QJsonObject & json ) const;
+class ConnectionRemoveCommand : public QUndoCommand
+{
+public:
+	ConnectionRemoveCommand( Connection & c, QUndoCommand * parent = nullptr );
 
-  void loading( const QJsonObject & json );
+	void undo() override;
+	void redo() override;
 
 private:
+	FlowGraph & graph;
+	UndoConnectionRecord record; //Stores everything needed to reconstruct
+	bool firstRun = true;
+};
 
-  using SharedConnection = std::shared_ptr<Connection>;
-  using UniqueNode       = std::unique_ptr<Node>;
+class NodeAddCommand : public QUndoCommand
+{
+public:
+	NodeAddCommand( Node & node, QUndoCommand * parent = nullptr );
+
+	void undo() override;
+	void redo() override;
+
+private:
+	FlowGraph & graph;
+	QUuid id;
+	UndoNodeRecord record;
+	bool firstRun = true;
+};
 
-  std::unordered_map<QUuid, SharedConnection> _connections;
-  std::unordered_map<QUuid, UniqueNode>       _nodes;
-  std::shared_ptr<DataModelRegistry>          _registry;
+class NodeRemoveCommand : public QUndoCommand
+{
+public:
+	NodeRemoveCommand( Node & node, QUndoCommand * parent = nullptr );
 
-  mutable bool _savingOrLoading;
+	void undo() override;
+	void redo() override;
 
-private Q_SLOTS:
+private:
+	FlowGraph & graph;
+	QUuid id;
+	UndoNodeRecord record;
+};
 
-  void setupConnectionSignals(Connection const& c);
+/// Removes nodes and connections through FlowGraph::removeNodes, keeping
+/// one record per item instead of one command per item.
+class NodesRemoveCommand : public QUndoCommand
+{
+public:
+	NodesRemoveCommand( FlowGraph & graph,
+						std::vector<Node*> const & nodes,
+						std::vector<Connection*> const & connections,
+						QUndoCommand * parent = nullptr );
 
-  void sendConnectionCreatedToNodes(Connection const& c);
-  void sendConnectionDeletedToNodes(Connection const& c);
+	void undo() override;
+	void redo() override;
 
+private:
+	FlowGraph & graph;
+	std::vector<QUuid> nodeIds;
+	std::vector<QUuid> connectionIds;
+	std::vector<UndoNodeRecord> nodeRecords;
+	std::vector<UndoConnectionRecord> connectionRecords; // Including the ones of the removed nodes
 };
 
-Node*
-locateNodeAt(QPointF scenePoint, FlowScene &scene,
-             QTransform const & viewTransform);
 }
@@ -3,6 +3,7 @@
 #include <QtWidgets/QGraphicsView>
 #include <QUndoCommand>
 
+class QRubberBand;
 
 namespace QtNodes
 {
@@ -29,6 +30,21 @@ public:
 
   void setScene(FlowScene *scene);
 
+  enum class Rendering
+  {
+    /// QPainter's raster engine into a plain widget
+    Raster,
+    /// A multisampled QOpenGLWidget, redrawn a whole frame at a time.
+    /// Needs OpenGL 2 or ES 2 only, so Mesa's llvmpipe serves where
+    /// there is no GPU. Turns on the scene's connection layer, which
+    /// going back to Raster leaves as it was before.
+    OpenGL
+  };
+
+  void setRendering(Rendering rendering);
+
+  Rendering rendering() const;
+
 public Q_SLOTS:
 
   void scaleUp();
@@ -61,6 +77,16 @@ protected:
 
   FlowScene * scene();
 
+private:
+
+  /// Replaces the selection with the items the rubber band touches,
+  /// found through the scene's index
+  void selectInRubberBand();
+
+  void enableConnectionLayer();
+
+  void restoreConnectionLayer();
+
 private:
 
   QAction* _clearSelectionAction;
@@ -68,8 +94,18 @@ private:
 
   QPointF _clickPos;
 
+  /// Shown while dragging with shift held over empty space
+  QRubberBand * _rubberBand;
+  QPoint        _rubberBandOrigin;
+
   FlowScene* _scene;
 
+  Rendering _rendering;
+
+  /// Whether the scene drew its connections through the layer before
+  /// OpenGL rendering turned it on
+  bool _layerBeforeOpenGL;
+
   QRectF previousRect;
 };
 
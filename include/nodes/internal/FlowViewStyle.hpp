@@ -20,6 +20,18 @@ public:
   static void setStyle(QString jsonText);
   static FlowViewStyle & style();
 
+  /// How much of nodes and connections is drawn
+  enum class DetailLevel
+  {
+    Low,    ///< Flat node rects, straight connections, no antialiasing
+    Medium, ///< Adds node captions and curved connections
+    Full
+  };
+
+  /// The level for a view scale, as given by
+  /// QStyleOptionGraphicsItem::levelOfDetailFromTransform()
+  DetailLevel detailLevel(qreal scale) const;
+
 private:
 
   void loadJsonText(QString jsonText) override;
@@ -33,5 +45,10 @@ public:
   QColor BackgroundColor;
   QColor FineGridColor;
   QColor CoarseGridColor;
+
+  /// Scales below which the Low and Medium detail levels apply.
+  /// Zero disables a level.
+  double LowDetailScale;
+  double MediumDetailScale;
 };
 }
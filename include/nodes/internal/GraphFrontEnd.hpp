@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QtCore/QRectF>
+
+namespace QtNodes
+{
+
+class Node;
+class Connection;
+
+/// Shows the items of a FlowGraph, see FlowScene. The graph calls it
+/// before emitting its own signals, so slots find the graphics in place.
+class GraphFrontEnd
+{
+public:
+
+  virtual
+  ~GraphFrontEnd() = default;
+
+  /// Right after the node is stored, or when its batch is published
+  virtual void
+  showNode(Node & node) = 0;
+
+  /// Once both nodes are shown. A connection being dragged out of a
+  /// port is shown as soon as it is stored.
+  virtual void
+  showConnection(Connection & connection) = 0;
+
+  /// Before the graph removes several items at once
+  virtual void
+  removingItems() = 0;
+
+  /// Scene rect on screen, restored first when loading a chunked file
+  virtual QRectF
+  visibleRect() const = 0;
+};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+namespace QtNodes
+{
+
+/// What a node asks of its graphics. Implemented by NodeGraphicsObject,
+/// so the graph model needs no QtWidgets.
+class NodeGraphics
+{
+public:
+
+  virtual
+  ~NodeGraphics() = default;
+
+  /// Node::position() changed
+  virtual void
+  moved() = 0;
+
+  /// The model's ports or contents changed, the node may take another size
+  virtual void
+  contentsChanged() = 0;
+
+  /// The model's embedded widget asked for another size
+  virtual void
+  embeddedWidgetResized() = 0;
+
+  /// Schedules a repaint
+  virtual void
+  repaint() = 0;
+
+  virtual bool
+  selected() const = 0;
+};
+
+
+/// Owned by the connection, see ConnectionGraphicsObject
+class ConnectionGraphics
+{
+public:
+
+  virtual
+  ~ConnectionGraphics() = default;
+};
+}
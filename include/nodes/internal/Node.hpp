@@ -1,18 +1,20 @@
 #pragma once
 
 #include <QtCore/QObject>
+#include <QtCore/QPointF>
 #include <QtCore/QUuid>
 
 #include <QtCore/QJsonObject>
 
+#include <vector>
+
 #include "PortType.hpp"
 
 #include "NodeState.hpp"
-#include "NodeGeometry.hpp"
 #include "NodeData.hpp"
-#include "NodeGraphicsObject.hpp"
-#include "ConnectionGraphicsObject.hpp"
+#include "ItemGraphics.hpp"
 #include "Serializable.hpp"
+#include "SlotMap.hpp"
 #include "memory.hpp"
 
 namespace QtNodes
@@ -20,8 +22,8 @@ namespace QtNodes
 
 class Connection;
 class ConnectionState;
-class NodeGraphicsObject;
 class NodeDataModel;
+class FlowGraph;
 
 class Node
   : public QObject
@@ -32,7 +34,8 @@ class Node
 public:
 
   /// NodeDataModel should be an rvalue and is moved into the Node
-  Node(std::unique_ptr<NodeDataModel> && dataModel);
+  Node(std::unique_ptr<NodeDataModel> && dataModel,
+       FlowGraph & graph);
 
   virtual
   ~Node() override;
@@ -50,29 +53,37 @@ public:
   QUuid
   id() const;
 
-  void reactToPossibleConnection(PortType,
-                                 NodeDataType const &,
-                                 QPointF const & scenePoint);
+  /// Handle into the FlowGraph storage, assigned by the graph.
+  /// Unlike the id, it changes when the item is restored.
+  SlotHandle
+  handle() const;
+
+  void
+  setHandle(SlotHandle handle);
 
   void
   resetReactionToConnection();
 
 public:
 
-  NodeGraphicsObject const &
-  nodeGraphicsObject() const;
-
-  NodeGraphicsObject &
-  nodeGraphicsObject();
+  /// Null unless a FlowScene shows the node
+  NodeGraphics *
+  graphics() const;
 
   void
-  setGraphicsObject(std::unique_ptr<NodeGraphicsObject>&& graphics);
+  setGraphics(std::unique_ptr<NodeGraphics>&& graphics);
+
+  /// The NodeEditor library reaches a FlowScene's graphics object with
+  /// nodeGraphicsObject(Node&), see NodeGraphicsObject.hpp
+  bool
+  hasGraphicsObject() const;
 
-  NodeGeometry&
-  nodeGeometry();
+  /// Scene position, the graphics follow it
+  QPointF
+  position() const;
 
-  NodeGeometry const&
-  nodeGeometry() const;
+  void
+  setPosition(QPointF const & position);
 
   NodeState const &
   nodeState() const;
@@ -83,9 +94,33 @@ public:
   NodeDataModel*
   nodeDataModel() const;
 
+  FlowGraph &
+  getGraph() const;
+
   void
   prodOnDataUpdated(PortIndex index, Connection * c);
 
+  /// Pull mode: flags the input as stale, along with everything downstream.
+  void
+  markInputDirty(PortIndex index);
+
+  /// Pull mode: fetches fresh data for every dirty input. Upstream nodes
+  /// are expected to be clean already, see FlowGraph::pullNode().
+  void
+  pullInputs();
+
+  /// Nanoseconds spent in NodeDataModel::setInData, on the GUI thread or
+  /// the executor's, while the graph is profiling, see
+  /// FlowGraph::setProfiling()
+  qint64
+  evaluationTime() const;
+
+  unsigned int
+  evaluationCount() const;
+
+  void
+  resetEvaluationStats();
+
 public Q_SLOTS: // data propagation
 
   /// Propagates incoming data to the underlying model.
@@ -94,10 +129,32 @@ public Q_SLOTS: // data propagation
 				PortIndex inPortIndex);
 
   /// Fetches data from model's OUT #index port
-  /// and propagates it to the connection
+  /// and propagates it to the connection, or queues that with the
+  /// graph, see FlowGraph::queuesDataUpdates()
   void
   onDataUpdated(PortIndex index);
 
+public:
+
+  /// Fetches data from model's OUT #index port and propagates it
+  /// to every connection right away
+  void
+  pushData(PortIndex index);
+
+  /// Hands the data to the model on the calling thread, then see
+  /// dataApplied(). Where propagateData() and the executor's flush
+  /// evaluate the node.
+  void
+  applyData(std::shared_ptr<NodeData> nodeData,
+            PortIndex inPortIndex);
+
+  /// After the model took an input, on the GUI thread: counts the
+  /// evaluation if it was timed, a negative elapsed time otherwise,
+  /// journals the model state and updates the graphics. The executor
+  /// calls it for the inputs applied on its threads.
+  void
+  dataApplied(qint64 elapsed);
+
   /// update the graphic part if the size of the embeddedwidget changes
   void
   onNodeSizeUpdated();
@@ -113,6 +170,13 @@ private:
 
   QUuid _uid;
 
+  SlotHandle _handle;
+
+  qint64       _evaluationTime;
+  unsigned int _evaluationCount;
+
+  FlowGraph & _graph;
+
   // data
 
   std::unique_ptr<NodeDataModel> _nodeDataModel;
@@ -121,39 +185,11 @@ private:
 
   // painting
 
-  NodeGeometry _nodeGeometry;
-
-  std::unique_ptr<NodeGraphicsObject> _nodeGraphicsObject;
-
-};
-
-class NodeAddCommand : public QUndoCommand
-{
-public:
-	NodeAddCommand( Node & node, QUndoCommand * parent = nullptr );
-
-	void undo() override;
-	void redo() override;
-
-private:
-	FlowScene & scene;
-	QUuid id;
-	QJsonObject nodeJson;
-	bool firstRun = true;
-};
+  QPointF _position;
 
-class NodeRemoveCommand : public QUndoCommand
-{
-public:
-	NodeRemoveCommand( Node & node, QUndoCommand * parent = nullptr );
+  /// Last, so it goes before the data it shows
+  std::unique_ptr<NodeGraphics> _graphics;
 
-	void undo() override;
-	void redo() override;
-
-private:
-	FlowScene & scene;
-	QUuid id;
-	QJsonObject nodeJson;
 };
 
 }
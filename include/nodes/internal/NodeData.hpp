@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QtCore/QJsonValue>
 #include <QtCore/QString>
 
 namespace QtNodes
@@ -27,5 +28,9 @@ public:
 
   /// Type for inner use
   virtual NodeDataType type() const = 0;
+
+  /// The value in JSON, as NodeEditorRunner writes the data left at
+  /// the sinks. Undefined unless overridden.
+  virtual QJsonValue toJson() const { return QJsonValue(QJsonValue::Undefined); }
 };
 }
@@ -1,16 +1,17 @@
 #pragma once
 
 
-#include <QtWidgets/QWidget>
+#include <QtCore/QObject>
 
 #include "PortType.hpp"
 #include "NodeData.hpp"
 #include "Serializable.hpp"
-#include "NodeGeometry.hpp"
 #include "NodeStyle.hpp"
-#include "NodePainterDelegate.hpp"
 #include "memory.hpp"
 
+// Not included, the model library links no QtWidgets
+class QWidget;
+
 namespace QtNodes
 {
 
@@ -21,7 +22,9 @@ enum class NodeValidationState
   Error
 };
 
+class Node;
 class Connection;
+class NodePainterDelegate;
 
 class StyleCollection;
 
@@ -118,6 +121,14 @@ public:
   bool
   resizable() const { return false; }
 
+  /// When the graph runs in FlowGraph::ExecutionMode::Parallel, setInData of
+  /// models returning true is called on a worker thread. Such a model must
+  /// allow outData to be called from the GUI thread meanwhile, and must not
+  /// touch its embedded widget from setInData.
+  virtual
+  bool
+  threadSafe() const { return false; }
+
   virtual
   NodeValidationState
   validationState() const { return NodeValidationState::Valid; }
@@ -187,3 +198,13 @@ private:
   //NodeStyle _nodeStyle;
 };
 }
+
+// Included here before NodeEditorCore was split off. Models built against
+// the NodeEditor library, which defines NODE_EDITOR_WIDGETS, still get
+// them. Last, since NodePainterDelegate.hpp includes this header.
+#ifdef NODE_EDITOR_WIDGETS
+#include <QtWidgets/QWidget>
+
+#include "NodeGeometry.hpp"
+#include "NodePainterDelegate.hpp"
+#endif
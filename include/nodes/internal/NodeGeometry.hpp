@@ -3,7 +3,9 @@
 #include <QtCore/QRectF>
 #include <QtCore/QPointF>
 #include <QtGui/QTransform>
-#include <QtGui/QFontMetrics>
+#include <QtGui/QFont>
+
+#include <memory>
 
 #include "PortType.hpp"
 #include "memory.hpp"
@@ -14,12 +16,13 @@ namespace QtNodes
 class NodeState;
 class NodeDataModel;
 class Node;
+struct NodeLayout;
 
 class NodeGeometry
 {
 public:
 
-  NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel);
+  NodeGeometry(NodeDataModel * dataModel);
 
 public:
   unsigned int
@@ -79,14 +82,19 @@ public:
   QRectF
   boundingRect() const;
 
-  /// Updates size unconditionally
+  /// Updates size unconditionally, measuring the model's texts again
+  /// unless a node showing the same texts already did
   void
   recalculateSize() const;
 
-  /// Updates size if the QFontMetrics is changed
+  /// Updates size if the font is changed
   void
   recalculateSize(QFont const &font) const;
 
+  /// Text metrics as of the last recalculateSize()
+  NodeLayout const &
+  layout() const;
+
   // TODO removed default QTransform()
   QPointF
   portScenePosition(PortIndex index,
@@ -135,7 +143,7 @@ private:
 
   // some variables are mutable because
   // we need to change drawing metrics
-  // corresponding to fontMetrics
+  // corresponding to the font
   // but this doesn't change constness of Node
 
   mutable unsigned int _width;
@@ -153,9 +161,11 @@ private:
 
   QPointF _draggingPos;
 
-  std::unique_ptr<NodeDataModel> const &_dataModel;
+  NodeDataModel * _dataModel;
+
+  mutable QFont _font;
 
-  mutable QFontMetrics _fontMetrics;
-  mutable QFontMetrics _boldFontMetrics;
+  /// Shared with the nodes showing the same texts
+  mutable std::shared_ptr<NodeLayout const> _layout;
 };
 }
@@ -6,6 +6,7 @@
 
 #include "Connection.hpp"
 
+#include "ItemGraphics.hpp"
 #include "NodeGeometry.hpp"
 #include "NodeState.hpp"
 
@@ -18,8 +19,10 @@ class FlowScene;
 class FlowItemEntry;
 
 /// Class reacts on GUI events, mouse clicks and
-/// forwards painting operation.
-class NodeGraphicsObject : public QGraphicsObject
+/// forwards painting operation. Owned by the node, see FlowScene.
+class NodeGraphicsObject
+  : public QGraphicsObject
+  , public NodeGraphics
 {
   Q_OBJECT
 
@@ -36,12 +39,27 @@ public:
   Node const&
   node() const;
 
+  NodeGeometry&
+  geometry();
+
+  NodeGeometry const&
+  geometry() const;
+
+  /// Includes the shadow
   QRectF
   boundingRect() const override;
 
+  /// Without the shadow
+  QPainterPath
+  shape() const override;
+
   void
   setGeometryChanged();
 
+  /// Recalculates the node size and places the embedded widget.
+  void
+  recalculateGeometry();
+
   /// Visits all attached connections and corrects
   /// their corresponding end points.
   void
@@ -58,6 +76,32 @@ public:
   FlowScene &
   getScene();
 
+  void reactToPossibleConnection(PortType,
+                                 NodeDataType const &,
+                                 QPointF const & scenePoint);
+
+  /// Hands the embedded widget back to the model, which keeps it when
+  /// the graphics go before the node
+  void
+  releaseEmbeddedWidget();
+
+public: // NodeGraphics
+
+  void
+  moved() override;
+
+  void
+  contentsChanged() override;
+
+  void
+  embeddedWidgetResized() override;
+
+  void
+  repaint() override;
+
+  bool
+  selected() const override;
+
 protected:
   void
   paint(QPainter*                       painter,
@@ -101,6 +145,8 @@ private:
 
   Node& _node;
 
+  NodeGeometry _geometry;
+
   bool _locked;
 
   // either nullptr or owned by parent QGraphicsItem
@@ -109,6 +155,15 @@ private:
   QPointF oldPos;
 };
 
+/// The graphics object of a node shown by a FlowScene; asserts there is
+/// one. Node only knows its NodeGraphics, the core has no widgets.
+NodeGraphicsObject &
+nodeGraphicsObject(Node const & node);
+
+/// Kept by the graphics object, see nodeGraphicsObject()
+NodeGeometry &
+nodeGeometry(Node const & node);
+
 class NodeMoveCommand : public QUndoCommand
 {
 public:
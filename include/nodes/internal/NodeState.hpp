@@ -1,9 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
-#include <unordered_map>
 
 #include <QtCore/QUuid>
+#include <QtCore/QVarLengthArray>
 
 
 #include "PortType.hpp"
@@ -33,8 +34,44 @@ public:
 
 public:
 
+  /// Connections of one port, in the order they were made. A port rarely
+  /// holds more than a couple, which are stored inline.
   using ConnectionPtrSet =
-          std::unordered_map<QUuid, Connection*>;
+          QVarLengthArray<Connection*, 2>;
+
+  /// Non-owning view of the connections of one port. Invalidated when the
+  /// port gains or loses a connection, or when the number of ports changes.
+  class ConnectionSpan
+  {
+  public:
+
+    ConnectionSpan() = default;
+
+    ConnectionSpan(Connection * const * first, std::size_t size)
+      : _first(first)
+      , _size(size)
+    {}
+
+    Connection * const *
+    begin() const { return _first; }
+
+    Connection * const *
+    end() const { return _first + _size; }
+
+    std::size_t
+    size() const { return _size; }
+
+    bool
+    empty() const { return _size == 0; }
+
+    Connection *
+    operator[](std::size_t i) const { return _first[i]; }
+
+  private:
+
+    Connection * const * _first = nullptr;
+    std::size_t          _size  = 0;
+  };
 
   /// Returns vector of connections ID.
   /// Some of them can be empty (null)
@@ -44,7 +81,8 @@ public:
   std::vector<ConnectionPtrSet> &
   getEntries(PortType);
 
-  ConnectionPtrSet
+  /// Empty for a port index out of range
+  ConnectionSpan
   connections(PortType portType, PortIndex portIndex) const;
 
   void
@@ -55,7 +93,7 @@ public:
   void
   eraseConnection(PortType portType,
                   PortIndex portIndex,
-                  QUuid id);
+                  Connection const& connection);
 
   ReactToConnectionState
   reaction() const;
@@ -85,6 +123,19 @@ public:
   void
   updateNumPorts( size_t in, size_t out );
 
+public:
+
+  /// Pull mode: the input's upstream data changed since it was last pulled.
+  void
+  setInputDirty(PortIndex portIndex, bool dirty);
+
+  bool
+  inputDirty(PortIndex portIndex) const;
+
+  /// True when any input is dirty
+  bool
+  isDirty() const;
+
 private:
 
   std::vector<ConnectionPtrSet> _inConnections;
@@ -95,5 +146,8 @@ private:
   NodeDataType _reactingDataType;
 
   bool _resizing;
+
+  std::vector<bool> _dirtyInputs;
+  unsigned int      _dirtyInputCount;
 };
 }
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace QtNodes
+{
+
+/// Small handle into a SlotMap. The generation tells a live element
+/// apart from an erased one whose slot has been reused.
+struct SlotHandle
+{
+  std::uint32_t index      = invalidIndex;
+  std::uint32_t generation = 0;
+
+  static constexpr std::uint32_t invalidIndex = 0xFFFFFFFF;
+
+  bool
+  isValid() const { return index != invalidIndex; }
+
+  bool
+  operator==(SlotHandle const & other) const
+  { return index == other.index && generation == other.generation; }
+
+  bool
+  operator!=(SlotHandle const & other) const
+  { return !(*this == other); }
+};
+
+
+/// Dense storage addressed by generational handles. Values are kept
+/// contiguous; erasing moves the last value into the hole, so iteration
+/// order only depends on the sequence of insertions and erasures.
+template<typename T>
+class SlotMap
+{
+public:
+
+  using iterator       = typename std::vector<T>::iterator;
+  using const_iterator = typename std::vector<T>::const_iterator;
+
+public:
+
+  SlotHandle
+  insert(T value)
+  {
+    std::uint32_t slotIndex;
+
+    if (!_freeSlots.empty())
+    {
+      slotIndex = _freeSlots.back();
+      _freeSlots.pop_back();
+    }
+    else
+    {
+      slotIndex = static_cast<std::uint32_t>(_slots.size());
+      _slots.push_back(Slot{0, 0});
+    }
+
+    Slot & slot = _slots[slotIndex];
+    slot.valueIndex = static_cast<std::uint32_t>(_values.size());
+
+    _values.push_back(std::move(value));
+    _valueSlots.push_back(slotIndex);
+
+    return SlotHandle{slotIndex, slot.generation};
+  }
+
+  /// Returns false if the handle is stale.
+  bool
+  erase(SlotHandle handle)
+  {
+    if (!contains(handle))
+      return false;
+
+    Slot & slot = _slots[handle.index];
+
+    std::uint32_t const valueIndex = slot.valueIndex;
+    std::uint32_t const lastIndex  = static_cast<std::uint32_t>(_values.size() - 1);
+
+    // Destroyed on return, once the map is consistent again, since
+    // destructors may call back into the owner
+    T removed = std::move(_values[valueIndex]);
+
+    if (valueIndex != lastIndex)
+    {
+      _values[valueIndex]     = std::move(_values[lastIndex]);
+      _valueSlots[valueIndex] = _valueSlots[lastIndex];
+
+      _slots[_valueSlots[valueIndex]].valueIndex = valueIndex;
+    }
+
+    _values.pop_back();
+    _valueSlots.pop_back();
+
+    ++slot.generation;
+    _freeSlots.push_back(handle.index);
+
+    return true;
+  }
+
+  bool
+  contains(SlotHandle handle) const
+  {
+    return handle.index < _slots.size() &&
+           _slots[handle.index].generation == handle.generation &&
+           _slots[handle.index].valueIndex < _values.size() &&
+           _valueSlots[_slots[handle.index].valueIndex] == handle.index;
+  }
+
+  /// Null if the handle is stale.
+  T *
+  get(SlotHandle handle)
+  {
+    return contains(handle) ? &_values[_slots[handle.index].valueIndex] : nullptr;
+  }
+
+  T const *
+  get(SlotHandle handle) const
+  {
+    return contains(handle) ? &_values[_slots[handle.index].valueIndex] : nullptr;
+  }
+
+  void
+  clear()
+  {
+    _values.clear();
+    _valueSlots.clear();
+
+    _freeSlots.clear();
+
+    for (std::uint32_t i = 0; i < _slots.size(); ++i)
+    {
+      ++_slots[i].generation;
+      _freeSlots.push_back(i);
+    }
+  }
+
+  void
+  reserve(std::size_t size)
+  {
+    _values.reserve(size);
+    _valueSlots.reserve(size);
+  }
+
+  std::size_t
+  size() const { return _values.size(); }
+
+  bool
+  empty() const { return _values.empty(); }
+
+  iterator
+  begin() { return _values.begin(); }
+
+  iterator
+  end() { return _values.end(); }
+
+  const_iterator
+  begin() const { return _values.begin(); }
+
+  const_iterator
+  end() const { return _values.end(); }
+
+private:
+
+  struct Slot
+  {
+    std::uint32_t valueIndex;
+    std::uint32_t generation;
+  };
+
+  std::vector<T>             _values;
+  std::vector<std::uint32_t> _valueSlots;
+
+  std::vector<Slot>          _slots;
+  std::vector<std::uint32_t> _freeSlots;
+};
+}
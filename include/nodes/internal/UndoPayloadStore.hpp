@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QPointF>
+#include <QtCore/QUuid>
+
+#include "PortType.hpp"
+
+class QTemporaryFile;
+
+namespace QtNodes
+{
+
+class UndoPayloadStore;
+
+/// Serialized state referenced by undo commands, kept as CBOR. Identical
+/// payloads are stored once and shared by every command referring to them.
+class UndoPayload
+{
+public:
+
+  ~UndoPayload();
+
+  UndoPayload(UndoPayload const &) = delete;
+  UndoPayload & operator=(UndoPayload const &) = delete;
+
+  /// Decodes the payload, reading it back from the spill file if needed.
+  /// Empty once the store is gone and the payload had been spilled.
+  QJsonObject
+  json() const;
+
+  /// Size of the CBOR encoding
+  int
+  size() const;
+
+private:
+
+  UndoPayload() = default;
+
+  friend class UndoPayloadStore;
+
+  UndoPayloadStore * _store = nullptr;
+
+  std::weak_ptr<UndoPayload> _self;
+
+  QByteArray _hash;
+
+  /// CBOR, possibly compressed. Empty once spilled.
+  QByteArray _data;
+  int        _size       = 0;
+  bool       _compressed = false;
+
+  bool _compressionTried = false;
+
+  qint64 _fileOffset = -1;
+  qint64 _fileSize   = 0;
+
+  std::uint64_t _serial = 0;
+};
+
+using SharedUndoPayload = std::shared_ptr<UndoPayload const>;
+
+
+/// Owns the undo payloads of a scene and keeps them within a memory
+/// budget: past the budget, the oldest payloads are compressed, then
+/// spilled to a temporary file.
+class UndoPayloadStore
+{
+public:
+
+  UndoPayloadStore();
+
+  ~UndoPayloadStore();
+
+  UndoPayloadStore(UndoPayloadStore const &) = delete;
+  UndoPayloadStore & operator=(UndoPayloadStore const &) = delete;
+
+public:
+
+  SharedUndoPayload
+  store(QJsonObject const & json);
+
+  /// Bytes of payload data kept in memory. Zero or less means no limit.
+  void
+  setMemoryBudget(qint64 bytes);
+
+  qint64
+  memoryBudget() const;
+
+  qint64
+  memoryUsage() const;
+
+  qint64
+  spilledBytes() const;
+
+private:
+
+  friend class UndoPayload;
+
+  void
+  release(UndoPayload & payload);
+
+  void
+  enforceBudget();
+
+  bool
+  spill(UndoPayload & payload);
+
+  QByteArray
+  readSpilled(UndoPayload const & payload) const;
+
+private:
+
+  /// Live payloads by content hash
+  QHash<QByteArray, UndoPayload*> _payloads;
+
+  /// Payloads held in memory, least recently stored first
+  std::map<std::uint64_t, UndoPayload*> _resident;
+
+  std::uint64_t _serial;
+
+  qint64 _memoryBudget;
+  qint64 _memoryUsage;
+  qint64 _spilledBytes;
+
+  std::unique_ptr<QTemporaryFile> _spillFile;
+};
+
+
+/// Node state kept by the node undo commands. The model payload,
+/// usually the bulk of it, is shared through the store.
+struct UndoNodeRecord
+{
+  QUuid             id;
+  QPointF           position;
+  SharedUndoPayload model;
+
+  static UndoNodeRecord
+  fromJson(QJsonObject const & nodeJson, UndoPayloadStore & store);
+
+  /// In the format of Node::save()
+  QJsonObject
+  toJson() const;
+};
+
+
+/// Connection state kept by the connection undo commands.
+struct UndoConnectionRecord
+{
+  QUuid     id;
+  QUuid     inNodeId;
+  QUuid     outNodeId;
+  PortIndex inPortIndex  = INVALID;
+  PortIndex outPortIndex = INVALID;
+
+  /// Converter data types, empty without a converter
+  QJsonObject converter;
+
+  static UndoConnectionRecord
+  fromJson(QJsonObject const & connectionJson);
+
+  /// In the format of Connection::save()
+  QJsonObject
+  toJson() const;
+};
+}
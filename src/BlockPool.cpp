@@ -0,0 +1,115 @@
+#include "BlockPool.hpp"
+
+#include <new>
+
+using QtNodes::BlockPool;
+
+static
+std::size_t
+alignedSize(std::size_t size)
+{
+  std::size_t const alignment = alignof(std::max_align_t);
+
+  if (size < sizeof(void*))
+    size = sizeof(void*);
+
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+
+BlockPool::
+BlockPool(std::size_t blocksPerChunk)
+  : _blocksPerChunk(blocksPerChunk)
+  , _blockSize(0)
+  , _blocksInUse(0)
+  , _freeList(nullptr)
+{}
+
+
+BlockPool::
+~BlockPool() = default;
+
+
+void *
+BlockPool::
+allocate(std::size_t size)
+{
+  std::size_t const blockSize = alignedSize(size);
+
+  if (_blockSize == 0)
+    _blockSize = blockSize;
+
+  if (blockSize != _blockSize)
+    return ::operator new(size);
+
+  if (_freeList == nullptr)
+    addChunk();
+
+  FreeBlock * block = _freeList;
+  _freeList = block->next;
+
+  ++_blocksInUse;
+
+  return block;
+}
+
+
+void
+BlockPool::
+deallocate(void * block, std::size_t size)
+{
+  if (alignedSize(size) != _blockSize)
+  {
+    ::operator delete(block);
+    return;
+  }
+
+  auto freeBlock = static_cast<FreeBlock*>(block);
+  freeBlock->next = _freeList;
+  _freeList = freeBlock;
+
+  --_blocksInUse;
+}
+
+
+std::size_t
+BlockPool::
+reservedBytes() const
+{
+  return _chunks.size() * _blocksPerChunk * _blockSize;
+}
+
+
+std::size_t
+BlockPool::
+blocksInUse() const
+{
+  return _blocksInUse;
+}
+
+
+std::size_t
+BlockPool::
+blockSize() const
+{
+  return _blockSize;
+}
+
+
+void
+BlockPool::
+addChunk()
+{
+  // operator new[] returns memory aligned for any fundamental type
+  _chunks.emplace_back(new unsigned char[_blocksPerChunk * _blockSize]);
+
+  unsigned char * chunk = _chunks.back().get();
+
+  // Threaded back to front, so blocks are handed out in address order
+  for (std::size_t i = _blocksPerChunk; i > 0; --i)
+  {
+    auto block = reinterpret_cast<FreeBlock*>(chunk + (i - 1) * _blockSize);
+    block->next = _freeList;
+    _freeList = block;
+  }
+}
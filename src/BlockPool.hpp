@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace QtNodes
+{
+
+/// Free list of equally sized blocks carved out of large chunks. The block
+/// size is fixed by the first allocation; requests of any other size go to
+/// the global heap. Freed blocks are reused, chunks are only released with
+/// the pool. Not thread safe.
+class BlockPool
+{
+public:
+
+  explicit
+  BlockPool(std::size_t blocksPerChunk = 256);
+
+  ~BlockPool();
+
+  BlockPool(BlockPool const &) = delete;
+  BlockPool & operator=(BlockPool const &) = delete;
+
+public:
+
+  void *
+  allocate(std::size_t size);
+
+  void
+  deallocate(void * block, std::size_t size);
+
+  /// Bytes reserved in chunks, used or not
+  std::size_t
+  reservedBytes() const;
+
+  std::size_t
+  blocksInUse() const;
+
+  /// Zero until the first allocation
+  std::size_t
+  blockSize() const;
+
+private:
+
+  void
+  addChunk();
+
+private:
+
+  struct FreeBlock
+  {
+    FreeBlock * next;
+  };
+
+  std::size_t _blocksPerChunk;
+  std::size_t _blockSize;
+  std::size_t _blocksInUse;
+
+  FreeBlock * _freeList;
+
+  std::vector<std::unique_ptr<unsigned char[]>> _chunks;
+};
+
+
+/// Allocator drawing from a BlockPool, meant for std::allocate_shared so
+/// that an object and its control block share one pooled block. Every
+/// copy keeps the pool alive.
+template<typename T>
+class PoolAllocator
+{
+public:
+
+  using value_type = T;
+
+  explicit
+  PoolAllocator(std::shared_ptr<BlockPool> pool)
+    : _pool(std::move(pool))
+  {}
+
+  template<typename U>
+  PoolAllocator(PoolAllocator<U> const & other)
+    : _pool(other.pool())
+  {}
+
+  T *
+  allocate(std::size_t n)
+  {
+    return static_cast<T*>(_pool->allocate(n * sizeof(T)));
+  }
+
+  void
+  deallocate(T * p, std::size_t n)
+  {
+    _pool->deallocate(p, n * sizeof(T));
+  }
+
+  std::shared_ptr<BlockPool> const &
+  pool() const { return _pool; }
+
+private:
+
+  std::shared_ptr<BlockPool> _pool;
+};
+
+
+template<typename T, typename U>
+bool
+operator==(PoolAllocator<T> const & a, PoolAllocator<U> const & b)
+{
+  return a.pool() == b.pool();
+}
+
+
+template<typename T, typename U>
+bool
+operator!=(PoolAllocator<T> const & a, PoolAllocator<U> const & b)
+{
+  return !(a == b);
+}
+}
@@ -3,20 +3,15 @@
 #include <cmath>
 #include <utility>
 
-#include <QtWidgets/QtWidgets>
 #include <QtGlobal>
 
 #include "Node.hpp"
-#include "FlowScene.hpp"
-#include "FlowView.hpp"
+#include "FlowGraph.hpp"
 
-#include "NodeGeometry.hpp"
-#include "NodeGraphicsObject.hpp"
 #include "NodeDataModel.hpp"
 
 #include "ConnectionState.hpp"
 #include "ConnectionGeometry.hpp"
-#include "ConnectionGraphicsObject.hpp"
 
 using namespace QtNodes;
 
@@ -58,25 +53,35 @@ Connection(Node& nodeIn,
   commandSetup(); //this must happen after completing the connection to avoid an extra add command
 
   if( _converter )
-	QObject::connect( _converter.get(), &TypeConverter::finished,
-					  this, &Connection::propagateData );
+	connectConverter();
 }
 
 
 Connection::
 ~Connection()
 {
-  if (complete()) connectionMadeIncomplete(*this);
+  // Both ends were cleared, there is no graph to tell or node to repaint
+  if (!_inNode && !_outNode)
+    return;
+
+  // The graph has announced the deletion and frees the nodes next
+  if (getGraph().isTearingDown())
+    return;
+
+  if (complete()) getGraph().connectionMadeIncomplete(*this);
   propagateEmptyData();
 
-  if (_inNode)
+  // Its result, the empty data's too, is dropped with the connection
+  endConversion();
+
+  if (_inNode && _inNode->graphics())
   {
-    _inNode->nodeGraphicsObject().update();
+    _inNode->graphics()->repaint();
   }
 
-  if (_outNode)
+  if (_outNode && _outNode->graphics())
   {
-    _outNode->nodeGraphicsObject().update();
+    _outNode->graphics()->repaint();
   }
 }
 
@@ -130,6 +135,22 @@ id() const
 }
 
 
+SlotHandle
+Connection::
+handle() const
+{
+  return _handle;
+}
+
+
+void
+Connection::
+setHandle(SlotHandle handle)
+{
+  _handle = handle;
+}
+
+
 bool
 Connection::
 complete() const
@@ -170,43 +191,6 @@ requiredPort() const
 }
 
 
-void
-Connection::
-setGraphicsObject(std::unique_ptr<ConnectionGraphicsObject>&& graphics)
-{
-  _connectionGraphicsObject = std::move(graphics);
-
-  // This function is only called when the ConnectionGraphicsObject
-  // is newly created. At this moment both end coordinates are (0, 0)
-  // in Connection G.O. coordinates. The position of the whole
-  // Connection G. O. in scene coordinate system is also (0, 0).
-  // By moving the whole object to the Node Port position
-  // we position both connection ends correctly.
-
-  if (requiredPort() != PortType::None)
-  {
-
-	PortType attachedPort = oppositePort(requiredPort());
-
-	PortIndex attachedPortIndex = getPortIndex(attachedPort);
-
-	auto node = getNode(attachedPort);
-
-	QTransform nodeSceneTransform =
-	  node->nodeGraphicsObject().sceneTransform();
-
-	QPointF pos = node->nodeGeometry().portScenePosition(attachedPortIndex,
-														 attachedPort,
-														 nodeSceneTransform);
-
-	_connectionGraphicsObject->setPos(pos);
-  }
-
-  _connectionGraphicsObject->move();
-}
-
-
-
 PortIndex
 Connection::
 getPortIndex(PortType portType) const
@@ -251,9 +235,8 @@ setNodeToPort(Node& node,
 
   _connectionState.setNoRequiredPort();
 
-  updated(*this);
   if (complete() && wasIncomplete) {
-	connectionCompleted(*this);
+	node.getGraph().connectionMadeComplete(*this);
   }
 }
 
@@ -263,18 +246,62 @@ Connection::
 removeFromNodes() const
 {
   if (_inNode)
-	_inNode->nodeState().eraseConnection(PortType::In, _inPortIndex, id());
+	_inNode->nodeState().eraseConnection(PortType::In, _inPortIndex, *this);
 
   if (_outNode)
-	_outNode->nodeState().eraseConnection(PortType::Out, _outPortIndex, id());
+	_outNode->nodeState().eraseConnection(PortType::Out, _outPortIndex, *this);
+}
+
+
+ConnectionGraphics *
+Connection::
+graphics() const
+{
+  return _graphics.get();
+}
+
+
+void
+Connection::
+setGraphics(std::unique_ptr<ConnectionGraphics>&& graphics)
+{
+  _graphics = std::move(graphics);
 }
 
 
-ConnectionGraphicsObject&
+bool
 Connection::
-getConnectionGraphicsObject() const
+hasGraphicsObject() const
 {
-  return *_connectionGraphicsObject;
+  return _graphics != nullptr;
+}
+
+
+FlowGraph&
+Connection::
+getGraph() const
+{
+  Node * node = _inNode ? _inNode : _outNode;
+
+  Q_ASSERT(node != nullptr);
+
+  return node->getGraph();
+}
+
+
+bool
+Connection::
+announced() const
+{
+  return _announced;
+}
+
+
+void
+Connection::
+setAnnounced(bool announced)
+{
+  _announced = announced;
 }
 
 
@@ -359,9 +386,13 @@ Connection::
 clearNode(PortType portType)
 {
   if (complete()) {
-	connectionMadeIncomplete(*this);
+	getGraph().connectionMadeIncomplete(*this);
   }
 
+  // A pending result has nowhere to go
+  if (portType == PortType::In)
+	endConversion();
+
   getNode(portType) = nullptr;
 
   if (portType == PortType::In)
@@ -426,11 +457,11 @@ void
 Connection::
 setTypeConverter( SharedTypeConverter converter )
 {
-  if( _converter )
-	{
-	QObject::disconnect( _converter.get(), &TypeConverter::finished,
-					  this, &Connection::propagateData );
-	}
+  // Drops the results of the old converter, queued ones too
+  _converterContext.reset();
+
+  if (_inNode || _outNode)
+	endConversion();
 
   if( !converter )
 	{
@@ -440,19 +471,69 @@ setTypeConverter( SharedTypeConverter converter )
 
   _converter = converter->createNew();
 
+  connectConverter();
+}
+
+
+void
+Connection::
+connectConverter()
+{
+  // Owned by the connection and living in its thread: results emitted from
+  // another thread are queued to it, and destroying it with the connection
+  // drops the calls still queued, which the converter may outlive
+  _converterContext = detail::make_unique<QObject>();
+
   QObject::connect( _converter.get(), &TypeConverter::finished,
-					this, &Connection::propagateData );
+					_converterContext.get(), [this]( std::shared_ptr<NodeData> nodeData )
+					{
+					endConversion();
+					propagateData( nodeData );
+					} );
 }
 
 
 void
 Connection::
 setInData(std::shared_ptr<NodeData> nodeData) const
+{
+  if (_inNode &&
+      _inNode->getGraph().propagationMode() == FlowGraph::PropagationMode::Pull)
+  {
+    _inNode->markInputDirty(_inPortIndex);
+    return;
+  }
+
+  deliverData(std::move(nodeData));
+}
+
+
+void
+Connection::
+pull() const
+{
+  if (_inNode && _outNode)
+  {
+    deliverData(_outNode->nodeDataModel()->outData(_outPortIndex));
+  }
+}
+
+
+void
+Connection::
+deliverData(std::shared_ptr<NodeData> nodeData) const
 {
   if (_inNode)
   {
     if (_converter)
 	{
+      // Counted until it reports back, see FlowGraph::isIdle()
+      if (!_converting)
+      {
+        _converting = true;
+        getGraph().conversionStarted();
+      }
+
       (*_converter)(nodeData); //defer propagation to converter
     }
     else
@@ -482,6 +563,18 @@ propagateEmptyData() const
   setInData(emptyData);
 }
 
+void
+Connection::
+endConversion() const
+{
+  if (!_converting)
+    return;
+
+  _converting = false;
+  getGraph().conversionFinished();
+}
+
+
 void
 Connection::
 commandSetup()
@@ -497,53 +590,3 @@ commandSetup()
 //	});
 }
 
-
-using QtNodes::ConnectionAddCommand;
-using QtNodes::ConnectionRemoveCommand;
-
-ConnectionAddCommand::ConnectionAddCommand( Connection & c, QUndoCommand * parent )
-	: QUndoCommand( "Connection created", parent )
-	, scene( c.getConnectionGraphicsObject().getScene() )
-	, connectionJson( c.save() )
-	{
-	}
-
-void ConnectionAddCommand::undo()
-	{
-	auto c = scene.connections().at( QUuid( connectionJson["id"].toString() ) );
-	scene.deleteConnection( *c, true );
-	}
-
-void ConnectionAddCommand::redo()
-	{
-	if( firstRun )
-		firstRun = false;
-	else
-		{
-		auto c = scene.restoreConnection( connectionJson, true );
-		}
-	}
-
-ConnectionRemoveCommand::ConnectionRemoveCommand( Connection & c, QUndoCommand * parent )
-	: QUndoCommand( "Connection removed", parent )
-	, scene( c.getConnectionGraphicsObject().getScene() )
-	, connectionJson( c.save() )
-	{
-	}
-
-void ConnectionRemoveCommand::undo()
-	{
-	auto c = scene.restoreConnection( connectionJson, true );
-	}
-
-void ConnectionRemoveCommand::redo()
-	{
-	if( firstRun )
-		firstRun = false;
-	else
-		{
-		auto c = scene.connections().at( QUuid( connectionJson["id"].toString() ) );
-		scene.deleteConnection( *c, true );
-		}
-	}
-
@@ -2,6 +2,8 @@
 
 #include <cmath>
 
+#include <QtGui/QPainterPathStroker>
+
 #include "StyleCollection.hpp"
 
 using QtNodes::ConnectionGeometry;
@@ -14,6 +16,8 @@ ConnectionGeometry()
   //, _animationPhase(0)
   , _lineWidth(3.0)
   , _hovered(false)
+  , _pathValid(false)
+  , _strokeValid(false)
 { }
 
 QPointF const&
@@ -35,16 +39,24 @@ setEndPoint(PortType portType, QPointF const& point)
   switch (portType)
   {
     case PortType::Out:
+      if (_out == point)
+        return;
+
       _out = point;
       break;
 
     case PortType::In:
+      if (_in == point)
+        return;
+
       _in = point;
       break;
 
     default:
-      break;
+      return;
   }
+
+  invalidate();
 }
 
 
@@ -63,8 +75,10 @@ moveEndPoint(PortType portType, QPointF const &offset)
       break;
 
     default:
-      break;
+      return;
   }
+
+  invalidate();
 }
 
 
@@ -129,3 +143,77 @@ pointsC1C2() const
 
   return std::make_pair(c1, c2);
 }
+
+
+QPainterPath const &
+ConnectionGeometry::
+cubicPath() const
+{
+  if (!_pathValid)
+    updatePath();
+
+  return _cubicPath;
+}
+
+
+QPolygonF const &
+ConnectionGeometry::
+polyline() const
+{
+  if (!_pathValid)
+    updatePath();
+
+  return _polyline;
+}
+
+
+QPainterPath const &
+ConnectionGeometry::
+stroke() const
+{
+  if (_strokeValid)
+    return _stroke;
+
+  QPolygonF const & points = polyline();
+
+  // A third of the points is plenty for hit tests
+  QPainterPath path(points.front());
+
+  for (int i = 3; i < points.size(); i += 3)
+    path.lineTo(points[i]);
+
+  QPainterPathStroker stroker; stroker.setWidth(10.0);
+
+  _stroke      = stroker.createStroke(path);
+  _strokeValid = true;
+
+  return _stroke;
+}
+
+
+void
+ConnectionGeometry::
+updatePath() const
+{
+  auto c1c2 = pointsC1C2();
+
+  _cubicPath = QPainterPath(_out);
+  _cubicPath.cubicTo(c1c2.first, c1c2.second, _in);
+
+  _polyline.clear();
+  _polyline.reserve(polylineSegments + 1);
+
+  for (int i = 0; i <= polylineSegments; ++i)
+    _polyline.append(_cubicPath.pointAtPercent(double(i) / polylineSegments));
+
+  _pathValid = true;
+}
+
+
+void
+ConnectionGeometry::
+invalidate()
+{
+  _pathValid   = false;
+  _strokeValid = false;
+}
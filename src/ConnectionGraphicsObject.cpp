@@ -13,12 +13,16 @@
 #include "ConnectionPainter.hpp"
 #include "ConnectionState.hpp"
 #include "ConnectionBlurEffect.hpp"
+#include "ConnectionLayer.hpp"
 
 #include "NodeGraphicsObject.hpp"
 
 #include "NodeConnectionInteraction.hpp"
 
 #include "Node.hpp"
+#include "SceneIndex.hpp"
+#include "SceneTiles.hpp"
+#include "StyleCollection.hpp"
 
 using QtNodes::ConnectionGraphicsObject;
 using QtNodes::Connection;
@@ -41,13 +45,44 @@ ConnectionGraphicsObject(FlowScene &scene,
   // addGraphicsEffect();
 
   setZValue(-1.0);
+
+  if (_scene.connectionLayer())
+    setDrawnByLayer(true);
+
+  _scene.index().addConnection(*this);
+
+  // Both ends are at (0, 0) in item coordinates, and so is the item in
+  // the scene. Placed at its port, a connection being dragged starts
+  // with both ends there.
+  if (_connection.requiredPort() != PortType::None)
+  {
+    PortType const attachedPort = oppositePort(_connection.requiredPort());
+
+    Node * node = _connection.getNode(attachedPort);
+
+    setPos(nodeGeometry(*node).portScenePosition(_connection.getPortIndex(attachedPort),
+                                                  attachedPort,
+                                                  nodeGraphicsObject(*node).sceneTransform()));
+  }
+
+  move();
+
+  _scene.tiles().file(*this, SceneTiles::Layer::Connections);
 }
 
 
 ConnectionGraphicsObject::
 ~ConnectionGraphicsObject()
 {
-  _scene.removeItem(this);
+  _scene.index().removeConnection(*this);
+
+  if (!_scene.graph().isTearingDown())
+  {
+    if (auto layer = _scene.connectionLayer())
+      layer->update(_layerRect);
+  }
+
+  _scene.tiles().remove(*this);
 }
 
 
@@ -93,6 +128,8 @@ ConnectionGraphicsObject::
 setGeometryChanged()
 {
   prepareGeometryChange();
+
+  _scene.index().invalidateConnection(*this);
 }
 
 
@@ -104,9 +141,9 @@ move()
   {
     if (auto node = _connection.getNode(portType))
     {
-      auto const &nodeGraphics = node->nodeGraphicsObject();
+      auto const &nodeGraphics = nodeGraphicsObject(*node);
 
-      auto const &nodeGeom = node->nodeGeometry();
+      auto const &nodeGeom = nodeGeometry(*node);
 
       QPointF scenePos =
         nodeGeom.portScenePosition(_connection.getPortIndex(portType),
@@ -120,11 +157,47 @@ move()
       _connection.connectionGeometry().setEndPoint(portType,
                                                    connectionPos);
 
-      _connection.getConnectionGraphicsObject().setGeometryChanged();
-      _connection.getConnectionGraphicsObject().update();
+      setGeometryChanged();
+      repaint();
     }
   }
 
+  _scene.tiles().refile(*this);
+}
+
+
+void
+ConnectionGraphicsObject::
+repaint()
+{
+  ConnectionLayer * layer = _scene.connectionLayer();
+
+  if (!layer)
+  {
+    update();
+    return;
+  }
+
+  // Items without contents don't repaint themselves. The layer sits at
+  // the scene origin, so scene rects are its own.
+  QRectF const rect = sceneBoundingRect();
+
+  layer->update(_layerRect.united(rect));
+
+  _layerRect = rect;
+}
+
+
+void
+ConnectionGraphicsObject::
+setDrawnByLayer(bool drawnByLayer)
+{
+  setFlag(QGraphicsItem::ItemHasNoContents, drawnByLayer);
+
+  if (drawnByLayer)
+    _layerRect = sceneBoundingRect();
+  else
+    update();
 }
 
 void ConnectionGraphicsObject::lock(bool locked)
@@ -152,8 +225,12 @@ paint(QPainter* painter,
 {
   painter->setClipRect(option->exposedRect);
 
+  qreal const scale =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
   ConnectionPainter::paint(painter,
-                           _connection);
+                           _connection,
+                           StyleCollection::flowViewStyle().detailLevel(scale));
 }
 
 
@@ -170,7 +247,7 @@ void
 ConnectionGraphicsObject::
 mouseMoveEvent(QGraphicsSceneMouseEvent* event)
 {
-  prepareGeometryChange();
+  setGeometryChanged();
 
   auto view = static_cast<QGraphicsView*>(event->widget());
   auto node = locateNodeAt(event->scenePos(),
@@ -182,9 +259,9 @@ mouseMoveEvent(QGraphicsSceneMouseEvent* event)
   state.interactWithNode(node);
   if (node)
   {
-    node->reactToPossibleConnection(state.requiredPort(),
-                                    _connection.dataType(oppositePort(state.requiredPort())),
-                                    event->scenePos());
+    nodeGraphicsObject(*node).reactToPossibleConnection(state.requiredPort(),
+                                                         _connection.dataType(oppositePort(state.requiredPort())),
+                                                         event->scenePos());
   }
 
   //-------------------
@@ -196,11 +273,12 @@ mouseMoveEvent(QGraphicsSceneMouseEvent* event)
   if (requiredPort != PortType::None)
   {
     _connection.connectionGeometry().moveEndPoint(requiredPort, offset);
+    _scene.tiles().refile(*this);
   }
 
   //-------------------
 
-  update();
+  repaint();
 
   event->accept();
 }
@@ -225,7 +303,7 @@ mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 
   if (_connection.connectionState().requiresPort())
   {
-	_scene.deleteConnection(_connection);
+	_scene.graph().deleteConnection(_connection);
   }
 }
 
@@ -236,7 +314,7 @@ hoverEnterEvent(QGraphicsSceneHoverEvent* event)
 {
   _connection.connectionGeometry().setHovered(true);
 
-  update();
+  repaint();
   _scene.connectionHovered(connection(), event->screenPos());
   event->accept();
 }
@@ -248,12 +326,24 @@ hoverLeaveEvent(QGraphicsSceneHoverEvent* event)
 {
   _connection.connectionGeometry().setHovered(false);
 
-  update();
+  repaint();
   _scene.connectionHoverLeft(connection());
   event->accept();
 }
 
 
+QVariant
+ConnectionGraphicsObject::
+itemChange(GraphicsItemChange change, const QVariant &value)
+{
+  // Selection shows as a halo
+  if (change == ItemSelectedHasChanged && _scene.connectionLayer())
+    repaint();
+
+  return QGraphicsItem::itemChange(change, value);
+}
+
+
 void
 ConnectionGraphicsObject::
 addGraphicsEffect()
@@ -268,3 +358,15 @@ addGraphicsEffect()
   //effect->setOffset(4, 4);
   //effect->setColor(QColor(Qt::gray).darker(800));
 }
+
+
+//------------------------------------------------------------------------------
+
+QtNodes::ConnectionGraphicsObject&
+QtNodes::
+connectionGraphicsObject(Connection const & connection)
+{
+  Q_ASSERT(connection.graphics() != nullptr);
+
+  return static_cast<ConnectionGraphicsObject&>(*connection.graphics());
+}
@@ -0,0 +1,103 @@
+#include "ConnectionLayer.hpp"
+
+#include <vector>
+
+#include <QtWidgets/QStyleOptionGraphicsItem>
+
+#include "FlowScene.hpp"
+
+#include "Connection.hpp"
+#include "ConnectionGraphicsObject.hpp"
+#include "ConnectionPainter.hpp"
+
+#include "SceneIndex.hpp"
+#include "SceneTiles.hpp"
+#include "StyleCollection.hpp"
+
+using QtNodes::ConnectionLayer;
+using QtNodes::Connection;
+using QtNodes::ConnectionGraphicsObject;
+using QtNodes::SceneTiles;
+
+
+ConnectionLayer::
+ConnectionLayer(FlowScene & scene)
+  : _scene(scene)
+{
+  // Without it the exposed rect is the whole bounding rect
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+
+  setAcceptedMouseButtons(Qt::NoButton);
+
+  // Where the connection items would be
+  setZValue(-1.0);
+
+  _rect = _scene.tiles().bounds(SceneTiles::Layer::Connections);
+
+  // Not a whole-scene rect, which would grow the scene rect of every
+  // view that does not set its own
+  _scene.tiles().setBoundsChanged(SceneTiles::Layer::Connections, [this]()
+  {
+    prepareGeometryChange();
+    _rect = _scene.tiles().bounds(SceneTiles::Layer::Connections);
+  });
+
+  _scene.addItem(this);
+}
+
+
+ConnectionLayer::
+~ConnectionLayer()
+{
+  _scene.tiles().setBoundsChanged(SceneTiles::Layer::Connections, nullptr);
+
+  if (scene() == &_scene)
+    _scene.removeItem(this);
+}
+
+
+QRectF
+ConnectionLayer::
+boundingRect() const
+{
+  return _rect;
+}
+
+
+QPainterPath
+ConnectionLayer::
+shape() const
+{
+  return QPainterPath();
+}
+
+
+void
+ConnectionLayer::
+paint(QPainter* painter,
+      QStyleOptionGraphicsItem const* option,
+      QWidget*)
+{
+  QRectF const exposed = option->exposedRect;
+
+  painter->setClipRect(exposed);
+
+  std::vector<Connection const*> visible;
+
+  // The index hands out whole cells
+  for (ConnectionGraphicsObject * cgo : _scene.index().connections(exposed))
+  {
+    if (cgo->sceneBoundingRect().intersects(exposed))
+      visible.push_back(&cgo->connection());
+  }
+
+  if (visible.empty())
+    return;
+
+  qreal const scale =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
+  ConnectionPainter::paintLayer(painter,
+                                visible,
+                                StyleCollection::flowViewStyle().detailLevel(scale));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QtWidgets/QGraphicsItem>
+
+namespace QtNodes
+{
+
+class FlowScene;
+
+/// Single item drawing every connection of the scene, see
+/// FlowScene::setConnectionLayerEnabled().
+///
+/// Each paint asks the SceneIndex for the connections near the exposed
+/// rect and hands them to ConnectionPainter::paintLayer(), which strokes
+/// all lines sharing a pen at once. The connection items stay in the
+/// scene, without contents, for hover, selection and dragging; they
+/// repaint through the layer.
+class ConnectionLayer
+  : public QGraphicsItem
+{
+public:
+
+  ConnectionLayer(FlowScene & scene);
+
+  ~ConnectionLayer();
+
+public:
+
+  /// Covers the connection items, as their tiles do, see
+  /// SceneTiles::bounds(). Follows them as they move.
+  QRectF
+  boundingRect() const override;
+
+  /// Empty, so the layer is never hit and events reach the items
+  QPainterPath
+  shape() const override;
+
+protected:
+
+  void
+  paint(QPainter* painter,
+        QStyleOptionGraphicsItem const* option,
+        QWidget* widget = nullptr) override;
+
+private:
+
+  FlowScene & _scene;
+
+  QRectF _rect;
+};
+}
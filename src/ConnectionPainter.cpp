@@ -1,6 +1,11 @@
 #include "ConnectionPainter.hpp"
 
+#include <map>
+#include <tuple>
+#include <utility>
+
 #include <QtGui/QIcon>
+#include <QtGui/QPixmapCache>
 
 #include "ConnectionGeometry.hpp"
 #include "ConnectionState.hpp"
@@ -17,21 +22,23 @@ using QtNodes::ConnectionGeometry;
 using QtNodes::Connection;
 
 
+/// Marks connections going through a type converter
 static
-QPainterPath
-cubicPath(ConnectionGeometry const& geom)
+QPixmap
+converterIcon()
 {
-  QPointF const& source = geom.source();
-  QPointF const& sink   = geom.sink();
+  QString const key = QStringLiteral("QtNodes::ConnectionPainter:convert");
 
-  auto c1c2 = geom.pointsC1C2();
+  QPixmap pixmap;
 
-  // cubic spline
-  QPainterPath cubic(source);
+  if (!QPixmapCache::find(key, &pixmap))
+  {
+    pixmap = QIcon(":convert.png").pixmap(QSize(22, 22));
 
-  cubic.cubicTo(c1c2.first, c1c2.second, sink);
+    QPixmapCache::insert(key, pixmap);
+  }
 
-  return cubic;
+  return pixmap;
 }
 
 
@@ -39,22 +46,7 @@ QPainterPath
 ConnectionPainter::
 getPainterStroke(ConnectionGeometry const& geom)
 {
-  auto cubic = cubicPath(geom);
-
-  QPointF const& source = geom.source();
-  QPainterPath result(source);
-
-  unsigned segments = 20;
-
-  for (auto i = 0ul; i < segments; ++i)
-  {
-    double ratio = double(i + 1) / segments;
-    result.lineTo(cubic.pointAtPercent(ratio));
-  }
-
-  QPainterPathStroker stroker; stroker.setWidth(10.0);
-
-  return stroker.createStroke(result);
+  return geom.stroke();
 }
 
 
@@ -86,7 +78,7 @@ debugDrawing(QPainter * painter,
 
     painter->setBrush(Qt::NoBrush);
 
-    painter->drawPath(cubicPath(geom));
+    painter->drawPath(geom.cubicPath());
   }
 
   {
@@ -123,9 +115,8 @@ drawSketchLine(QPainter * painter,
     using QtNodes::ConnectionGeometry;
     ConnectionGeometry const& geom = connection.connectionGeometry();
 
-    auto cubic = cubicPath(geom);
     // cubic spline
-    painter->drawPath(cubic);
+    painter->drawPath(geom.cubicPath());
   }
 }
 
@@ -140,7 +131,7 @@ drawHoveredOrSelected(QPainter * painter,
   bool const hovered = geom.hovered();
 
   auto const& graphicsObject =
-    connection.getConnectionGraphicsObject();
+    connectionGraphicsObject(connection);
 
   bool const selected = graphicsObject.isSelected();
 
@@ -162,12 +153,65 @@ drawHoveredOrSelected(QPainter * painter,
     painter->setBrush(Qt::NoBrush);
 
     // cubic spline
-    auto cubic = cubicPath(geom);
-    painter->drawPath(cubic);
+    painter->drawPath(geom.cubicPath());
   }
 }
 
 
+/// Colors of the out and in halves of a line, which differ where a
+/// converter joins two data types
+struct LineColors
+{
+  QColor out;
+  QColor in;
+
+  bool gradient;
+};
+
+
+static
+LineColors
+lineColors(Connection const & connection, bool selected)
+{
+  auto const &connectionStyle =
+    QtNodes::StyleCollection::connectionStyle();
+
+  if (!connectionStyle.useDataDefinedColors())
+  {
+    QColor const color = selected ?
+                         connectionStyle.selectedColor() :
+                         connectionStyle.normalColor();
+
+    return { color, color, false };
+  }
+
+  using QtNodes::PortType;
+
+  auto dataTypeOut = connection.dataType(PortType::Out);
+  auto dataTypeIn = connection.dataType(PortType::In);
+
+  QColor colorOut = connectionStyle.normalColor(dataTypeOut.id);
+  QColor colorIn  = connectionStyle.normalColor(dataTypeIn.id);
+
+  if (selected)
+  {
+    colorOut = colorOut.darker(200);
+    colorIn  = colorIn.darker(200);
+  }
+
+  return { colorOut, colorIn, dataTypeOut.id != dataTypeIn.id };
+}
+
+
+/// Where the converter icon of a gradient line goes
+static
+QPointF
+converterPosition(ConnectionGeometry const & geom)
+{
+  return geom.polyline()[ConnectionGeometry::polylineSegments / 2];
+}
+
+
 static
 void
 drawNormalLine(QPainter * painter,
@@ -181,30 +225,13 @@ drawNormalLine(QPainter * painter,
   if (state.requiresPort())
     return;
 
-  // colors
-
   auto const &connectionStyle =
     QtNodes::StyleCollection::connectionStyle();
 
-  QColor normalColorOut  = connectionStyle.normalColor();
-  QColor normalColorIn   = connectionStyle.normalColor();
-  QColor selectedColor = connectionStyle.selectedColor();
-
-  bool gradientColor = false;
-
-  if (connectionStyle.useDataDefinedColors())
-  {
-    using QtNodes::PortType;
-
-    auto dataTypeOut = connection.dataType(PortType::Out);
-    auto dataTypeIn = connection.dataType(PortType::In);
-
-    gradientColor = (dataTypeOut.id != dataTypeIn.id);
+  auto const& graphicsObject = connectionGraphicsObject(connection);
+  bool const selected = graphicsObject.isSelected();
 
-    normalColorOut  = connectionStyle.normalColor(dataTypeOut.id);
-    normalColorIn   = connectionStyle.normalColor(dataTypeIn.id);
-    selectedColor = normalColorOut.darker(200);
-  }
+  LineColors const colors = lineColors(connection, selected);
 
   // geometry
 
@@ -217,64 +244,87 @@ drawNormalLine(QPainter * painter,
 
   p.setWidth(lineWidth);
 
-  auto const& graphicsObject = connection.getConnectionGraphicsObject();
-  bool const selected = graphicsObject.isSelected();
-
+  painter->setBrush(Qt::NoBrush);
 
-  auto cubic = cubicPath(geom);
-  if (gradientColor)
+  if (colors.gradient)
   {
-    painter->setBrush(Qt::NoBrush);
-
-    QColor c = normalColorOut; 
-    if (selected)
-      c = c.darker(200);
-    p.setColor(c);
+    p.setColor(colors.out);
     painter->setPen(p);
 
-    unsigned int const segments = 60;
+    QPolygonF const & points = geom.polyline();
 
-    for (unsigned int i = 0ul; i < segments; ++i)
-    {
-      double ratioPrev = double(i) / segments;
-      double ratio = double(i + 1) / segments;
+    int const half = ConnectionGeometry::polylineSegments / 2;
 
-      if (i == segments / 2)
-      {
-        QColor c = normalColorIn; 
-        if (selected)
-          c = c.darker(200);
+    // Each half in one call, in its end's color
+    painter->drawPolyline(points.constData(), half + 1);
 
-        p.setColor(c);
-        painter->setPen(p);
-      }
-      painter->drawLine(cubic.pointAtPercent(ratioPrev),
-                        cubic.pointAtPercent(ratio));
-    }
+    p.setColor(colors.in);
+    painter->setPen(p);
 
-    {
-      QIcon icon(":convert.png");
+    painter->drawPolyline(points.constData() + half, points.size() - half);
 
-      QPixmap pixmap = icon.pixmap(QSize(22, 22));
-      painter->drawPixmap(cubic.pointAtPercent(0.50) - QPoint(pixmap.width()/2,
-                                                              pixmap.height()/2),
+    {
+      QPixmap pixmap = converterIcon();
+      painter->drawPixmap(converterPosition(geom) - QPointF(pixmap.width()/2,
+                                                            pixmap.height()/2),
                           pixmap);
-
     }
   }
   else
   {
-    p.setColor(normalColorOut);
+    p.setColor(colors.out);
+    painter->setPen(p);
 
-    if (selected)
-    {
-      p.setColor(selectedColor);
-    }
+    painter->drawPath(geom.cubicPath());
+  }
+}
 
-    painter->setPen(p);
-    painter->setBrush(Qt::NoBrush);
 
-    painter->drawPath(cubic);
+/// Color of the single stroke drawn below full detail
+static
+QColor
+coarseColor(Connection const & connection)
+{
+  if (connection.connectionState().requiresPort())
+    return QtNodes::StyleCollection::connectionStyle().constructionColor();
+
+  bool const selected = connectionGraphicsObject(connection).isSelected();
+
+  return lineColors(connection, selected).out;
+}
+
+
+/// A single stroke in one color, straight at the lowest level
+static
+void
+drawCoarseLine(QPainter * painter,
+               Connection const & connection,
+               QtNodes::FlowViewStyle::DetailLevel detail)
+{
+  using QtNodes::ConnectionGeometry;
+  using QtNodes::FlowViewStyle;
+
+  auto const &connectionStyle =
+    QtNodes::StyleCollection::connectionStyle();
+
+  ConnectionGeometry const& geom = connection.connectionGeometry();
+
+  QPen p(coarseColor(connection), connectionStyle.lineWidth());
+
+  painter->setPen(p);
+  painter->setBrush(Qt::NoBrush);
+
+  if (detail == FlowViewStyle::DetailLevel::Low)
+  {
+    bool const antialiased = painter->testRenderHint(QPainter::Antialiasing);
+
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    painter->drawLine(geom.source(), geom.sink());
+    painter->setRenderHint(QPainter::Antialiasing, antialiased);
+  }
+  else
+  {
+    painter->drawPath(geom.cubicPath());
   }
 }
 
@@ -282,8 +332,15 @@ drawNormalLine(QPainter * painter,
 void
 ConnectionPainter::
 paint(QPainter* painter,
-      Connection const &connection)
+      Connection const &connection,
+      FlowViewStyle::DetailLevel detail)
 {
+  if (detail != FlowViewStyle::DetailLevel::Full)
+  {
+    drawCoarseLine(painter, connection, detail);
+    return;
+  }
+
   drawHoveredOrSelected(painter, connection);
 
   drawSketchLine(painter, connection);
@@ -311,3 +368,198 @@ paint(QPainter* painter,
   painter->drawEllipse(source, pointRadius, pointRadius);
   painter->drawEllipse(sink, pointRadius, pointRadius);
 }
+
+
+namespace
+{
+
+/// Outlines collected per pen, stroked in the order the pens were first
+/// asked for
+class PenGroups
+{
+public:
+
+  QPainterPath &
+  path(QPen const & pen)
+  {
+    auto const key = std::make_tuple(pen.color().rgba(),
+                                     pen.widthF(),
+                                     static_cast<int>(pen.style()));
+
+    auto it = _groups.find(key);
+
+    if (it == _groups.end())
+    {
+      it = _groups.emplace(key, _strokes.size()).first;
+
+      _strokes.emplace_back(pen, QPainterPath());
+    }
+
+    return _strokes[it->second].second;
+  }
+
+  void
+  draw(QPainter * painter) const
+  {
+    painter->setBrush(Qt::NoBrush);
+
+    for (auto const & stroke : _strokes)
+    {
+      painter->setPen(stroke.first);
+      painter->drawPath(stroke.second);
+    }
+  }
+
+private:
+
+  std::map<std::tuple<QRgb, qreal, int>, std::size_t> _groups;
+
+  std::vector<std::pair<QPen, QPainterPath>> _strokes;
+};
+
+}
+
+
+void
+ConnectionPainter::
+paintLayer(QPainter* painter,
+           std::vector<Connection const*> const & connections,
+           FlowViewStyle::DetailLevel detail)
+{
+  auto const & connectionStyle =
+    QtNodes::StyleCollection::connectionStyle();
+
+  double const lineWidth = connectionStyle.lineWidth();
+
+  if (detail != FlowViewStyle::DetailLevel::Full)
+  {
+    PenGroups lines;
+
+    for (Connection const * connection : connections)
+    {
+      ConnectionGeometry const & geom = connection->connectionGeometry();
+
+      QTransform const transform =
+        connectionGraphicsObject(*connection).sceneTransform();
+
+      QPainterPath & path = lines.path(QPen(coarseColor(*connection), lineWidth));
+
+      if (detail == FlowViewStyle::DetailLevel::Low)
+      {
+        path.moveTo(transform.map(geom.source()));
+        path.lineTo(transform.map(geom.sink()));
+      }
+      else
+      {
+        path.addPath(transform.map(geom.cubicPath()));
+      }
+    }
+
+    bool const antialiased = painter->testRenderHint(QPainter::Antialiasing);
+
+    if (detail == FlowViewStyle::DetailLevel::Low)
+      painter->setRenderHint(QPainter::Antialiasing, false);
+
+    lines.draw(painter);
+
+    painter->setRenderHint(QPainter::Antialiasing, antialiased);
+
+    return;
+  }
+
+  // Drawn bottom to top, as each connection is drawn by paint()
+  PenGroups halos;
+  PenGroups sketches;
+  PenGroups lines;
+
+  std::vector<QPointF> converters;
+
+  QPainterPath endPoints;
+
+  double const pointRadius = connectionStyle.pointDiameter() / 2.0;
+
+  for (Connection const * connection : connections)
+  {
+    ConnectionGeometry const & geom = connection->connectionGeometry();
+
+    auto const & graphicsObject = connectionGraphicsObject(*connection);
+
+    QTransform const transform = graphicsObject.sceneTransform();
+
+    bool const selected = graphicsObject.isSelected();
+
+    QPainterPath const curve = transform.map(geom.cubicPath());
+
+    if (geom.hovered() || selected)
+    {
+      QPen p;
+
+      p.setWidth(2 * lineWidth);
+      p.setColor(selected ?
+                 connectionStyle.selectedHaloColor() :
+                 connectionStyle.hoveredColor());
+
+      halos.path(p).addPath(curve);
+    }
+
+    if (connection->connectionState().requiresPort())
+    {
+      QPen p;
+
+      p.setWidth(connectionStyle.constructionLineWidth());
+      p.setColor(connectionStyle.constructionColor());
+      p.setStyle(Qt::DashLine);
+
+      sketches.path(p).addPath(curve);
+    }
+    else
+    {
+      LineColors const colors = lineColors(*connection, selected);
+
+      QPen p;
+
+      p.setWidth(lineWidth);
+      p.setColor(colors.out);
+
+      if (colors.gradient)
+      {
+        QPolygonF const & points = geom.polyline();
+
+        int const half = ConnectionGeometry::polylineSegments / 2;
+
+        lines.path(p).addPolygon(transform.map(QPolygonF(points.mid(0, half + 1))));
+
+        p.setColor(colors.in);
+
+        lines.path(p).addPolygon(transform.map(QPolygonF(points.mid(half))));
+
+        converters.push_back(transform.map(converterPosition(geom)));
+      }
+      else
+      {
+        lines.path(p).addPath(curve);
+      }
+    }
+
+    endPoints.addEllipse(transform.map(geom.source()), pointRadius, pointRadius);
+    endPoints.addEllipse(transform.map(geom.sink()), pointRadius, pointRadius);
+  }
+
+  halos.draw(painter);
+  sketches.draw(painter);
+  lines.draw(painter);
+
+  if (!converters.empty())
+  {
+    QPixmap const pixmap = converterIcon();
+
+    QPointF const offset(pixmap.width() / 2, pixmap.height() / 2);
+
+    for (QPointF const & position : converters)
+      painter->drawPixmap(position - offset, pixmap);
+  }
+
+  painter->setPen(connectionStyle.constructionColor());
+  painter->setBrush(connectionStyle.constructionColor());
+  painter->drawPath(endPoints);
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <vector>
+
 #include <QtGui/QPainter>
 
+#include "FlowViewStyle.hpp"
+
 namespace QtNodes
 {
 
@@ -16,7 +20,17 @@ public:
   static
   void
   paint(QPainter* painter,
-        Connection const& connection);
+        Connection const& connection,
+        FlowViewStyle::DetailLevel detail = FlowViewStyle::DetailLevel::Full);
+
+  /// Draws the connections as paint() draws each of them, but strokes
+  /// every pen once for all of them: halos first, then the lines, then
+  /// the end points. The painter is in scene coordinates.
+  static
+  void
+  paintLayer(QPainter* painter,
+             std::vector<Connection const*> const& connections,
+             FlowViewStyle::DetailLevel detail);
 
   static
   QPainterPath
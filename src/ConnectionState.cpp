@@ -4,7 +4,6 @@
 
 #include <QtCore/QPointF>
 
-#include "FlowScene.hpp"
 #include "Node.hpp"
 
 using QtNodes::ConnectionState;
@@ -1,7 +1,6 @@
 #include "DataModelRegistry.hpp"
 
 #include <QtCore/QFile>
-#include <QtWidgets/QMessageBox>
 
 using QtNodes::DataModelRegistry;
 using QtNodes::NodeDataModel;
@@ -0,0 +1,153 @@
+#include "DataflowExecutor.hpp"
+
+#include <utility>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMetaObject>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "FlowGraph.hpp"
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+
+using QtNodes::DataflowExecutor;
+using QtNodes::Node;
+using QtNodes::NodeData;
+using QtNodes::NodeDataModel;
+using QtNodes::PortIndex;
+
+DataflowExecutor::
+DataflowExecutor(QObject * parent)
+  : QObject(parent)
+  , _serial(0)
+{}
+
+
+DataflowExecutor::
+~DataflowExecutor()
+{
+  // Pending inputs are dropped; queued completions die with this object
+  _tasks.clear();
+  _pool.waitForDone();
+}
+
+
+void
+DataflowExecutor::
+schedule(Node& node,
+         std::shared_ptr<NodeData> nodeData,
+         PortIndex inPortIndex)
+{
+  Task & task = _tasks[&node];
+
+  task.pending.push_back(Input{inPortIndex, std::move(nodeData)});
+
+  if (!task.active)
+    start(node, task);
+}
+
+
+void
+DataflowExecutor::
+cancel(Node& node)
+{
+  auto it = _tasks.find(&node);
+  if (it == _tasks.end())
+    return;
+
+  it->second.pending.clear();
+  it->second.running.waitForFinished();
+
+  _tasks.erase(it);
+}
+
+
+void
+DataflowExecutor::
+flush()
+{
+  auto tasks = std::move(_tasks);
+  _tasks.clear();
+
+  for (auto & pair : tasks)
+  {
+    Node * node = pair.first;
+    Task & task = pair.second;
+
+    task.running.waitForFinished();
+
+    // Its completion, still queued, is dropped with the task
+    if (task.active)
+      node->dataApplied(task.running.result());
+
+    for (Input & input : task.pending)
+      node->applyData(std::move(input.data), input.port);
+  }
+}
+
+
+bool
+DataflowExecutor::
+idle() const
+{
+  return _tasks.empty();
+}
+
+
+void
+DataflowExecutor::
+start(Node& node, Task& task)
+{
+  Input input = std::move(task.pending.front());
+  task.pending.pop_front();
+
+  task.active = true;
+  task.serial = ++_serial;
+
+  NodeDataModel * model  = node.nodeDataModel();
+  Node *          target = &node;
+  unsigned int    serial = task.serial;
+  bool            timed  = node.getGraph().profiling();
+
+  task.running = QtConcurrent::run(&_pool, [this, model, target, serial, timed, input]()
+  {
+    QElapsedTimer timer;
+
+    if (timed)
+      timer.start();
+
+    model->setInData(input.data, input.port);
+
+    qint64 const elapsed = timed ? timer.nsecsElapsed() : -1;
+
+    // Back to the GUI thread for the graphics and the next input
+    QMetaObject::invokeMethod(this,
+                              [this, target, serial, elapsed]() { finished(target, serial, elapsed); },
+                              Qt::QueuedConnection);
+
+    return elapsed;
+  });
+}
+
+
+void
+DataflowExecutor::
+finished(Node* node, unsigned int serial, qint64 elapsed)
+{
+  auto it = _tasks.find(node);
+
+  // The node was cancelled, and maybe its address reused, in the meantime
+  if (it == _tasks.end() || it->second.serial != serial)
+    return;
+
+  Task & task = it->second;
+
+  task.active = false;
+
+  node->dataApplied(elapsed);
+
+  if (!task.pending.empty())
+    start(*node, task);
+  else
+    _tasks.erase(it);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include <QtCore/QObject>
+#include <QtCore/QThreadPool>
+#include <QtCore/QFuture>
+
+#include "PortType.hpp"
+#include "NodeData.hpp"
+
+namespace QtNodes
+{
+
+class Node;
+
+/// Runs NodeDataModel::setInData of thread safe models on a thread pool.
+/// Inputs of one node are applied one after another, in arrival order,
+/// while independent nodes run in parallel. Results travel downstream
+/// through the models' dataUpdated signals, which Qt queues back to the
+/// GUI thread, so data dependencies are respected. Each applied input is
+/// reported to Node::dataApplied on the GUI thread, as on the serial path.
+class DataflowExecutor
+  : public QObject
+{
+public:
+
+  DataflowExecutor(QObject * parent = nullptr);
+
+  ~DataflowExecutor() override;
+
+public:
+
+  void
+  schedule(Node& node,
+           std::shared_ptr<NodeData> nodeData,
+           PortIndex inPortIndex);
+
+  /// Drops the pending inputs of the node and waits for its running task.
+  /// Must be called before the node is destroyed.
+  void
+  cancel(Node& node);
+
+  /// Waits for the running tasks, then applies every pending input
+  /// on the calling thread.
+  void
+  flush();
+
+  /// No input pending or running. A finished task stays until its
+  /// completion is delivered through the event loop.
+  bool
+  idle() const;
+
+private:
+
+  struct Input
+  {
+    PortIndex                 port;
+    std::shared_ptr<NodeData> data;
+  };
+
+  struct Task
+  {
+    std::deque<Input> pending;
+    /// Nanoseconds the model took, negative unless profiling
+    QFuture<qint64>   running;
+    bool              active = false;
+    unsigned int      serial = 0;
+  };
+
+  void
+  start(Node& node, Task& task);
+
+  void
+  finished(Node* node, unsigned int serial, qint64 elapsed);
+
+private:
+
+  QThreadPool _pool;
+
+  std::unordered_map<Node*, Task> _tasks;
+
+  unsigned int _serial;
+};
+}
@@ -0,0 +1,1786 @@
+#include "FlowGraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <unordered_set>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QBuffer>
+#include <QtCore/QDataStream>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QLineF>
+#include <QtCore/QTimer>
+#include <QtCore/QCborMap>
+#include <QtCore/QCborStreamReader>
+#include <QtCore/QCborStreamWriter>
+#include <QtCore/QCborValue>
+
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QJsonArray>
+#include <QtCore/QtGlobal>
+#include <QtCore/QDebug>
+
+#include "Node.hpp"
+#include "Connection.hpp"
+
+#include "DataModelRegistry.hpp"
+#include "GraphFrontEnd.hpp"
+#include "TopologicalScheduler.hpp"
+#include "DataflowExecutor.hpp"
+#include "BlockPool.hpp"
+#include "UndoPayloadStore.hpp"
+#include "SceneContainer.hpp"
+#include "SceneJournal.hpp"
+
+using namespace QtNodes;
+
+// The CBOR self-describe tag, 55799
+static QByteArray const cborSignature("\xd9\xd9\xf7", 3);
+
+// Chunk bounds only cover node positions, the nodes reach further
+static qreal const chunkMargin = 512.0;
+
+// Time spent restoring chunks per event loop iteration
+static qint64 const streamSliceMs = 8;
+
+
+/// A chunked file being restored. Connections wait for both their nodes.
+struct FlowGraph::ContainerLoad
+{
+  SceneContainerReader reader;
+
+  /// Chunks still to restore, the next one last
+  std::vector<std::size_t> pendingChunks;
+
+  std::vector<QJsonObject> connections;
+  std::vector<bool>        connectionRestored;
+
+  /// Connection indices by the ids of both their nodes
+  std::unordered_multimap<QUuid, std::size_t> connectionsByNode;
+
+  /// Context of the queued streaming steps, which die with the load
+  QObject context;
+};
+
+
+FlowGraph::
+FlowGraph(std::shared_ptr<DataModelRegistry> registry,
+          QObject * parent)
+  : QObject(parent)
+  , _registry(std::move(registry))
+  , _connectionPool(std::make_shared<BlockPool>())
+  , _scheduler(detail::make_unique<TopologicalScheduler>())
+  , _undoPayloads(detail::make_unique<UndoPayloadStore>())
+  , _frontEnd(nullptr)
+  , _profiling(false)
+  , _countingLoad(false)
+  , _tearingDown(false)
+  , _propagationMode(PropagationMode::Push)
+  , _updateWaveScheduled(false)
+  , _processingUpdateWave(false)
+  , _coalescedUpdateCount(0)
+  , _pendingConversions(0)
+{}
+
+FlowGraph::
+FlowGraph(QObject * parent)
+  : FlowGraph(std::make_shared<DataModelRegistry>(),
+              parent)
+{}
+
+
+FlowGraph::
+~FlowGraph()
+{
+  clear();
+}
+
+
+void
+FlowGraph::
+setFrontEnd(GraphFrontEnd * frontEnd)
+{
+  _frontEnd = frontEnd;
+}
+
+
+GraphFrontEnd *
+FlowGraph::
+frontEnd() const
+{
+  return _frontEnd;
+}
+
+
+//------------------------------------------------------------------------------
+
+void
+FlowGraph::
+setExecutionMode(ExecutionMode mode)
+{
+  if (mode == executionMode())
+    return;
+
+  if (mode == ExecutionMode::Parallel)
+  {
+    _executor = detail::make_unique<DataflowExecutor>();
+  }
+  else
+  {
+    // Inputs still queued are applied here, on the GUI thread
+    std::unique_ptr<DataflowExecutor> executor = std::move(_executor);
+    executor->flush();
+  }
+}
+
+
+FlowGraph::ExecutionMode
+FlowGraph::
+executionMode() const
+{
+  return _executor ? ExecutionMode::Parallel : ExecutionMode::Synchronous;
+}
+
+
+DataflowExecutor *
+FlowGraph::
+executor() const
+{
+  return _executor.get();
+}
+
+
+void
+FlowGraph::
+setProfiling(bool profiling)
+{
+  _profiling = profiling;
+}
+
+
+bool
+FlowGraph::
+profiling() const
+{
+  return _profiling;
+}
+
+
+void
+FlowGraph::
+setPropagationMode(PropagationMode mode)
+{
+  if (mode == _propagationMode)
+    return;
+
+  PropagationMode const previous = _propagationMode;
+
+  _propagationMode = mode;
+
+  if (previous == PropagationMode::Coalesced)
+  {
+    processUpdateWave();
+  }
+  else if (previous == PropagationMode::Pull)
+  {
+    // Upstream first, so every pull reads fresh data
+    std::vector<Node*> const order = _scheduler->order();
+
+    for (Node * node : order)
+      node->pullInputs();
+
+    for (Node * node : _scheduler->cyclicNodes())
+      node->pullInputs();
+  }
+}
+
+
+FlowGraph::PropagationMode
+FlowGraph::
+propagationMode() const
+{
+  return _propagationMode;
+}
+
+
+void
+FlowGraph::
+pullNode(Node& node)
+{
+  if (!node.nodeState().isDirty())
+    return;
+
+  // Post-order walk of the dirty nodes feeding the dirty inputs
+  std::vector<Node*> cone;
+  std::unordered_set<Node*> visited;
+  std::vector<std::pair<Node*, bool>> stack;
+
+  stack.emplace_back(&node, false);
+
+  while (!stack.empty())
+  {
+    Node * current  = stack.back().first;
+    bool   expanded = stack.back().second;
+    stack.pop_back();
+
+    if (expanded)
+    {
+      cone.push_back(current);
+      continue;
+    }
+
+    if (!visited.insert(current).second)
+      continue;
+
+    stack.emplace_back(current, true);
+
+    NodeState const & state = current->nodeState();
+    auto const & inEntries = state.getEntries(PortType::In);
+
+    for (PortIndex i = 0; i < static_cast<PortIndex>(inEntries.size()); ++i)
+    {
+      if (!state.inputDirty(i))
+        continue;
+
+      for (Connection * c : inEntries[i])
+      {
+        Node * upstream = c->getNode(PortType::Out);
+
+        if (upstream && upstream->nodeState().isDirty() &&
+            visited.count(upstream) == 0)
+          stack.emplace_back(upstream, false);
+      }
+    }
+  }
+
+  for (Node * n : cone)
+    n->pullInputs();
+}
+
+
+void
+FlowGraph::
+requestPull(Node& node)
+{
+  _pullRequests.push_back(node.handle());
+
+  if (_pullRequests.size() == 1)
+    QTimer::singleShot(0, this, &FlowGraph::processPullRequests);
+}
+
+
+void
+FlowGraph::
+processPullRequests()
+{
+  std::vector<SlotHandle> requests;
+  requests.swap(_pullRequests);
+
+  for (SlotHandle handle : requests)
+  {
+    if (Node * n = node(handle))
+      pullNode(*n);
+  }
+}
+
+
+void
+FlowGraph::
+queueDataUpdate(Node& node, PortIndex index)
+{
+  auto const key = std::make_tuple(_scheduler->position(node), &node, index);
+
+  if (!_queuedUpdates.insert(key).second)
+  {
+    ++_coalescedUpdateCount;
+
+    // Pushed right away, it would have fed every connected input again
+    if (_countingLoad)
+      _loadStatistics.savedEvaluations += node.nodeState().connections(PortType::Out, index).size();
+
+    return;
+  }
+
+  // A batch pushes its wave on commit
+  if (!_updateWaveScheduled && !isBatching())
+  {
+    _updateWaveScheduled = true;
+    QTimer::singleShot(0, this, &FlowGraph::processUpdateWave);
+  }
+}
+
+
+std::size_t
+FlowGraph::
+coalescedUpdateCount() const
+{
+  return _coalescedUpdateCount;
+}
+
+
+void
+FlowGraph::
+resetCoalescedUpdateCount()
+{
+  _coalescedUpdateCount = 0;
+}
+
+
+bool
+FlowGraph::
+queuesDataUpdates() const
+{
+  return _propagationMode == PropagationMode::Coalesced ||
+         _processingUpdateWave ||
+         isBatching();
+}
+
+
+bool
+FlowGraph::
+isIdle() const
+{
+  return !isBatching() &&
+         !_updateWaveScheduled &&
+         _queuedUpdates.empty() &&
+         _pullRequests.empty() &&
+         _pendingConversions == 0 &&
+         (!_executor || _executor->idle());
+}
+
+
+void
+FlowGraph::
+processUpdateWave()
+{
+  _updateWaveScheduled = false;
+
+  if (_processingUpdateWave)
+    return;
+
+  // Connections made since the updates were queued may have moved nodes
+  // in the order
+  decltype(_queuedUpdates) updates;
+
+  for (auto const & update : _queuedUpdates)
+  {
+    Node * node = std::get<1>(update);
+    updates.emplace(_scheduler->position(*node), node, std::get<2>(update));
+  }
+
+  _queuedUpdates.swap(updates);
+
+  _processingUpdateWave = true;
+
+  // Updates raised by the pushes below join this wave. They sort after the
+  // node that raised them, so each port is still pushed once.
+  while (!_queuedUpdates.empty())
+  {
+    auto const update = *_queuedUpdates.begin();
+    _queuedUpdates.erase(_queuedUpdates.begin());
+
+    Node * const    node  = std::get<1>(update);
+    PortIndex const index = std::get<2>(update);
+
+    if (_countingLoad)
+      _loadStatistics.evaluations += node->nodeState().connections(PortType::Out, index).size();
+
+    node->pushData(index);
+  }
+
+  _processingUpdateWave = false;
+}
+
+
+void
+FlowGraph::
+beginBatch()
+{
+  ++_batch.depth;
+}
+
+
+void
+FlowGraph::
+commitBatch()
+{
+  Q_ASSERT(_batch.depth > 0);
+
+  if (--_batch.depth > 0)
+    return;
+
+  publishBatch();
+
+  processUpdateWave();
+}
+
+
+void
+FlowGraph::
+publishBatch()
+{
+  // Taken out first, the slots below may start a batch of their own
+  std::vector<std::pair<SlotHandle, bool>> batchNodes;
+  std::vector<SlotHandle>                  batchConnections;
+
+  batchNodes.swap(_batch.nodes);
+  batchConnections.swap(_batch.connections);
+
+  // Items removed during the batch are skipped. Nodes are shown first,
+  // connections attach to their ports.
+  std::vector<Node*> nodes;
+  nodes.reserve(batchNodes.size());
+
+  for (auto const & entry : batchNodes)
+  {
+    Node * n = node(entry.first);
+
+    if (n == nullptr)
+      continue;
+
+    if (_frontEnd)
+      _frontEnd->showNode(*n);
+
+    nodes.push_back(n);
+  }
+
+  std::vector<Connection*> connections;
+  connections.reserve(batchConnections.size());
+
+  for (SlotHandle handle : batchConnections)
+  {
+    Connection * c = connection(handle);
+
+    if (c == nullptr)
+      continue;
+
+    if (_frontEnd)
+      _frontEnd->showConnection(*c);
+
+    connections.push_back(c);
+  }
+
+  for (std::size_t i = 0, j = 0; i < batchNodes.size(); ++i)
+  {
+    if (j == nodes.size() || nodes[j]->handle() != batchNodes[i].first)
+      continue;
+
+    if (batchNodes[i].second)
+      nodePlaced(*nodes[j]);
+
+    nodeCreated(*nodes[j]);
+    ++j;
+  }
+
+  for (Connection * connection : connections)
+    announceConnection(*connection);
+}
+
+
+bool
+FlowGraph::
+isBatching() const
+{
+  return _batch.depth > 0;
+}
+
+
+FlowGraph::LoadStatistics const &
+FlowGraph::
+lastLoadStatistics() const
+{
+  return _loadStatistics;
+}
+
+
+std::size_t
+FlowGraph::
+connectionBlockSize() const
+{
+  return _connectionPool->blockSize();
+}
+
+
+void
+FlowGraph::
+beginLoad()
+{
+  _loadStatistics = LoadStatistics();
+  _countingLoad   = true;
+
+  beginBatch();
+}
+
+
+void
+FlowGraph::
+endLoad()
+{
+  commitBatch();
+
+  _countingLoad = false;
+}
+
+
+//------------------------------------------------------------------------------
+
+std::shared_ptr<Connection>
+FlowGraph::
+createConnection(PortType connectedPort,
+                 Node& node,
+                 PortIndex portIndex)
+{
+  auto connection =
+    std::allocate_shared<Connection>(PoolAllocator<Connection>(_connectionPool),
+                                     connectedPort, node, portIndex);
+
+  storeConnection(connection);
+
+  // Dragged from the start, it shows outside of batches as well
+  if (_frontEnd)
+    _frontEnd->showConnection(*connection);
+
+  // Note: this connection isn't truly created yet. It's only partially created.
+  // Thus, don't send the connectionCreated(...) signal. The connection
+  // reports its completion through connectionMadeComplete(...).
+
+  return connection;
+}
+
+
+std::shared_ptr<Connection>
+FlowGraph::
+createConnection(Node& nodeIn,
+                 PortIndex portIndexIn,
+                 Node& nodeOut,
+                 PortIndex portIndexOut,
+				 SharedTypeConverter converter,
+				 QUuid id,
+				 bool sendSignal)
+{
+  auto connection =
+    std::allocate_shared<Connection>(PoolAllocator<Connection>(_connectionPool),
+                                     nodeIn,
+                                     portIndexIn,
+                                     nodeOut,
+                                     portIndexOut,
+                                     converter,
+                                     id);
+
+  nodeIn.nodeState().setConnection(PortType::In, portIndexIn, *connection);
+  nodeOut.nodeState().setConnection(PortType::Out, portIndexOut, *connection);
+
+  if(sendSignal)
+	{
+	connection->getNode( PortType::Out )->nodeDataModel()->outputConnectionCreated( connection->getPortIndex( PortType::Out ) );
+	connection->getNode( PortType::In )->nodeDataModel()->inputConnectionCreated( connection->getPortIndex( PortType::In ) );
+	}
+
+  // trigger data propagation
+  nodeOut.onDataUpdated(portIndexOut);
+
+  storeConnection(connection);
+
+  if (isBatching())
+  {
+    _batch.connections.push_back(connection->handle());
+  }
+  else
+  {
+    if (_frontEnd)
+      _frontEnd->showConnection(*connection);
+
+    announceConnection(*connection);
+  }
+
+  return connection;
+}
+
+
+std::shared_ptr<Connection>
+FlowGraph::
+restoreConnection(QJsonObject const &connectionJson, bool sendSignal)
+{
+  QUuid connectionID = QUuid(connectionJson["id"].toString());
+
+  QUuid nodeInId  = QUuid(connectionJson["in_id"].toString());
+  QUuid nodeOutId = QUuid(connectionJson["out_id"].toString());
+
+  PortIndex portIndexIn  = connectionJson["in_index"].toInt();
+  PortIndex portIndexOut = connectionJson["out_index"].toInt();
+
+  auto nodeIn  = node(nodeInId);
+  auto nodeOut = node(nodeOutId);
+
+  if (!nodeIn || !nodeOut)
+    throw std::logic_error("Connection refers to an unknown node");
+
+  auto getConverter = [&]()
+  {
+    QJsonValue converterVal = connectionJson["converter"];
+
+    if (!converterVal.isUndefined())
+    {
+      QJsonObject converterJson = converterVal.toObject();
+
+      NodeDataType inType { converterJson["in"].toObject()["id"].toString(),
+                            converterJson["in"].toObject()["name"].toString() };
+
+      NodeDataType outType { converterJson["out"].toObject()["id"].toString(),
+                             converterJson["out"].toObject()["name"].toString() };
+
+      auto converter  =
+        registry().getTypeConverter(outType, inType);
+
+      if (converter)
+        return converter;
+    }
+
+    return SharedTypeConverter( nullptr );
+  };
+
+  std::shared_ptr<Connection> connection =
+    createConnection(*nodeIn, portIndexIn,
+                     *nodeOut, portIndexOut,
+					 getConverter(),
+					 connectionID,
+					 sendSignal);
+
+  // Note: the connectionCreated(...) signal has already been sent
+  // by createConnection(...)
+
+  return connection;
+}
+
+
+void
+FlowGraph::
+deleteConnection(Connection& connection, bool sendSignal)
+{
+  SlotHandle const handle = connection.handle();
+
+  if (_connections.contains(handle)) {
+	if(sendSignal)
+	  {
+	  connection.getNode(PortType::Out)->nodeDataModel()->outputConnectionDeleted( connection.getPortIndex( PortType::Out ) );
+	  connection.getNode(PortType::In)->nodeDataModel()->inputConnectionDeleted( connection.getPortIndex( PortType::In ) );
+	  }
+	connection.removeFromNodes();
+    unscheduleConnection(connection);
+    _connectionIds.erase(connection.id());
+    _connections.erase(handle);
+  }
+}
+
+Node&
+FlowGraph::
+storeNode(UniqueNode node)
+{
+  Node & stored = *node;
+
+  SlotHandle const handle = _nodes.insert(std::move(node));
+
+  stored.setHandle(handle);
+  _nodeIds[stored.id()] = handle;
+
+  return stored;
+}
+
+
+void
+FlowGraph::
+storeConnection(SharedConnection const & connection)
+{
+  SlotHandle const handle = _connections.insert(connection);
+
+  connection->setHandle(handle);
+  _connectionIds[connection->id()] = handle;
+
+  scheduleConnection(*connection);
+}
+
+
+void
+FlowGraph::
+scheduleConnection(Connection const& c)
+{
+  // Partial connections are ordered once they get their second end
+  if (!c.complete())
+    return;
+
+  _scheduler->addEdge(*c.getNode(PortType::Out), *c.getNode(PortType::In));
+}
+
+
+void
+FlowGraph::
+unscheduleConnection(Connection const& c)
+{
+  // The scheduler is cleared as a whole
+  if (_tearingDown || !c.complete())
+    return;
+
+  _scheduler->removeEdge(*c.getNode(PortType::Out), *c.getNode(PortType::In));
+}
+
+
+Node&
+FlowGraph::
+createNode(std::unique_ptr<NodeDataModel> && dataModel)
+{
+  auto node = detail::make_unique<Node>(std::move(dataModel), *this);
+
+  auto nodePtr = &storeNode(std::move(node));
+
+  _scheduler->addNode(*nodePtr);
+
+  if (isBatching())
+  {
+    _batch.nodes.emplace_back(nodePtr->handle(), false);
+  }
+  else
+  {
+    if (_frontEnd)
+      _frontEnd->showNode(*nodePtr);
+
+    nodeCreated(*nodePtr);
+  }
+
+  return *nodePtr;
+}
+
+
+Node&
+FlowGraph::
+restoreNode(QJsonObject const& nodeJson)
+{
+  QString modelName = nodeJson["model"].toObject()["name"].toString();
+
+  auto dataModel = registry().create(modelName);
+
+  if (!dataModel)
+    throw std::logic_error(std::string("No registered model with name ") +
+                           modelName.toLocal8Bit().data());
+
+  auto node = detail::make_unique<Node>(std::move(dataModel), *this);
+
+  node->restore(nodeJson);
+
+  auto nodePtr = &storeNode(std::move(node));
+
+  _scheduler->addNode(*nodePtr);
+
+  if (isBatching())
+  {
+    _batch.nodes.emplace_back(nodePtr->handle(), true);
+  }
+  else
+  {
+    if (_frontEnd)
+      _frontEnd->showNode(*nodePtr);
+
+    nodePlaced(*nodePtr);
+    nodeCreated(*nodePtr);
+  }
+
+  return *nodePtr;
+}
+
+
+void
+FlowGraph::
+removeNode(Node& node)
+{
+  // call signal
+  nodeDeleted(node);
+
+  for(auto portType: {PortType::In,PortType::Out})
+  {
+	auto const & nodeEntries = node.nodeState().getEntries(portType);
+
+	for (auto &connections : nodeEntries)
+	{
+      // Each deletion erases the connection from the set
+      while (!connections.empty())
+		{
+		//undoStack->push( new ConnectionRemoveCommand( *connections.back() ) );
+		deleteConnection(*connections.back());
+		}
+    }
+  }
+
+  _scheduler->removeNode(node);
+
+  if (_executor)
+    _executor->cancel(node);
+
+  for (auto it = _queuedUpdates.begin(); it != _queuedUpdates.end();)
+  {
+    if (std::get<1>(*it) == &node)
+      it = _queuedUpdates.erase(it);
+    else
+      ++it;
+  }
+
+  _nodeIds.erase(node.id());
+  _nodes.erase(node.handle());
+}
+
+
+void
+FlowGraph::
+removeNodes(std::vector<Node*> const & nodes,
+            std::vector<Connection*> const & connections)
+{
+  if (nodes.empty() && connections.empty())
+    return;
+
+  _removing.insert(nodes.begin(), nodes.end());
+
+  // Inputs left unconnected get their empty data right away, what they
+  // recompute is pushed downstream once, on commit
+  beginBatch();
+
+  // One selection change rather than one per selected item
+  if (_frontEnd)
+    _frontEnd->removingItems();
+
+  for (Node * node : nodes)
+    nodeDeleted(*node);
+
+  std::vector<Connection*> doomed(connections);
+
+  std::unordered_set<Connection*> const given(connections.begin(), connections.end());
+
+  for (Node * node : nodes)
+  {
+    for (auto portType : {PortType::In, PortType::Out})
+    {
+      for (auto const & entries : node->nodeState().getEntries(portType))
+      {
+        for (Connection * c : entries)
+        {
+          if (!given.count(c))
+            doomed.push_back(c);
+        }
+      }
+    }
+  }
+
+  // A connection between two removed nodes is met from both ends
+  std::sort(doomed.begin(), doomed.end());
+  doomed.erase(std::unique(doomed.begin(), doomed.end()), doomed.end());
+
+  for (Connection * c : doomed)
+  {
+    Node * out = c->getNode(PortType::Out);
+    Node * in  = c->getNode(PortType::In);
+
+    if (out && !isRemoving(*out))
+      out->nodeDataModel()->outputConnectionDeleted(c->getPortIndex(PortType::Out));
+
+    if (in && !isRemoving(*in))
+      in->nodeDataModel()->inputConnectionDeleted(c->getPortIndex(PortType::In));
+
+    deleteConnection(*c);
+  }
+
+  _scheduler->removeNodes(nodes);
+
+  for (auto it = _queuedUpdates.begin(); it != _queuedUpdates.end();)
+  {
+    if (_removing.count(std::get<1>(*it)))
+      it = _queuedUpdates.erase(it);
+    else
+      ++it;
+  }
+
+  for (Node * node : nodes)
+  {
+    if (_executor)
+      _executor->cancel(*node);
+
+    _nodeIds.erase(node->id());
+    _nodes.erase(node->handle());
+  }
+
+  _removing.clear();
+
+  commitBatch();
+}
+
+
+bool
+FlowGraph::
+isRemoving(Node const & node) const
+{
+  return _removing.count(&node) > 0;
+}
+
+
+DataModelRegistry&
+FlowGraph::
+registry() const
+{
+  return *_registry;
+}
+
+
+void
+FlowGraph::
+setRegistry(std::shared_ptr<DataModelRegistry> registry)
+{
+  _registry = std::move(registry);
+}
+
+
+void
+FlowGraph::
+iterateOverNodes(std::function<void(Node*)> const & visitor)
+{
+  for (const auto& _node : _nodes)
+  {
+    visitor(_node.get());
+  }
+}
+
+
+void
+FlowGraph::
+iterateOverNodeData(std::function<void(NodeDataModel*)> const & visitor)
+{
+  for (const auto& _node : _nodes)
+  {
+    visitor(_node->nodeDataModel());
+  }
+}
+
+
+void
+FlowGraph::
+iterateOverNodeDataDependentOrder(std::function<void(NodeDataModel*)> const & visitor)
+{
+  // Copied, the visitor is free to change the graph
+  std::vector<Node*> const order = _scheduler->order();
+
+  for (Node * node : order)
+  {
+    visitor(node->nodeDataModel());
+  }
+}
+
+
+std::vector<Node*>
+FlowGraph::
+nodesInCycles() const
+{
+  return _scheduler->cyclicNodes();
+}
+
+
+QPointF
+FlowGraph::
+getNodePosition(const Node& node) const
+{
+  return node.position();
+}
+
+
+void
+FlowGraph::
+setNodePosition(Node& node, const QPointF& pos) const
+{
+  node.setPosition(pos);
+}
+
+
+SlotMap<std::unique_ptr<Node> > const &
+FlowGraph::
+nodes() const
+{
+  return _nodes;
+}
+
+
+SlotMap<std::shared_ptr<Connection> > const &
+FlowGraph::
+connections() const
+{
+  return _connections;
+}
+
+
+Node*
+FlowGraph::
+node(SlotHandle handle) const
+{
+  UniqueNode const * node = _nodes.get(handle);
+
+  return node ? node->get() : nullptr;
+}
+
+
+Node*
+FlowGraph::
+node(QUuid const & id) const
+{
+  auto it = _nodeIds.find(id);
+
+  return it != _nodeIds.end() ? node(it->second) : nullptr;
+}
+
+
+Connection*
+FlowGraph::
+connection(SlotHandle handle) const
+{
+  SharedConnection const * connection = _connections.get(handle);
+
+  return connection ? connection->get() : nullptr;
+}
+
+
+Connection*
+FlowGraph::
+connection(QUuid const & id) const
+{
+  auto it = _connectionIds.find(id);
+
+  return it != _connectionIds.end() ? connection(it->second) : nullptr;
+}
+
+
+std::vector<Node*>
+FlowGraph::
+allNodes() const
+{
+  std::vector<Node*> nodes;
+  nodes.reserve(_nodes.size());
+
+  std::transform(_nodes.begin(),
+                 _nodes.end(),
+                 std::back_inserter(nodes),
+                 [](std::unique_ptr<Node> const & p) { return p.get(); });
+
+  return nodes;
+}
+
+
+UndoPayloadStore&
+FlowGraph::
+undoPayloads() const
+{
+  return *_undoPayloads;
+}
+
+
+//------------------------------------------------------------------------------
+
+void
+FlowGraph::
+clear()
+{
+  // Its snapshot is of the graph going away
+  stopJournal();
+
+  if (_containerLoad)
+  {
+    _containerLoad.reset();
+
+    // Its batch is dropped with the graph, nothing is left to push
+    --_batch.depth;
+  }
+
+  _countingLoad = false;
+
+  // Deleting items one by one made every connection push empty data
+  // downstream, and every model recompute, on the way out. While tearing
+  // down, connections and nodes neither propagate nor repaint, so the
+  // storage can go in bulk: connections first, their nodes still exist.
+  _tearingDown = true;
+
+  _queuedUpdates.clear();
+  _pullRequests.clear();
+  _pendingConversions = 0;
+  _batch.nodes.clear();
+  _batch.connections.clear();
+
+  // One selection change rather than one per selected item
+  if (_frontEnd)
+    _frontEnd->removingItems();
+
+  for (auto const & connection : _connections)
+  {
+    if (connection->announced())
+      Q_EMIT connectionDeleted(*connection);
+  }
+
+  for (auto const & node : _nodes)
+  {
+    Q_EMIT nodeDeleted(*node);
+
+    if (_executor)
+      _executor->cancel(*node);
+  }
+
+  _connectionIds.clear();
+  _connections.clear();
+
+  _nodeIds.clear();
+  _nodes.clear();
+
+  _scheduler->clear();
+
+  _tearingDown = false;
+}
+
+
+bool
+FlowGraph::
+isTearingDown() const
+{
+  return _tearingDown;
+}
+
+
+bool
+FlowGraph::
+save( QString fileName, SceneFormat format ) const
+{
+  if (!fileName.isEmpty())
+  {
+    if (!fileName.endsWith("flow", Qt::CaseInsensitive))
+      fileName += ".flow";
+
+    QFile file(fileName);
+    if (file.open(QIODevice::WriteOnly))
+    {
+      file.write(saveToMemory(format));
+	  return true;
+    }
+  }
+  return false;
+}
+
+
+bool
+FlowGraph::
+load( const QString & filename )
+{
+  clear();
+
+  //-------------  
+
+  if (!QFileInfo::exists(filename))
+	return false;
+
+  QFile file(filename);
+
+  if (!file.open(QIODevice::ReadOnly))
+	return false;
+
+  if (SceneContainer::isContainer(file.peek(16)))
+  {
+    file.close();
+
+    auto containerLoad = detail::make_unique<ContainerLoad>();
+
+    if (!containerLoad->reader.open(filename))
+      return false;
+
+    startContainerLoad(std::move(containerLoad), true);
+
+    return true;
+  }
+
+  QByteArray wholeFile = file.readAll();
+
+  loadFromMemory(wholeFile);
+
+  return true;
+}
+
+
+QByteArray
+FlowGraph::
+saveToMemory( SceneFormat format ) const
+{
+  if (format == SceneFormat::Cbor)
+    return saveToCbor();
+
+  if (format == SceneFormat::Chunked)
+    return saveToContainer();
+
+  QJsonDocument document(saveToJson());
+
+  return document.toJson();
+}
+
+
+QJsonObject
+FlowGraph::
+saveToJson() const
+{
+  QJsonObject sceneJson;
+
+  QJsonArray nodesJsonArray;
+
+  for (auto const & node : _nodes)
+  {
+    nodesJsonArray.append(node->save());
+  }
+
+  sceneJson["nodes"] = nodesJsonArray;
+
+  QJsonArray connectionJsonArray;
+  for (auto const & connection : _connections)
+  {
+    QJsonObject connectionJson = connection->save();
+
+    if (!connectionJson.isEmpty())
+      connectionJsonArray.append(connectionJson);
+  }
+
+  sceneJson["connections"] = connectionJsonArray;
+
+  Q_EMIT saving( sceneJson );
+
+  return sceneJson;
+}
+
+
+void
+FlowGraph::
+loadFromMemory(const QByteArray& data)
+{
+  // Restored items bypass the undo commands, the journal would miss them
+  stopJournal();
+
+  if (SceneContainer::isContainer(data))
+  {
+    auto containerLoad = detail::make_unique<ContainerLoad>();
+
+    if (containerLoad->reader.open(data))
+      startContainerLoad(std::move(containerLoad), false);
+
+    return;
+  }
+
+  QJsonObject jsonDocument;
+
+  // The whole graph is built first, then evaluated in one ordered pass
+  beginLoad();
+
+  try
+  {
+    if (data.startsWith(cborSignature))
+    {
+      jsonDocument = restoreFromCbor(data);
+    }
+    else
+    {
+      jsonDocument = QJsonDocument::fromJson(data).object();
+
+      QJsonArray nodesJsonArray = jsonDocument["nodes"].toArray();
+
+      for (QJsonValueRef node : nodesJsonArray)
+      {
+        restoreNode(node.toObject());
+      }
+
+      QJsonArray connectionJsonArray = jsonDocument["connections"].toArray();
+
+      for (QJsonValueRef connection : connectionJsonArray)
+      {
+        restoreConnection(connection.toObject());
+      }
+    }
+
+    // Updates raised here join the same pass
+    for (auto &node : _nodes)
+      node->nodeDataModel()->loaded();
+  }
+  catch (...)
+  {
+    endLoad();
+    throw;
+  }
+
+  endLoad();
+
+  Q_EMIT loading( jsonDocument );
+
+  Q_EMIT loadFinished();
+}
+
+
+bool
+FlowGraph::
+startJournal(QString const & fileName)
+{
+  stopJournal();
+
+  auto journal = detail::make_unique<SceneJournal>(*this, fileName);
+
+  // Only the entries added through saving() are gathered here, the items
+  // are recorded by the journal a slice at a time
+  QJsonObject extraJson;
+
+  Q_EMIT saving( extraJson );
+
+  std::vector<QUuid> nodeIds;
+  nodeIds.reserve(_nodes.size());
+
+  for (auto const & node : _nodes)
+    nodeIds.push_back(node->id());
+
+  std::vector<QUuid> connectionIds;
+  connectionIds.reserve(_connections.size());
+
+  for (auto const & connection : _connections)
+    connectionIds.push_back(connection->id());
+
+  if (!journal->start(extraJson, std::move(nodeIds), std::move(connectionIds)))
+    return false;
+
+  _journal = std::move(journal);
+
+  return true;
+}
+
+
+void
+FlowGraph::
+stopJournal()
+{
+  _journal.reset();
+}
+
+
+SceneJournal *
+FlowGraph::
+journal() const
+{
+  return _journal.get();
+}
+
+
+void
+FlowGraph::
+compactJournal()
+{
+  if (_journal)
+    _journal->compact();
+}
+
+
+bool
+FlowGraph::
+recover(QString const & fileName)
+{
+  stopJournal();
+  clear();
+
+  auto journal = detail::make_unique<SceneJournal>(*this, fileName);
+
+  QJsonObject sceneJson;
+
+  if (!journal->resume(sceneJson))
+    return false;
+
+  beginLoad();
+
+  try
+  {
+    for (QJsonValue const & node : sceneJson["nodes"].toArray())
+      restoreNode(node.toObject());
+
+    for (QJsonValue const & connection : sceneJson["connections"].toArray())
+      restoreConnection(connection.toObject());
+
+    for (auto &node : _nodes)
+      node->nodeDataModel()->loaded();
+  }
+  catch (...)
+  {
+    endLoad();
+    throw;
+  }
+
+  endLoad();
+
+  Q_EMIT loading( sceneJson );
+
+  Q_EMIT loadFinished();
+
+  // Not before, the restored state is already journaled
+  _journal = std::move(journal);
+
+  return true;
+}
+
+
+QByteArray
+FlowGraph::
+saveToCbor() const
+{
+  QByteArray data;
+  QCborStreamWriter writer(&data);
+
+  writer.append(QCborKnownTags::Signature);
+  writer.startMap();
+
+  // Items are written one at a time, no document is built
+  writer.append(QLatin1String("nodes"));
+  writer.startArray(_nodes.size());
+
+  for (auto const & node : _nodes)
+    writeCborItem(writer, node->save());
+
+  writer.endArray();
+
+  writer.append(QLatin1String("connections"));
+  writer.startArray();
+
+  for (auto const & connection : _connections)
+  {
+    QJsonObject connectionJson = connection->save();
+
+    if (!connectionJson.isEmpty())
+      writeCborItem(writer, connectionJson);
+  }
+
+  writer.endArray();
+
+  // Listeners add their entries next to the nodes and connections
+  QJsonObject extraJson;
+
+  Q_EMIT saving( extraJson );
+
+  for (auto it = extraJson.begin(); it != extraJson.end(); ++it)
+  {
+    writer.append(it.key());
+    QCborValue::fromJsonValue(it.value()).toCbor(writer);
+  }
+
+  writer.endMap();
+
+  return data;
+}
+
+
+QJsonObject
+FlowGraph::
+restoreFromCbor(QByteArray const& data)
+{
+  QJsonObject extraJson;
+
+  QCborStreamReader reader(data);
+
+  if (reader.isTag() && reader.toTag() == QCborTag(QCborKnownTags::Signature))
+    reader.next();
+
+  if (!reader.isMap())
+    return extraJson;
+
+  reader.enterContainer();
+
+  while (reader.hasNext() && reader.lastError() == QCborError::NoError)
+  {
+    QString const key = QCborValue::fromCbor(reader).toString();
+
+    bool const isNodes       = key == QLatin1String("nodes");
+    bool const isConnections = key == QLatin1String("connections");
+
+    if ((isNodes || isConnections) && reader.isArray())
+    {
+      // One item is decoded at a time
+      reader.enterContainer();
+
+      while (reader.hasNext() && reader.lastError() == QCborError::NoError)
+      {
+        QJsonObject const itemJson = readCborItem(QCborValue::fromCbor(reader).toMap());
+
+        if (isNodes)
+          restoreNode(itemJson);
+        else
+          restoreConnection(itemJson);
+      }
+
+      reader.leaveContainer();
+    }
+    else
+    {
+      extraJson[key] = QCborValue::fromCbor(reader).toJsonValue();
+    }
+  }
+
+  if (reader.lastError() != QCborError::NoError)
+    qWarning() << "FlowGraph: corrupt scene data," << reader.lastError().toString();
+
+  return extraJson;
+}
+
+
+QByteArray
+FlowGraph::
+saveToContainer() const
+{
+  std::vector<QJsonObject> nodesJson;
+  nodesJson.reserve(_nodes.size());
+
+  for (auto const & node : _nodes)
+    nodesJson.push_back(node->save());
+
+  std::vector<QJsonObject> connectionsJson;
+  connectionsJson.reserve(_connections.size());
+
+  for (auto const & connection : _connections)
+  {
+    QJsonObject connectionJson = connection->save();
+
+    if (!connectionJson.isEmpty())
+      connectionsJson.push_back(std::move(connectionJson));
+  }
+
+  QJsonObject extraJson;
+
+  Q_EMIT saving( extraJson );
+
+  // Loading starts with what is on screen now
+  QRectF const viewRect = _frontEnd ? _frontEnd->visibleRect() : QRectF();
+
+  return SceneContainer::write(nodesJson, connectionsJson, extraJson, viewRect);
+}
+
+
+bool
+FlowGraph::
+isLoading() const
+{
+  return _containerLoad != nullptr;
+}
+
+
+void
+FlowGraph::
+startContainerLoad(std::unique_ptr<ContainerLoad> containerLoad, bool stream)
+{
+  // A load still streaming keeps what it restored so far
+  if (_containerLoad)
+  {
+    _containerLoad.reset();
+    endLoad();
+  }
+
+  _containerLoad = std::move(containerLoad);
+
+  ContainerLoad & load = *_containerLoad;
+
+  load.connections = load.reader.readConnections();
+  load.connectionRestored.assign(load.connections.size(), false);
+
+  for (std::size_t i = 0; i < load.connections.size(); ++i)
+  {
+    load.connectionsByNode.emplace(QUuid(load.connections[i]["in_id"].toString()), i);
+    load.connectionsByNode.emplace(QUuid(load.connections[i]["out_id"].toString()), i);
+  }
+
+  auto const & chunks = load.reader.chunks();
+
+  QRectF const  viewRect   = load.reader.viewRect();
+  QPointF const viewCenter = viewRect.center();
+
+  std::vector<std::size_t> visibleChunks;
+
+  for (std::size_t i = 0; i < chunks.size(); ++i)
+  {
+    QRectF const bounds =
+      chunks[i].bounds.adjusted(-chunkMargin, -chunkMargin, chunkMargin, chunkMargin);
+
+    if (!stream || viewRect.intersects(bounds))
+      visibleChunks.push_back(i);
+    else
+      load.pendingChunks.push_back(i);
+  }
+
+  auto distance = [&](std::size_t i)
+  {
+    return QLineF(viewCenter, chunks[i].bounds.center()).length();
+  };
+
+  std::sort(load.pendingChunks.begin(), load.pendingChunks.end(),
+            [&](std::size_t a, std::size_t b)
+            { return distance(a) > distance(b); });
+
+  // One batch until the last chunk: the slices only show their items,
+  // the data is pushed once the graph is complete
+  beginLoad();
+
+  for (std::size_t i : visibleChunks)
+    restoreChunk(i);
+
+  publishBatch();
+
+  if (!_containerLoad)
+    return;
+
+  Q_EMIT loading( _containerLoad->reader.readExtra() );
+
+  if (!_containerLoad)
+    return;
+
+  if (_containerLoad->pendingChunks.empty())
+    finishContainerLoad();
+  else
+    QTimer::singleShot(0, &_containerLoad->context, [this]() { streamChunks(); });
+}
+
+
+void
+FlowGraph::
+restoreChunk(std::size_t chunkIndex)
+{
+  ContainerLoad & load = *_containerLoad;
+
+  auto const & chunk = load.reader.chunks()[chunkIndex];
+
+  for (QJsonObject const & nodeJson : load.reader.readNodes(chunk))
+  {
+    Node & restored = restoreNode(nodeJson);
+
+    auto const range = load.connectionsByNode.equal_range(restored.id());
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      std::size_t const c = it->second;
+
+      if (load.connectionRestored[c])
+        continue;
+
+      QJsonObject const & connectionJson = load.connections[c];
+
+      if (node(QUuid(connectionJson["in_id"].toString())) &&
+          node(QUuid(connectionJson["out_id"].toString())))
+      {
+        load.connectionRestored[c] = true;
+        restoreConnection(connectionJson);
+      }
+    }
+  }
+}
+
+
+void
+FlowGraph::
+streamChunks()
+{
+  if (!_containerLoad)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  auto & pendingChunks = _containerLoad->pendingChunks;
+
+  while (!pendingChunks.empty() && timer.elapsed() < streamSliceMs)
+  {
+    std::size_t const chunkIndex = pendingChunks.back();
+    pendingChunks.pop_back();
+
+    restoreChunk(chunkIndex);
+  }
+
+  // Still within the load's batch
+  publishBatch();
+
+  // The graph may have been cleared from a slot
+  if (!_containerLoad)
+    return;
+
+  if (_containerLoad->pendingChunks.empty())
+    finishContainerLoad();
+  else
+    QTimer::singleShot(0, &_containerLoad->context, [this]() { streamChunks(); });
+}
+
+
+void
+FlowGraph::
+finishContainerLoad()
+{
+  _containerLoad.reset();
+
+  // Still within the load's batch, updates raised here join its pass
+  for (auto &node : _nodes)
+    node->nodeDataModel()->loaded();
+
+  endLoad();
+
+  Q_EMIT loadFinished();
+}
+
+
+void
+FlowGraph::
+connectionMadeComplete(Connection& c)
+{
+  // Connections completed while being built are ordered and announced
+  // once stored
+  if (_connections.contains(c.handle()))
+  {
+    scheduleConnection(c);
+    announceConnection(c);
+  }
+}
+
+
+void
+FlowGraph::
+connectionMadeIncomplete(Connection& c)
+{
+  // Still complete here. Connections deleted from the graph were
+  // unscheduled when they were unlinked.
+  if (_connections.contains(c.handle()))
+    unscheduleConnection(c);
+
+  if (!c.announced())
+    return;
+
+  // Announced again if it gets completed, and not at teardown meanwhile
+  c.setAnnounced(false);
+
+  connectionDeleted(c);
+}
+
+
+void
+FlowGraph::
+conversionStarted()
+{
+  ++_pendingConversions;
+}
+
+
+void
+FlowGraph::
+conversionFinished()
+{
+  Q_ASSERT(_pendingConversions > 0);
+
+  --_pendingConversions;
+}
+
+
+void
+FlowGraph::
+announceConnection(Connection& c)
+{
+  c.setAnnounced(true);
+
+  connectionCreated(c);
+}
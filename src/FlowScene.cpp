@@ -1,31 +1,22 @@
 #include "FlowScene.hpp"
 
-#include <stdexcept>
+#include <unordered_set>
 #include <utility>
 
-#include <QtWidgets/QGraphicsSceneMoveEvent>
-#include <QtWidgets/QFileDialog>
-#include <QtCore/QByteArray>
-#include <QtCore/QBuffer>
-#include <QtCore/QDataStream>
-#include <QtCore/QFile>
-
-#include <QtCore/QJsonDocument>
-#include <QtCore/QJsonObject>
-#include <QtCore/QJsonArray>
-#include <QtCore/QtGlobal>
-#include <QtCore/QDebug>
+#include <QtWidgets/QGraphicsView>
 
 #include "Node.hpp"
 #include "NodeGraphicsObject.hpp"
-
-#include "NodeGraphicsObject.hpp"
-#include "ConnectionGraphicsObject.hpp"
+#include "NodeGeometry.hpp"
+#include "NodeDataModel.hpp"
 
 #include "Connection.hpp"
+#include "ConnectionGraphicsObject.hpp"
 
-#include "FlowView.hpp"
-#include "DataModelRegistry.hpp"
+#include "SceneJournal.hpp"
+#include "SceneIndex.hpp"
+#include "SceneTiles.hpp"
+#include "ConnectionLayer.hpp"
 
 using namespace QtNodes;
 
@@ -34,16 +25,15 @@ FlowScene::
 FlowScene(std::shared_ptr<DataModelRegistry> registry,
           QObject * parent)
   : QGraphicsScene(parent)
-  , _registry(std::move(registry))
+  , _ownedGraph(detail::make_unique<FlowGraph>(std::move(registry)))
+  , _graph(*_ownedGraph)
+  , _index(detail::make_unique<SceneIndex>())
+  , _tiles(detail::make_unique<SceneTiles>(*this))
 {
-  setItemIndexMethod(QGraphicsScene::NoIndex);
-
-  // This connection should come first
-  connect(this, &FlowScene::connectionCreated, this, &FlowScene::setupConnectionSignals);
-  connect(this, &FlowScene::connectionCreated, this, &FlowScene::sendConnectionCreatedToNodes);
-  connect(this, &FlowScene::connectionDeleted, this, &FlowScene::sendConnectionDeletedToNodes);
+  attachGraph();
 }
 
+
 FlowScene::
 FlowScene(QObject * parent)
   : FlowScene(std::make_shared<DataModelRegistry>(),
@@ -52,406 +42,205 @@ FlowScene(QObject * parent)
 
 
 FlowScene::
-~FlowScene()
-{
-  clearScene();
-}
-
-
-//------------------------------------------------------------------------------
-
-std::shared_ptr<Connection>
-FlowScene::
-createConnection(PortType connectedPort,
-                 Node& node,
-                 PortIndex portIndex)
+FlowScene(FlowGraph & graph,
+          QObject * parent)
+  : QGraphicsScene(parent)
+  , _graph(graph)
+  , _index(detail::make_unique<SceneIndex>())
+  , _tiles(detail::make_unique<SceneTiles>(*this))
 {
-  auto connection = std::make_shared<Connection>(connectedPort, node, portIndex);
-
-  auto cgo = detail::make_unique<ConnectionGraphicsObject>(*this, *connection);
-
-  // after this function connection points are set to node port
-  connection->setGraphicsObject(std::move(cgo));
-
-  _connections[connection->id()] = connection;
-
-  // Note: this connection isn't truly created yet. It's only partially created.
-  // Thus, don't send the connectionCreated(...) signal.
-
-  connect(connection.get(),
-		  &Connection::connectionCompleted,
-          this,
-		  [this](Connection const& c) {
-            connectionCreated(c);
-          });
-
-  return connection;
+  attachGraph();
 }
 
 
-std::shared_ptr<Connection>
 FlowScene::
-createConnection(Node& nodeIn,
-                 PortIndex portIndexIn,
-                 Node& nodeOut,
-                 PortIndex portIndexOut,
-				 SharedTypeConverter converter,
-				 QUuid id,
-				 bool sendSignal)
+~FlowScene()
 {
-  auto connection =
-    std::make_shared<Connection>(nodeIn,
-                                 portIndexIn,
-                                 nodeOut,
-                                 portIndexOut,
-								 converter,
-								 id);
-
-  auto cgo = detail::make_unique<ConnectionGraphicsObject>(*this, *connection);
-
-  nodeIn.nodeState().setConnection(PortType::In, portIndexIn, *connection);
-  nodeOut.nodeState().setConnection(PortType::Out, portIndexOut, *connection);
-
-  // after this function connection points are set to node port
-  connection->setGraphicsObject(std::move(cgo));
-
-  if(sendSignal)
-	{
-	connection->getNode( PortType::Out )->nodeDataModel()->outputConnectionCreated( connection->getPortIndex( PortType::Out ) );
-	connection->getNode( PortType::In )->nodeDataModel()->inputConnectionCreated( connection->getPortIndex( PortType::In ) );
-	}
+  if (_ownedGraph)
+  {
+    _graph.clear();
+  }
+  else
+  {
+    // The graph goes on without graphics
+    clearSelection();
 
-  // trigger data propagation
-  nodeOut.onDataUpdated(portIndexOut);
+    for (auto const & connection : _graph.connections())
+      connection->setGraphics(nullptr);
 
-  _connections[connection->id()] = connection;
+    for (auto const & node : _graph.nodes())
+    {
+      if (!node->hasGraphicsObject())
+        continue;
 
-  connectionCreated(*connection);
+      nodeGraphicsObject(*node).releaseEmbeddedWidget();
+      node->setGraphics(nullptr);
+    }
+  }
 
-  return connection;
+  _graph.setFrontEnd(nullptr);
 }
 
 
-std::shared_ptr<Connection>
+void
 FlowScene::
-restoreConnection(QJsonObject const &connectionJson, bool sendSignal)
+attachGraph()
 {
-  QUuid connectionID = QUuid(connectionJson["id"].toString());
-
-  QUuid nodeInId  = QUuid(connectionJson["in_id"].toString());
-  QUuid nodeOutId = QUuid(connectionJson["out_id"].toString());
+  Q_ASSERT(_graph.frontEnd() == nullptr);
 
-  PortIndex portIndexIn  = connectionJson["in_index"].toInt();
-  PortIndex portIndexOut = connectionJson["out_index"].toInt();
-
-  auto nodeIn  = _nodes[nodeInId].get();
-  auto nodeOut = _nodes[nodeOutId].get();
+  // Qt's BSP tree needs every bounding rect change announced, and nodes
+  // are measured again while painting. Qt's traversals skip whole tiles
+  // instead, see SceneTiles, and the scene's own queries go through
+  // _index.
+  setItemIndexMethod(QGraphicsScene::NoIndex);
 
-  auto getConverter = [&]()
+  connect(this, &QGraphicsScene::selectionChanged, this, [this]()
   {
-    QJsonValue converterVal = connectionJson["converter"];
+    if (_graph.propagationMode() != FlowGraph::PropagationMode::Pull)
+      return;
 
-    if (!converterVal.isUndefined())
+    for (Node * node : selectedNodes())
     {
-      QJsonObject converterJson = converterVal.toObject();
-
-      NodeDataType inType { converterJson["in"].toObject()["id"].toString(),
-                            converterJson["in"].toObject()["name"].toString() };
-
-      NodeDataType outType { converterJson["out"].toObject()["id"].toString(),
-                             converterJson["out"].toObject()["name"].toString() };
-
-      auto converter  =
-        registry().getTypeConverter(outType, inType);
-
-      if (converter)
-        return converter;
+      if (node->nodeState().isDirty())
+        _graph.requestPull(*node);
     }
+  });
 
-    return SharedTypeConverter( nullptr );
-  };
-
-  std::shared_ptr<Connection> connection =
-    createConnection(*nodeIn, portIndexIn,
-                     *nodeOut, portIndexOut,
-					 getConverter(),
-					 connectionID,
-					 sendSignal);
+  _graph.setFrontEnd(this);
 
-  // Note: the connectionCreated(...) signal has already been sent
-  // by createConnection(...)
+  // Items the graph holds already, the nodes first
+  for (auto const & node : _graph.nodes())
+    showNode(*node);
 
-  return connection;
+  for (auto const & connection : _graph.connections())
+    showConnection(*connection);
 }
 
 
-void
+FlowGraph &
 FlowScene::
-deleteConnection(Connection& connection, bool sendSignal)
+graph() const
 {
-  auto it = _connections.find(connection.id());
-  if (it != _connections.end()) {
-	if(sendSignal)
-	  {
-	  connection.getNode(PortType::Out)->nodeDataModel()->outputConnectionDeleted( connection.getPortIndex( PortType::Out ) );
-	  connection.getNode(PortType::In)->nodeDataModel()->inputConnectionDeleted( connection.getPortIndex( PortType::In ) );
-	  }
-	connection.removeFromNodes();
-    _connections.erase(it);
-  }
+  return _graph;
 }
 
-Node&
-FlowScene::
-createNode(std::unique_ptr<NodeDataModel> && dataModel)
-{
-  auto node = detail::make_unique<Node>(std::move(dataModel));
-  auto ngo  = detail::make_unique<NodeGraphicsObject>(*this, *node);
-
-  node->setGraphicsObject(std::move(ngo));
-
-  auto nodePtr = node.get();
-  _nodes[node->id()] = std::move(node);
-
-  nodeCreated(*nodePtr);
-  return *nodePtr;
-}
-
-Node&
-FlowScene::
-createNodeFromName( const QString & name, const QPointF & pos )
-{
-  std::unique_ptr<NodeDataModel> type = registry().create( name );
-
-  Q_ASSERT( type );
-
-  Node & node = createNode( std::move( type ) );
-  undoStack->push( new NodeAddCommand( node ) );
-  node.nodeGraphicsObject().setPos( pos );
-  nodePlaced( node );
-  return node;
-}
 
+//------------------------------------------------------------------------------
 
-Node&
+void
 FlowScene::
-restoreNode(QJsonObject const& nodeJson)
+showNode(Node & node)
 {
-  QString modelName = nodeJson["model"].toObject()["name"].toString();
-
-  auto dataModel = registry().create(modelName);
+  // Shown when the scene attached
+  if (node.hasGraphicsObject())
+    return;
 
-  if (!dataModel)
-    throw std::logic_error(std::string("No registered model with name ") +
-                           modelName.toLocal8Bit().data());
-
-  auto node = detail::make_unique<Node>(std::move(dataModel));
-  auto ngo  = detail::make_unique<NodeGraphicsObject>(*this, *node);
-  node->setGraphicsObject(std::move(ngo));
-
-  node->restore(nodeJson);
-
-  auto nodePtr = node.get();
-  _nodes[node->id()] = std::move(node);
-
-  nodePlaced(*nodePtr);
-  nodeCreated(*nodePtr);
-  return *nodePtr;
+  node.setGraphics(detail::make_unique<NodeGraphicsObject>(*this, node));
 }
 
 
 void
 FlowScene::
-removeNode(Node& node)
+showConnection(Connection & connection)
 {
-  // call signal
-  nodeDeleted(node);
-
-  for(auto portType: {PortType::In,PortType::Out})
-  {
-    auto nodeState = node.nodeState();
-	auto const & nodeEntries = nodeState.getEntries(portType);
-
-	for (auto &connections : nodeEntries)
-	{
-      for (auto const &pair : connections)
-		{
-		//undoStack->push( new ConnectionRemoveCommand( *pair.second ) );
-		deleteConnection(*pair.second);
-		}
-    }
-  }
-
-  _nodes.erase(node.id());
-}
+  if (connection.hasGraphicsObject())
+    return;
 
-
-DataModelRegistry&
-FlowScene::
-registry() const
-{
-  return *_registry;
+  connection.setGraphics(detail::make_unique<ConnectionGraphicsObject>(*this, connection));
 }
 
 
 void
 FlowScene::
-setRegistry(std::shared_ptr<DataModelRegistry> registry)
+removingItems()
 {
-  _registry = std::move(registry);
+  // One selection change instead of one per item
+  clearSelection();
 }
 
 
-void
+QRectF
 FlowScene::
-iterateOverNodes(std::function<void(Node*)> const & visitor)
+visibleRect() const
 {
-  for (const auto& _node : _nodes)
-  {
-    visitor(_node.second.get());
-  }
-}
+  if (views().isEmpty())
+    return QRectF();
 
+  QGraphicsView * view = views().first();
 
-void
-FlowScene::
-iterateOverNodeData(std::function<void(NodeDataModel*)> const & visitor)
-{
-  for (const auto& _node : _nodes)
-  {
-    visitor(_node.second->nodeDataModel());
-  }
+  return view->mapToScene(view->viewport()->rect()).boundingRect();
 }
 
 
+//------------------------------------------------------------------------------
+
 void
 FlowScene::
-iterateOverNodeDataDependentOrder(std::function<void(NodeDataModel*)> const & visitor)
+setConnectionLayerEnabled(bool enabled)
 {
-  std::set<QUuid> visitedNodesSet;
+  if (enabled == connectionLayerEnabled())
+    return;
 
-  //A leaf node is a node with no input ports, or all possible input ports empty
-  auto isNodeLeaf =
-    [](Node const &node, NodeDataModel const &model)
-    {
-      for (unsigned int i = 0; i < model.nPorts(PortType::In); ++i)
-      {
-        auto connections = node.nodeState().connections(PortType::In, i);
-        if (!connections.empty())
-        {
-          return false;
-        }
-      }
-
-      return true;
-    };
-
-  //Iterate over "leaf" nodes
-  for (auto const &_node : _nodes)
-  {
-    auto const &node = _node.second;
-    auto model       = node->nodeDataModel();
+  if (enabled)
+    _connectionLayer = detail::make_unique<ConnectionLayer>(*this);
 
-    if (isNodeLeaf(*node, *model))
-    {
-      visitor(model);
-      visitedNodesSet.insert(node->id());
-    }
-  }
-
-  auto areNodeInputsVisitedBefore =
-    [&](Node const &node, NodeDataModel const &model)
-    {
-      for (size_t i = 0; i < model.nPorts(PortType::In); ++i)
-      {
-        auto connections = node.nodeState().connections(PortType::In, i);
-
-        for (auto& conn : connections)
-        {
-          if (visitedNodesSet.find(conn.second->getNode(PortType::Out)->id()) == visitedNodesSet.end())
-          {
-            return false;
-          }
-        }
-      }
-
-      return true;
-    };
-
-  //Iterate over dependent nodes
-  while (_nodes.size() != visitedNodesSet.size())
+  for (auto const & connection : _graph.connections())
   {
-    for (auto const &_node : _nodes)
-    {
-      auto const &node = _node.second;
-      if (visitedNodesSet.find(node->id()) != visitedNodesSet.end())
-        continue;
-
-      auto model = node->nodeDataModel();
-
-      if (areNodeInputsVisitedBefore(*node, *model))
-      {
-        visitor(model);
-        visitedNodesSet.insert(node->id());
-      }
-    }
+    if (connection->hasGraphicsObject())
+      connectionGraphicsObject(*connection).setDrawnByLayer(enabled);
   }
-}
-
 
-QPointF
-FlowScene::
-getNodePosition(const Node& node) const
-{
-  return node.nodeGraphicsObject().pos();
+  // Leaving the scene repaints what the layer covered
+  if (!enabled)
+    _connectionLayer.reset();
 }
 
 
-void
+bool
 FlowScene::
-setNodePosition(Node& node, const QPointF& pos) const
+connectionLayerEnabled() const
 {
-  node.nodeGraphicsObject().setPos(pos);
-  node.nodeGraphicsObject().moveConnections();
+  return _connectionLayer != nullptr;
 }
 
 
-QSizeF
+ConnectionLayer *
 FlowScene::
-getNodeSize(const Node& node) const
+connectionLayer() const
 {
-  return QSizeF(node.nodeGeometry().width(), node.nodeGeometry().height());
+  return _connectionLayer.get();
 }
 
 
-std::unordered_map<QUuid, std::unique_ptr<Node> > const &
+SceneIndex&
 FlowScene::
-nodes() const
+index() const
 {
-  return _nodes;
+  return *_index;
 }
 
 
-std::unordered_map<QUuid, std::shared_ptr<Connection> > const &
+SceneTiles&
 FlowScene::
-connections() const
+tiles() const
 {
-  return _connections;
+  return *_tiles;
 }
 
 
-std::vector<Node*>
+Node&
 FlowScene::
-allNodes() const
+createNodeFromName( const QString & name, const QPointF & pos )
 {
-  std::vector<Node*> nodes;
+  std::unique_ptr<NodeDataModel> type = _graph.registry().create( name );
 
-  std::transform(_nodes.begin(),
-                 _nodes.end(),
-                 std::back_inserter(nodes),
-                 [](std::pair<QUuid const, std::unique_ptr<Node>> const & p) { return p.second.get(); });
+  Q_ASSERT( type );
 
-  return nodes;
+  Node & node = _graph.createNode( std::move( type ) );
+  _graph.setNodePosition( node, pos );
+  undoStack->push( new NodeAddCommand( node ) );
+  _graph.nodePlaced( node );
+  return node;
 }
 
 
@@ -478,176 +267,259 @@ selectedNodes() const
 }
 
 
-//------------------------------------------------------------------------------
-
-void
+QSizeF
 FlowScene::
-clearScene()
+getNodeSize(const Node& node) const
 {
-  //Manual node cleanup. Simply clearing the holding datastructures doesn't work, the code crashes when
-  // there are both nodes and connections in the scene. (The data propagation internal logic tries to propagate
-  // data through already freed connections.)
-  while (_connections.size() > 0)
-  {
-    deleteConnection( *_connections.begin()->second );
-  }
-
-  while (_nodes.size() > 0)
-  {
-    removeNode( *_nodes.begin()->second );
-  }
+  return QSizeF(nodeGeometry(node).width(), nodeGeometry(node).height());
 }
 
 
-bool
-FlowScene::
-save( QString fileName ) const
-{
-  if (!fileName.isEmpty())
-  {
-    if (!fileName.endsWith("flow", Qt::CaseInsensitive))
-      fileName += ".flow";
-
-    QFile file(fileName);
-    if (file.open(QIODevice::WriteOnly))
-    {
-      file.write(saveToMemory());
-	  return true;
-    }
-  }
-  return false;
-}
+//------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
 
-bool
-FlowScene::
-load( const QString & filename )
-{
-  clearScene();
+using QtNodes::NodeAddCommand;
+using QtNodes::NodeRemoveCommand;
+using QtNodes::NodesRemoveCommand;
 
-  //-------------  
+NodeAddCommand::NodeAddCommand( Node & node, QUndoCommand * parent )
+	: QUndoCommand( "Node Added", parent )
+	, graph( node.getGraph() )
+	, id( node.id() )
+	, record( ) // Saving is done at undo time
+	{
+	}
 
-  if (!QFileInfo::exists(filename))
-	return false;
+void NodeAddCommand::undo()
+	{
+	Node * node = graph.node( id );
+	record = UndoNodeRecord::fromJson( node->save(), graph.undoPayloads() );
+	graph.removeNode( *node );
 
-  QFile file(filename);
+	if( auto journal = graph.journal() )
+		journal->nodeRemoved( id );
+	}
 
-  if (!file.open(QIODevice::ReadOnly))
-	return false;
+void NodeAddCommand::redo()
+	{
+	if( firstRun )
+		{
+		firstRun = false;
 
-  QByteArray wholeFile = file.readAll();
+		if( auto journal = graph.journal() )
+			journal->nodeAdded( graph.node( id )->save() );
+		}
+	else
+		{
+		QJsonObject const nodeJson = record.toJson();
+		graph.restoreNode( nodeJson );
 
-  loadFromMemory(wholeFile);
+		if( auto journal = graph.journal() )
+			journal->nodeAdded( nodeJson );
+		}
+	}
 
-  return true;
-}
+NodeRemoveCommand::NodeRemoveCommand( Node & node, QUndoCommand * parent )
+	: QUndoCommand( "Node Removed", parent )
+	, graph( node.getGraph() )
+	, id( node.id() )
+	, record( )
+	{
+	for(auto portType: {PortType::In,PortType::Out})
+		{
+		auto const & nodeEntries = node.nodeState().getEntries(portType);
 
+		for (auto &connections : nodeEntries)
+			for (Connection * c : connections)
+				new ConnectionRemoveCommand( *c, this );
+		}
+	}
 
-QByteArray
-FlowScene::
-saveToMemory() const
-{
-  QJsonObject sceneJson;
+void NodeRemoveCommand::undo()
+	{
+	QJsonObject const nodeJson = record.toJson();
+	graph.restoreNode( nodeJson );
 
-  QJsonArray nodesJsonArray;
+	if( auto journal = graph.journal() )
+		journal->nodeAdded( nodeJson );
 
-  for (auto const & pair : _nodes)
-  {
-    auto const &node = pair.second;
+	QUndoCommand::undo();
+	}
 
-    nodesJsonArray.append(node->save());
-  }
+void NodeRemoveCommand::redo()
+	{
+	QUndoCommand::redo();
 
-  sceneJson["nodes"] = nodesJsonArray;
+	Node * node = graph.node( id );
+	record = UndoNodeRecord::fromJson( node->save(), graph.undoPayloads() );
+	graph.removeNode( *node );
 
-  QJsonArray connectionJsonArray;
-  for (auto const & pair : _connections)
-  {
-    auto const &connection = pair.second;
+	if( auto journal = graph.journal() )
+		journal->nodeRemoved( id );
+	}
 
-    QJsonObject connectionJson = connection->save();
+NodesRemoveCommand::NodesRemoveCommand( FlowGraph & graph,
+										std::vector<Node*> const & nodes,
+										std::vector<Connection*> const & connections,
+										QUndoCommand * parent )
+	: QUndoCommand( "Deleted Selection", parent )
+	, graph( graph )
+	{
+	nodeIds.reserve( nodes.size() );
+	for( Node * node : nodes )
+		nodeIds.push_back( node->id() );
 
-    if (!connectionJson.isEmpty())
-      connectionJsonArray.append(connectionJson);
-  }
+	connectionIds.reserve( connections.size() );
+	for( Connection * c : connections )
+		connectionIds.push_back( c->id() );
+	}
 
-  sceneJson["connections"] = connectionJsonArray;
+void NodesRemoveCommand::undo()
+	{
+	graph.beginBatch();
 
-  Q_EMIT saving( sceneJson );
+	// A restore that throws must not leave the graph batching
+	try
+		{
+		for( UndoNodeRecord const & record : nodeRecords )
+			{
+			QJsonObject const nodeJson = record.toJson();
+			graph.restoreNode( nodeJson );
+
+			if( auto journal = graph.journal() )
+				journal->nodeAdded( nodeJson );
+			}
+
+		for( UndoConnectionRecord const & record : connectionRecords )
+			{
+			QJsonObject const connectionJson = record.toJson();
+			graph.restoreConnection( connectionJson, true );
+
+			if( auto journal = graph.journal() )
+				journal->connectionAdded( connectionJson );
+			}
+		}
+	catch( ... )
+		{
+		graph.commitBatch();
+		throw;
+		}
 
-  QJsonDocument document(sceneJson);
+	graph.commitBatch();
+	}
 
-  return document.toJson();
-}
+void NodesRemoveCommand::redo()
+	{
+	// Ids of items gone meanwhile are skipped
+	std::vector<Node*> nodes;
+	nodes.reserve( nodeIds.size() );
+	for( QUuid const & id : nodeIds )
+		if( Node * node = graph.node( id ) )
+			nodes.push_back( node );
+
+	// Every connection going away is recorded once, whichever end it was found from
+	std::vector<Connection*> connections;
+	std::unordered_set<Connection*> seen;
+
+	auto record = [&]( Connection * c )
+		{
+		if( seen.insert( c ).second )
+			connections.push_back( c );
+		};
 
+	for( QUuid const & id : connectionIds )
+		if( Connection * c = graph.connection( id ) )
+			record( c );
 
-void
-FlowScene::
-loadFromMemory(const QByteArray& data)
-{
-  QJsonObject const jsonDocument = QJsonDocument::fromJson(data).object();
+	for( Node * node : nodes )
+		for( auto portType : { PortType::In, PortType::Out } )
+			for( auto const & entries : node->nodeState().getEntries( portType ) )
+				for( Connection * c : entries )
+					record( c );
 
-  QJsonArray nodesJsonArray = jsonDocument["nodes"].toArray();
+	nodeRecords.clear();
+	nodeRecords.reserve( nodes.size() );
+	for( Node * node : nodes )
+		nodeRecords.push_back( UndoNodeRecord::fromJson( node->save(), graph.undoPayloads() ) );
 
-  for (QJsonValueRef node : nodesJsonArray)
-  {
-    restoreNode(node.toObject());
-  }
+	connectionRecords.clear();
+	connectionRecords.reserve( connections.size() );
+	for( Connection * c : connections )
+		connectionRecords.push_back( UndoConnectionRecord::fromJson( c->save() ) );
 
-  QJsonArray connectionJsonArray = jsonDocument["connections"].toArray();
+	graph.removeNodes( nodes, connections );
 
-  for (QJsonValueRef connection : connectionJsonArray)
-  {
-	restoreConnection(connection.toObject());
-  }
+	if( auto journal = graph.journal() )
+		{
+		for( UndoConnectionRecord const & record : connectionRecords )
+			journal->connectionRemoved( record.id );
 
-  for (auto &node : _nodes)
-	node.second->nodeDataModel()->loaded();
+		for( UndoNodeRecord const & record : nodeRecords )
+			journal->nodeRemoved( record.id );
+		}
+	}
 
-  Q_EMIT loading( jsonDocument );
-}
+using QtNodes::ConnectionAddCommand;
+using QtNodes::ConnectionRemoveCommand;
 
+ConnectionAddCommand::ConnectionAddCommand( Connection & c, QUndoCommand * parent )
+	: QUndoCommand( "Connection created", parent )
+	, graph( c.getGraph() )
+	, record( UndoConnectionRecord::fromJson( c.save() ) )
+	{
+	}
 
-void
-FlowScene::
-setupConnectionSignals(Connection const& c)
-{
-  connect(&c,
-		  &Connection::connectionMadeIncomplete,
-		  this,
-		  &FlowScene::connectionDeleted,
-		  Qt::UniqueConnection);
-}
+void ConnectionAddCommand::undo()
+	{
+	auto c = graph.connection( record.id );
+	graph.deleteConnection( *c, true );
 
+	if( auto journal = graph.journal() )
+		journal->connectionRemoved( record.id );
+	}
 
-void
-FlowScene::
-sendConnectionCreatedToNodes(Connection const& c)
-{
-  Node* from = c.getNode(PortType::Out);
-  Node* to   = c.getNode(PortType::In);
+void ConnectionAddCommand::redo()
+	{
+	if( firstRun )
+		firstRun = false;
+	else
+		{
+		auto c = graph.restoreConnection( record.toJson(), true );
+		}
 
-  Q_ASSERT(from != nullptr);
-  Q_ASSERT(to != nullptr);
+	if( auto journal = graph.journal() )
+		journal->connectionAdded( record.toJson() );
+	}
 
-  //from->nodeDataModel()->outputConnectionCreated(c);
-  //to->nodeDataModel()->inputConnectionCreated(c);
-}
+ConnectionRemoveCommand::ConnectionRemoveCommand( Connection & c, QUndoCommand * parent )
+	: QUndoCommand( "Connection removed", parent )
+	, graph( c.getGraph() )
+	, record( UndoConnectionRecord::fromJson( c.save() ) )
+	{
+	}
 
+void ConnectionRemoveCommand::undo()
+	{
+	auto c = graph.restoreConnection( record.toJson(), true );
 
-void
-FlowScene::
-sendConnectionDeletedToNodes(Connection const& c)
-{
-  Node* from = c.getNode(PortType::Out);
-  Node* to   = c.getNode(PortType::In);
+	if( auto journal = graph.journal() )
+		journal->connectionAdded( record.toJson() );
+	}
 
-  Q_ASSERT(from != nullptr);
-  Q_ASSERT(to != nullptr);
+void ConnectionRemoveCommand::redo()
+	{
+	if( firstRun )
+		firstRun = false;
+	else
+		{
+		auto c = graph.connection( record.id );
+		graph.deleteConnection( *c, true );
+		}
 
-  //from->nodeDataModel()->outputConnectionDeleted(c);
-  //to->nodeDataModel()->inputConnectionDeleted(c);
-}
+	if( auto journal = graph.journal() )
+		journal->connectionRemoved( record.id );
+	}
 
 
 //------------------------------------------------------------------------------
@@ -658,34 +530,26 @@ Node*
 locateNodeAt(QPointF scenePoint, FlowScene &scene,
              QTransform const & viewTransform)
 {
-  // items under cursor
-  QList<QGraphicsItem*> items =
-    scene.items(scenePoint,
-                Qt::IntersectsItemShape,
-                Qt::DescendingOrder,
-                viewTransform);
-
-  //// items convertable to NodeGraphicsObject
-  std::vector<QGraphicsItem*> filteredItems;
-
-  std::copy_if(items.begin(),
-               items.end(),
-               std::back_inserter(filteredItems),
-               [] (QGraphicsItem * item)
-    {
-      return (dynamic_cast<NodeGraphicsObject*>(item) != nullptr);
-    });
+  // Nodes don't ignore transformations, the view has no say
+  Q_UNUSED(viewTransform);
 
-  Node* resultNode = nullptr;
+  NodeGraphicsObject * topmost = nullptr;
 
-  if (!filteredItems.empty())
+  // Only the nodes filed near the point, connections are not looked at
+  for (NodeGraphicsObject * ngo : scene.index().nodes(QRectF(scenePoint, QSizeF())))
   {
-    QGraphicsItem* graphicsItem = filteredItems.front();
-    auto ngo = dynamic_cast<NodeGraphicsObject*>(graphicsItem);
+    if (ngo->scene() != &scene || !ngo->isVisible())
+      continue;
+
+    if (!ngo->contains(ngo->mapFromScene(scenePoint)))
+      continue;
 
-    resultNode = &ngo->node();
+    // The index returns candidates in no particular order, the tiles
+    // know how the scene stacks them
+    if (topmost == nullptr || scene.tiles().drawnAbove(*ngo, *topmost))
+      topmost = ngo;
   }
 
-  return resultNode;
+  return topmost ? &topmost->node() : nullptr;
 }
 }
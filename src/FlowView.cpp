@@ -4,17 +4,24 @@
 
 #include <QtGui/QPen>
 #include <QtGui/QBrush>
+#include <QtGui/QPixmapCache>
+#include <QtGui/QSurfaceFormat>
 #include <QtWidgets/QMenu>
+#include <QtWidgets/QOpenGLWidget>
+#include <QtWidgets/QStyleOptionGraphicsItem>
 
 #include <QtCore/QRectF>
+#include <QtCore/QSignalBlocker>
 #include <QtCore/QPointF>
 
 #include <QtOpenGL>
 #include <QtWidgets>
 
 #include <QDebug>
+#include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <unordered_set>
 
 #include "FlowScene.hpp"
 #include "DataModelRegistry.hpp"
@@ -22,17 +29,122 @@
 #include "NodeGraphicsObject.hpp"
 #include "ConnectionGraphicsObject.hpp"
 #include "StyleCollection.hpp"
+#include "SceneIndex.hpp"
+#include "SceneTiles.hpp"
 
 using QtNodes::FlowView;
 using QtNodes::FlowScene;
+using QtNodes::FlowGraph;
+using QtNodes::SceneTiles;
 using QtNodes::ViewChangeCommand;
 
+/// Scene distance between grid lines
+static double const fineGridStep   = 15.0;
+static double const coarseGridStep = 150.0;
+
+/// Grid lines closer than this many pixels fade, until they are half as
+/// close and gone
+static double const gridFadeSpacing = 8.0;
+
+
+/// Opacity of grid lines this many pixels apart. In sixteenths, so that
+/// zooming reuses a few tiles.
+static
+double
+gridLineOpacity(double spacing)
+{
+  double const opacity = qBound(0.0, 2.0 * spacing / gridFadeSpacing - 1.0, 1.0);
+
+  return std::round(opacity * 16.0) / 16.0;
+}
+
+
+/// One coarse cell of the grid, size logical pixels square, with the
+/// coarse lines along its top and left edges. Drawn in device pixels, so
+/// lines stay one device pixel wide on high DPI screens. Rendered once per
+/// zoom level and kept in QPixmapCache, so repaints and pans only fill
+/// with it.
+static
+QPixmap
+gridTile(int size,
+         qreal devicePixelRatio,
+         QColor fineColor,
+         QColor coarseColor,
+         double fineOpacity,
+         double coarseOpacity)
+{
+  QString const key = QStringLiteral("QtNodes::FlowView:grid:%1:%2:%3:%4:%5:%6")
+                      .arg(size)
+                      .arg(devicePixelRatio)
+                      .arg(fineColor.rgba(), 8, 16)
+                      .arg(coarseColor.rgba(), 8, 16)
+                      .arg(fineOpacity)
+                      .arg(coarseOpacity);
+
+  QPixmap pixmap;
+
+  if (QPixmapCache::find(key, &pixmap))
+    return pixmap;
+
+  int const pixels = qMax(1, qRound(size * devicePixelRatio));
+
+  pixmap = QPixmap(pixels, pixels);
+  pixmap.fill(Qt::transparent);
+
+  QPainter painter(&pixmap);
+
+  // Lines on pixel centres, crisp without antialiasing
+  auto line = [&](int i, int lines)
+  {
+    return std::floor(double(pixels) * i / lines) + 0.5;
+  };
+
+  int const fineLines = static_cast<int>(coarseGridStep / fineGridStep);
+
+  if (fineOpacity > 0.0)
+  {
+    fineColor.setAlphaF(fineColor.alphaF() * fineOpacity);
+    painter.setPen(QPen(fineColor, 1.0));
+
+    QVector<QLineF> lines;
+
+    for (int i = 1; i < fineLines; ++i)
+    {
+      double const p = line(i, fineLines);
+
+      lines.append(QLineF(p, 0.0, p, pixels));
+      lines.append(QLineF(0.0, p, pixels, p));
+    }
+
+    painter.drawLines(lines);
+  }
+
+  coarseColor.setAlphaF(coarseColor.alphaF() * coarseOpacity);
+  painter.setPen(QPen(coarseColor, 1.0));
+
+  double const edge = line(0, fineLines);
+
+  painter.drawLine(QLineF(edge, 0.0, edge, pixels));
+  painter.drawLine(QLineF(0.0, edge, pixels, edge));
+
+  painter.end();
+
+  pixmap.setDevicePixelRatio(devicePixelRatio);
+
+  QPixmapCache::insert(key, pixmap);
+
+  return pixmap;
+}
+
 FlowView::
 FlowView(QWidget *parent)
   : QGraphicsView(parent)
   , _clearSelectionAction(Q_NULLPTR)
   , _deleteSelectionAction(Q_NULLPTR)
+  , _rubberBand(Q_NULLPTR)
   , _scene(Q_NULLPTR)
+  , _rendering(Rendering::Raster)
+  , _layerBeforeOpenGL(false)
 {
   setDragMode(QGraphicsView::ScrollHandDrag);
   setRenderHint(QPainter::Antialiasing);
@@ -45,8 +157,6 @@ FlowView(QWidget *parent)
   setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
 
   setCacheMode(QGraphicsView::CacheBackground);
-
-  //setViewport(new QGLWidget(QGLFormat(QGL::SampleBuffers)));
 }
 
 
@@ -77,9 +187,16 @@ deleteSelectionAction() const
 void
 FlowView::setScene(FlowScene *scene)
 {
+  // The scene left behind gets its layer back, unless it is gone already
+  if (_rendering == Rendering::OpenGL && QGraphicsView::scene() != nullptr)
+    restoreConnectionLayer();
+
   _scene = scene;
   QGraphicsView::setScene(_scene);
 
+  if (_rendering == Rendering::OpenGL)
+    enableConnectionLayer();
+
   // setup actions
   delete _clearSelectionAction;
   _clearSelectionAction = new QAction(QStringLiteral("Clear Selection"), this);
@@ -93,7 +210,7 @@ FlowView::setScene(FlowScene *scene)
   connect(_deleteSelectionAction, &QAction::triggered, this, &FlowView::deleteSelectedNodes);
   addAction(_deleteSelectionAction);
 
-  connect( _scene, &FlowScene::saving, this, [this]( QJsonObject & json )
+  connect( &_scene->graph(), &FlowGraph::saving, this, [this]( QJsonObject & json )
 	{
 	QJsonObject j;
 
@@ -104,7 +221,7 @@ FlowView::setScene(FlowScene *scene)
 
 	json["viewRect"] = j;
 	});
-  connect( _scene, &FlowScene::loading, this, [this]( const QJsonObject & json )
+  connect( &_scene->graph(), &FlowGraph::loading, this, [this]( const QJsonObject & json )
 	{
 	QJsonObject j = json["viewRect"].toObject();
 
@@ -120,7 +237,15 @@ void
 FlowView::
 contextMenuEvent(QContextMenuEvent *event)
 {
-  if (itemAt(event->pos()))
+  // The tiles holding the items are hit as well, see SceneTiles
+  QList<QGraphicsItem*> const hit = items(event->pos());
+
+  auto notTile = [](QGraphicsItem * item)
+  {
+    return !SceneTiles::isTile(*item);
+  };
+
+  if (std::any_of(hit.begin(), hit.end(), notTile))
   {
     QGraphicsView::contextMenuEvent(event);
     return;
@@ -152,7 +277,7 @@ contextMenuEvent(QContextMenuEvent *event)
   modelMenu.addAction(treeViewAction);
 
   QMap<QString, QTreeWidgetItem*> topLevelItems;
-  for (auto const &cat : _scene->registry().categories())
+  for (auto const &cat : _scene->graph().registry().categories())
   {
     auto item = new QTreeWidgetItem(treeView);
     item->setText(0, cat);
@@ -160,7 +285,7 @@ contextMenuEvent(QContextMenuEvent *event)
     topLevelItems[cat] = item;
   }
 
-  for (auto const &assoc : _scene->registry().registeredModelsCategoryAssociation())
+  for (auto const &assoc : _scene->graph().registry().registeredModelsCategoryAssociation())
   {
     auto parent = topLevelItems[assoc.second];
     auto item   = new QTreeWidgetItem(parent);
@@ -179,20 +304,22 @@ contextMenuEvent(QContextMenuEvent *event)
       return;
     }
 
-    auto type = _scene->registry().create(modelName);
+    auto type = _scene->graph().registry().create(modelName);
 
     if (type)
     {
-      auto& node = _scene->createNode(std::move(type));
-	  _scene->undoStack->push( new NodeAddCommand( node ) );
+      auto& node = _scene->graph().createNode(std::move(type));
 
       QPoint pos = event->pos();
 
       QPointF posView = this->mapToScene(pos);
 
-      node.nodeGraphicsObject().setPos(posView);
+      node.setPosition(posView);
+
+	  // After placing it, the journal records the position
+	  _scene->undoStack->push( new NodeAddCommand( node ) );
 
-      _scene->nodePlaced(node);
+      _scene->graph().nodePlaced(node);
     }
     else
     {
@@ -249,6 +376,80 @@ wheelEvent(QWheelEvent *event)
 }
 
 
+void
+FlowView::
+setRendering(Rendering rendering)
+{
+  if (rendering == _rendering)
+    return;
+
+  _rendering = rendering;
+
+  // setViewport() deletes the former viewport
+  if (rendering == Rendering::OpenGL)
+  {
+    auto widget = new QOpenGLWidget;
+
+    // The GL paint engine only antialiases through multisampling
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSamples(4);
+
+    widget->setFormat(format);
+
+    setViewport(widget);
+
+    // A QOpenGLWidget repaints whole on any update, tracking dirty
+    // regions would only cost time
+    setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+
+    // The grid is one fill from a cached tile, a background pixmap would
+    // be one more texture upload per change
+    setCacheMode(QGraphicsView::CacheNone);
+
+    if (_scene)
+      enableConnectionLayer();
+  }
+  else
+  {
+    setViewport(new QWidget);
+
+    setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+    setCacheMode(QGraphicsView::CacheBackground);
+
+    if (_scene)
+      restoreConnectionLayer();
+  }
+}
+
+
+void
+FlowView::
+enableConnectionLayer()
+{
+  // The GL paint engine draws a path per call, the layer makes that one
+  // per pen rather than one per connection
+  _layerBeforeOpenGL = _scene->connectionLayerEnabled();
+
+  _scene->setConnectionLayerEnabled(true);
+}
+
+
+void
+FlowView::
+restoreConnectionLayer()
+{
+  _scene->setConnectionLayerEnabled(_layerBeforeOpenGL);
+}
+
+
+FlowView::Rendering
+FlowView::
+rendering() const
+{
+  return _rendering;
+}
+
+
 void
 FlowView::
 scaleUp()
@@ -280,34 +481,23 @@ void
 FlowView::
 deleteSelectedNodes()
 {
-  QUndoCommand * parentCommand = new QUndoCommand( "Deleted Selection" );
-
-  // Delete the selected connections first, ensuring that they won't be
-  // automatically deleted when selected nodes are deleted (deleting a node
-  // deletes some connections as well)
-  for (QGraphicsItem * item : _scene->selectedItems())
-  {
-    if (auto c = qgraphicsitem_cast<ConnectionGraphicsObject*>(item))
-	  {
-	  new ConnectionRemoveCommand( c->connection(), parentCommand );
-	  _scene->deleteConnection(c->connection());
-	  }
-  }
+  std::vector<Node*>       nodes;
+  std::vector<Connection*> connections;
 
-  // Delete the nodes; this will delete many of the connections.
-  // Selected connections were already deleted prior to this loop, otherwise
-  // qgraphicsitem_cast<NodeGraphicsObject*>(item) could be a use-after-free
-  // when a selected connection is deleted by deleting the node.
+  // Nothing is deleted before the command runs, so one pass is enough
   for (QGraphicsItem * item : _scene->selectedItems())
   {
     if (auto n = qgraphicsitem_cast<NodeGraphicsObject*>(item))
-	  {
-	  new NodeRemoveCommand( n->node(), parentCommand );
-	  //_scene->removeNode(n->node());
-	  }
+      nodes.push_back(&n->node());
+    else if (auto c = qgraphicsitem_cast<ConnectionGraphicsObject*>(item))
+      connections.push_back(&c->connection());
   }
 
-  _scene->undoStack->push( parentCommand );
+  if (nodes.empty() && connections.empty())
+    return;
+
+  // Everything goes in one batch, undone as one
+  _scene->undoStack->push( new NodesRemoveCommand( _scene->graph(), nodes, connections ) );
 }
 
 
@@ -317,8 +507,9 @@ keyPressEvent(QKeyEvent *event)
 {
   switch (event->key())
   {
+    // The rubber band is ours, QGraphicsView's would test every item
     case Qt::Key_Shift:
-      setDragMode(QGraphicsView::RubberBandDrag);
+      setDragMode(QGraphicsView::NoDrag);
       break;
 
 	case Qt::Key_Delete:
@@ -354,6 +545,38 @@ void
 FlowView::
 mousePressEvent(QMouseEvent *event)
 {
+  if (event->button() == Qt::LeftButton &&
+      (event->modifiers() & Qt::ShiftModifier))
+  {
+    QPointF const scenePos = mapToScene(event->pos());
+
+    bool overItem = locateNodeAt(scenePos, *_scene, transform()) != nullptr;
+
+    if (!overItem)
+    {
+      auto const nearby = _scene->index().connections(QRectF(scenePos, QSizeF()));
+
+      overItem = std::any_of(nearby.begin(), nearby.end(),
+                             [&](ConnectionGraphicsObject * cgo)
+        {
+          return cgo->contains(cgo->mapFromScene(scenePos));
+        });
+    }
+
+    if (!overItem)
+    {
+      if (!_rubberBand)
+        _rubberBand = new QRubberBand(QRubberBand::Rectangle, viewport());
+
+      _rubberBandOrigin = event->pos();
+      _rubberBand->setGeometry(QRect(_rubberBandOrigin, QSize()));
+      _rubberBand->show();
+
+      selectInRubberBand();
+      return;
+    }
+  }
+
   QGraphicsView::mousePressEvent(event);
   if (event->button() == Qt::LeftButton)
   {
@@ -367,6 +590,14 @@ void
 FlowView::
 mouseMoveEvent(QMouseEvent *event)
 {
+  if (_rubberBand && _rubberBand->isVisible())
+  {
+    _rubberBand->setGeometry(QRect(_rubberBandOrigin, event->pos()).normalized());
+
+    selectInRubberBand();
+    return;
+  }
+
   QGraphicsView::mouseMoveEvent(event);
   if (scene()->mouseGrabberItem() == nullptr && event->buttons() == Qt::LeftButton)
   {
@@ -384,6 +615,12 @@ void
 FlowView::
 mouseReleaseEvent(QMouseEvent *event)
 {
+  if (_rubberBand && _rubberBand->isVisible())
+  {
+    _rubberBand->hide();
+    return;
+  }
+
   if( sceneRect() != previousRect )
 	_scene->undoStack->push( new ViewChangeCommand( *this ) );
   QGraphicsView::mouseReleaseEvent( event );
@@ -394,51 +631,42 @@ void
 FlowView::
 drawBackground(QPainter* painter, const QRectF& r)
 {
+  auto const &flowViewStyle = StyleCollection::flowViewStyle();
 
-  auto drawGrid =
-    [&](double gridStep)
-    {
-      QRect   windowRect = rect();
-      QPointF tl = mapToScene(windowRect.topLeft());
-      QPointF br = mapToScene(windowRect.bottomRight());
+  painter->setBrush( flowViewStyle.BackgroundColor );
+  QGraphicsView::drawBackground(painter, r);
 
-      double left   = std::floor(tl.x() / gridStep - 0.5);
-      double right  = std::floor(br.x() / gridStep + 1.0);
-      double bottom = std::floor(tl.y() / gridStep - 0.5);
-      double top    = std::floor(br.y() / gridStep + 1.0);
+  qreal const scale =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
 
-      // vertical lines
-      for (int xi = int(left); xi <= int(right); ++xi)
-      {
-        QLineF line(xi * gridStep, bottom * gridStep,
-                    xi * gridStep, top * gridStep );
+  double const coarseSpacing = coarseGridStep * scale;
 
-        painter->drawLine(line);
-      }
+  double const fineOpacity   = gridLineOpacity(fineGridStep * scale);
+  double const coarseOpacity = gridLineOpacity(coarseSpacing);
 
-      // horizontal lines
-      for (int yi = int(bottom); yi <= int(top); ++yi)
-      {
-        QLineF line(left * gridStep, yi * gridStep,
-                    right * gridStep, yi * gridStep );
-        painter->drawLine(line);
-      }
-    };
+  int const size = qRound(coarseSpacing);
 
-  auto const &flowViewStyle = StyleCollection::flowViewStyle();
+  // Coarse lines are the last to fade
+  if (size < 1 || coarseOpacity == 0.0)
+    return;
 
-  painter->setBrush( flowViewStyle.BackgroundColor );
-  QGraphicsView::drawBackground(painter, r);
+  QPixmap const tile = gridTile(size,
+                                painter->device()->devicePixelRatioF(),
+                                flowViewStyle.FineGridColor,
+                                flowViewStyle.CoarseGridColor,
+                                fineOpacity,
+                                coarseOpacity);
 
-  QPen pfine(flowViewStyle.FineGridColor, 1.0);
+  QBrush brush(tile);
 
-  painter->setPen(pfine);
-  drawGrid(15);
+  // Tiles are whole pixels, this keeps the grid on the scene's multiples
+  // of the coarse step however far the view pans. Texture brushes ignore
+  // the device pixel ratio, the scale goes from device pixels.
+  qreal const tileScale = coarseGridStep / tile.width();
 
-  QPen p(flowViewStyle.CoarseGridColor, 1.0);
+  brush.setTransform(QTransform::fromScale(tileScale, tileScale));
 
-  painter->setPen(p);
-  drawGrid(150);
+  painter->fillRect(r, brush);
 }
 
 
@@ -459,6 +687,66 @@ scene()
 }
 
 
+void
+FlowView::
+selectInRubberBand()
+{
+  QPainterPath area;
+  area.addPolygon(mapToScene(_rubberBand->geometry()));
+
+  QRectF const bounds = area.boundingRect();
+
+  std::unordered_set<QGraphicsItem*> touched;
+
+  auto selectable = [&](QGraphicsItem * item)
+  {
+    return item->scene() == _scene && item->isVisible() &&
+           (item->flags() & QGraphicsItem::ItemIsSelectable);
+  };
+
+  for (NodeGraphicsObject * ngo : _scene->index().nodes(bounds))
+  {
+    if (selectable(ngo) && ngo->mapToScene(ngo->shape()).intersects(area))
+      touched.insert(ngo);
+  }
+
+  for (ConnectionGraphicsObject * cgo : _scene->index().connections(bounds))
+  {
+    if (selectable(cgo) && cgo->mapToScene(cgo->shape()).intersects(area))
+      touched.insert(cgo);
+  }
+
+  // Each setSelected() would emit selectionChanged, and the band moves
+  // with the mouse; the scene hears about the whole change once
+  bool changed = false;
+
+  {
+    QSignalBlocker blocker(_scene);
+
+    for (QGraphicsItem * item : _scene->selectedItems())
+    {
+      if (!touched.count(item))
+      {
+        item->setSelected(false);
+        changed = true;
+      }
+    }
+
+    for (QGraphicsItem * item : touched)
+    {
+      if (!item->isSelected())
+      {
+        item->setSelected(true);
+        changed = true;
+      }
+    }
+  }
+
+  if (changed)
+    Q_EMIT _scene->selectionChanged();
+}
+
+
 
 ViewChangeCommand::ViewChangeCommand( FlowView & view, QUndoCommand * parent )
 	: QUndoCommand( QString("Viewport Changed"), parent )
@@ -58,6 +58,12 @@ FlowViewStyle & FlowViewStyle::style()
   #define FLOW_VIEW_STYLE_CHECK_UNDEFINED_VALUE(v, variable)
 #endif
 
+#define FLOW_VIEW_STYLE_READ_FLOAT(values, variable)  { \
+    auto valueRef = values[#variable]; \
+    FLOW_VIEW_STYLE_CHECK_UNDEFINED_VALUE(valueRef, variable) \
+    variable = valueRef.toDouble(); \
+}
+
 #define FLOW_VIEW_STYLE_READ_COLOR(values, variable)  { \
     auto valueRef = values[#variable]; \
     FLOW_VIEW_STYLE_CHECK_UNDEFINED_VALUE(valueRef, variable) \
@@ -113,4 +119,21 @@ loadJsonFromByteArray(QByteArray const &byteArray)
   FLOW_VIEW_STYLE_READ_COLOR(obj, BackgroundColor);
   FLOW_VIEW_STYLE_READ_COLOR(obj, FineGridColor);
   FLOW_VIEW_STYLE_READ_COLOR(obj, CoarseGridColor);
+
+  FLOW_VIEW_STYLE_READ_FLOAT(obj, LowDetailScale);
+  FLOW_VIEW_STYLE_READ_FLOAT(obj, MediumDetailScale);
+}
+
+
+FlowViewStyle::DetailLevel
+FlowViewStyle::
+detailLevel(qreal scale) const
+{
+  if (scale < LowDetailScale)
+    return DetailLevel::Low;
+
+  if (scale < MediumDetailScale)
+    return DetailLevel::Medium;
+
+  return DetailLevel::Full;
 }
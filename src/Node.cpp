@@ -1,41 +1,46 @@
 #include "Node.hpp"
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QObject>
 
 #include <utility>
 #include <iostream>
+#include <vector>
 
-#include "FlowScene.hpp"
+#include "FlowGraph.hpp"
 
-#include "NodeGraphicsObject.hpp"
 #include "NodeDataModel.hpp"
 
-#include "ConnectionGraphicsObject.hpp"
+#include "Connection.hpp"
 #include "ConnectionState.hpp"
 
+#include "DataflowExecutor.hpp"
+#include "SceneJournal.hpp"
+
 using QtNodes::Node;
-using QtNodes::NodeGeometry;
+using QtNodes::NodeGraphics;
 using QtNodes::NodeState;
 using QtNodes::NodeData;
 using QtNodes::NodeDataType;
 using QtNodes::NodeDataModel;
-using QtNodes::NodeGraphicsObject;
+using QtNodes::FlowGraph;
+using QtNodes::DataflowExecutor;
 using QtNodes::PortIndex;
 using QtNodes::PortType;
-using QtNodes::NodeAddCommand;
-using QtNodes::NodeRemoveCommand;
+using QtNodes::SlotHandle;
 
 
 Node::
-Node(std::unique_ptr<NodeDataModel> && dataModel )
+Node(std::unique_ptr<NodeDataModel> && dataModel,
+     FlowGraph & graph)
   : _uid(QUuid::createUuid())
+  , _evaluationTime(0)
+  , _evaluationCount(0)
+  , _graph(graph)
   , _nodeDataModel(std::move(dataModel))
   , _nodeState(_nodeDataModel)
-  , _nodeGeometry(_nodeDataModel)
-  , _nodeGraphicsObject(nullptr)
+  , _graphics(nullptr)
 {
-  _nodeGeometry.recalculateSize();
-
   // propagate data: model => node
   connect(_nodeDataModel.get(), &NodeDataModel::dataUpdated,
           this, &Node::onDataUpdated);
@@ -66,9 +71,11 @@ save() const
 
   nodeJson["model"] = _nodeDataModel->save();
 
+  QPointF const pos = position();
+
   QJsonObject obj;
-  obj["x"] = _nodeGraphicsObject->pos().x();
-  obj["y"] = _nodeGraphicsObject->pos().y();
+  obj["x"] = pos.x();
+  obj["y"] = pos.y();
   nodeJson["position"] = obj;
 
   return nodeJson;
@@ -84,7 +91,7 @@ restore(QJsonObject const& json)
   QJsonObject positionJson = json["position"].toObject();
   QPointF     point(positionJson["x"].toDouble(),
                     positionJson["y"].toDouble());
-  _nodeGraphicsObject->setPos(point);
+  setPosition(point);
 
   _nodeDataModel->restore(json["model"].toObject());
 }
@@ -98,23 +105,19 @@ id() const
 }
 
 
-void
+SlotHandle
 Node::
-reactToPossibleConnection(PortType reactingPortType,
-                          NodeDataType const &reactingDataType,
-                          QPointF const &scenePoint)
+handle() const
 {
-  QTransform const t = _nodeGraphicsObject->sceneTransform();
-
-  QPointF p = t.inverted().map(scenePoint);
-
-  _nodeGeometry.setDraggingPosition(p);
+  return _handle;
+}
 
-  _nodeGraphicsObject->update();
 
-  _nodeState.setReaction(NodeState::REACTING,
-                         reactingPortType,
-                         reactingDataType);
+void
+Node::
+setHandle(SlotHandle handle)
+{
+  _handle = handle;
 }
 
 
@@ -123,49 +126,58 @@ Node::
 resetReactionToConnection()
 {
   _nodeState.setReaction(NodeState::NOT_REACTING);
-  _nodeGraphicsObject->update();
+
+  if (_graphics)
+    _graphics->repaint();
 }
 
 
-NodeGraphicsObject const &
+NodeGraphics *
 Node::
-nodeGraphicsObject() const
+graphics() const
 {
-  return *_nodeGraphicsObject.get();
+  return _graphics.get();
 }
 
 
-NodeGraphicsObject &
+void
 Node::
-nodeGraphicsObject()
+setGraphics(std::unique_ptr<NodeGraphics>&& graphics)
 {
-  return *_nodeGraphicsObject.get();
+  _graphics = std::move(graphics);
 }
 
 
-void
+bool
 Node::
-setGraphicsObject(std::unique_ptr<NodeGraphicsObject>&& graphics)
+hasGraphicsObject() const
 {
-  _nodeGraphicsObject = std::move(graphics);
-
-  _nodeGeometry.recalculateSize();
+  return _graphics != nullptr;
 }
 
 
-NodeGeometry&
+QPointF
 Node::
-nodeGeometry()
+position() const
 {
-  return _nodeGeometry;
+  return _position;
 }
 
 
-NodeGeometry const&
+void
 Node::
-nodeGeometry() const
+setPosition(QPointF const & position)
 {
-  return _nodeGeometry;
+  // The graphics report their moves back
+  if (position == _position)
+    return;
+
+  _position = position;
+
+  if (_graphics)
+    _graphics->moved();
+
+  _graph.nodeMoved(*this, position);
 }
 
 
@@ -193,28 +205,126 @@ nodeDataModel() const
 }
 
 
+FlowGraph &
+Node::
+getGraph() const
+{
+  return _graph;
+}
+
+
 void
 Node::
 propagateData(std::shared_ptr<NodeData> nodeData,
 			  PortIndex inPortIndex)
 {
+  // Nothing to compute for a node on its way out
+  if (_graph.isTearingDown() || _graph.isRemoving(*this))
+    return;
+
+  DataflowExecutor * executor = _graph.executor();
+
+  if (executor && _nodeDataModel->threadSafe())
+  {
+    executor->schedule(*this, std::move(nodeData), inPortIndex);
+    return;
+  }
+
+  applyData(std::move(nodeData), inPortIndex);
+}
+
+
+void
+Node::
+applyData(std::shared_ptr<NodeData> nodeData,
+          PortIndex inPortIndex)
+{
+  QElapsedTimer timer;
+
+  if (_graph.profiling())
+    timer.start();
+
   _nodeDataModel->setInData(std::move(nodeData), inPortIndex);
 
+  dataApplied(timer.isValid() ? timer.nsecsElapsed() : -1);
+}
+
+
+void
+Node::
+dataApplied(qint64 elapsed)
+{
+  if (elapsed >= 0)
+  {
+    _evaluationTime += elapsed;
+    ++_evaluationCount;
+  }
+
+  // Sinks change state without reporting new output
+  if (SceneJournal * journal = _graph.journal())
+    journal->modelChanged(id());
+
   updateGraphics();
 }
 
 
+qint64
+Node::
+evaluationTime() const
+{
+  return _evaluationTime;
+}
+
+
+unsigned int
+Node::
+evaluationCount() const
+{
+  return _evaluationCount;
+}
+
+
+void
+Node::
+resetEvaluationStats()
+{
+  _evaluationTime  = 0;
+  _evaluationCount = 0;
+}
+
+
 void
 Node::
 onDataUpdated(PortIndex index)
 {
-  auto nodeData = _nodeDataModel->outData(index);
+  // The node's connections may be gone already
+  if (_graph.isTearingDown())
+    return;
+
+  // New output usually means new model state
+  if (SceneJournal * journal = _graph.journal())
+    journal->modelChanged(id());
 
-  auto connections =
-    _nodeState.connections(PortType::Out, index);
+  if (_graph.queuesDataUpdates())
+  {
+    _graph.queueDataUpdate(*this, index);
+    return;
+  }
 
-  for (auto const & c : connections)
-	c.second->setInData(nodeData);
+  pushData(index);
+}
+
+
+void
+Node::
+pushData(PortIndex index)
+{
+  auto nodeData = _nodeDataModel->outData(index);
+
+  // Indexed and looked up again on every step: a downstream model
+  // may change the ports of this node when on a cycle
+  for (std::size_t i = 0; i < _nodeState.connections(PortType::Out, index).size(); ++i)
+	_nodeState.connections(PortType::Out, index)[i]->setInData(nodeData);
 }
 
 void
@@ -223,37 +333,98 @@ prodOnDataUpdated(PortIndex index, Connection * con)
 {
   auto nodeData = _nodeDataModel->outData(index);
 
-  auto connections =
+  auto const connections =
 	_nodeState.connections(PortType::Out, index);
 
-  for (auto const & c : connections)
-	if( con == c.second )
+  for (Connection * c : connections)
+	if( con == c )
 	  {
-		c.second->setInData(nodeData);
+		c->setInData(nodeData);
 		break;
 	  }
 }
 
 void
 Node::
-onNodeSizeUpdated()
+markInputDirty(PortIndex index)
 {
-    if( nodeDataModel()->embeddedWidget() )
+  // A worklist rather than recursion, chains of large graphs run
+  // deeper than the stack
+  std::vector<std::pair<Node*, PortIndex>> stack;
+
+  stack.emplace_back(this, index);
+
+  while (!stack.empty())
+  {
+    Node *    node = stack.back().first;
+    PortIndex port = stack.back().second;
+    stack.pop_back();
+
+    NodeState & state = node->_nodeState;
+
+    bool const wasDirty = state.isDirty();
+
+    state.setInputDirty(port, true);
+
+    // Downstream was marked when the first input became dirty
+    if (wasDirty)
+      continue;
+
+    for (auto const & connections : state.getEntries(PortType::Out))
+    {
+      for (Connection * c : connections)
+      {
+        if (Node * downstream = c->getNode(PortType::In))
+          stack.emplace_back(downstream, c->getPortIndex(PortType::In));
+      }
+    }
+
+    // Sinks and selected nodes want their data; visible ones ask when painted
+    if (node->_nodeDataModel->nPorts(PortType::Out) == 0 ||
+        (node->_graphics && node->_graphics->selected()))
     {
-        nodeDataModel()->embeddedWidget()->adjustSize();
+      _graph.requestPull(*node);
     }
-    nodeGeometry().recalculateSize();
-    for(PortType type: {PortType::In, PortType::Out})
+
+    if (node->_graphics)
+      node->_graphics->repaint();
+  }
+}
+
+
+void
+Node::
+pullInputs()
+{
+  auto const & inEntries = _nodeState.getEntries(PortType::In);
+
+  for (PortIndex i = 0; i < static_cast<PortIndex>(inEntries.size()); ++i)
+  {
+    if (!_nodeState.inputDirty(i))
+      continue;
+
+    _nodeState.setInputDirty(i, false);
+
+    // The port lost its connection while dirty
+    if (inEntries[i].empty())
     {
-        for(auto& conn_set : nodeState().getEntries(type))
-        {
-            for(auto& pair: conn_set)
-            {
-                Connection* conn = pair.second;
-                conn->getConnectionGraphicsObject().move();
-            }
-        }
+      propagateData(nullptr, i);
+      continue;
     }
+
+    // Looked up on every step, pulling may change the number of ports
+    for (std::size_t j = 0; j < _nodeState.connections(PortType::In, i).size(); ++j)
+      _nodeState.connections(PortType::In, i)[j]->pull();
+  }
+}
+
+
+void
+Node::
+onNodeSizeUpdated()
+{
+  if (_graphics)
+    _graphics->embeddedWidgetResized();
 }
 
 void
@@ -263,64 +434,7 @@ updateGraphics()
   //Check how many ports are wanted
   _nodeState.updateNumPorts( nodeDataModel()->nPorts( PortType::In ), nodeDataModel()->nPorts( PortType::Out ) );
 
-  //Recalculate the nodes visuals. A data change can result in the node taking more space than before, so this forces a recalculate+repaint on the affected node
-  _nodeGraphicsObject->setGeometryChanged();
-  _nodeGeometry.recalculateSize();
-  _nodeGraphicsObject->update();
-  _nodeGraphicsObject->moveConnections();
+  //A data change can result in the node taking more space than before
+  if (_graphics)
+    _graphics->contentsChanged();
 }
-
-NodeAddCommand::NodeAddCommand( Node & node, QUndoCommand * parent )
-	: QUndoCommand( "Node Added", parent )
-	, scene( node.nodeGraphicsObject().getScene() )
-	, id( node.id() )
-	, nodeJson( ) // Saving is done at undo time
-	{
-	}
-
-void NodeAddCommand::undo()
-	{
-	nodeJson = scene.nodes().at( id )->save();
-	scene.removeNode( *scene.nodes().at( id ) );
-	}
-
-void NodeAddCommand::redo()
-	{
-	if( firstRun )
-		firstRun = false;
-	else
-		scene.restoreNode( nodeJson );
-	}
-
-NodeRemoveCommand::NodeRemoveCommand( Node & node, QUndoCommand * parent )
-	: QUndoCommand( "Node Removed", parent )
-	, scene( node.nodeGraphicsObject().getScene() )
-	, id( node.id() )
-	, nodeJson( )
-	{
-	for(auto portType: {PortType::In,PortType::Out})
-		{
-		auto nodeState = node.nodeState();
-		auto const & nodeEntries = nodeState.getEntries(portType);
-
-		for (auto &connections : nodeEntries)
-			for (auto const &pair : connections)
-				new ConnectionRemoveCommand( *pair.second, this );
-		}
-	}
-
-void NodeRemoveCommand::undo()
-	{
-	scene.restoreNode( nodeJson );
-
-	QUndoCommand::undo();
-	}
-
-void NodeRemoveCommand::redo()
-	{
-	QUndoCommand::redo();
-
-	nodeJson = scene.nodes().at( id )->save();
-	scene.removeNode( *scene.nodes().at( id ) );
-	}
-
@@ -66,11 +66,11 @@ canConnect(PortIndex &portIndex, SharedTypeConverter & converter) const
   {
     if (requiredPort == PortType::In)
     {
-      converter = _scene->registry().getTypeConverter(connectionDataType, candidateNodeDataType);
+      converter = _scene->graph().registry().getTypeConverter(connectionDataType, candidateNodeDataType);
     }
     else if (requiredPort == PortType::Out)
     {
-      converter = _scene->registry().getTypeConverter(candidateNodeDataType , connectionDataType);
+      converter = _scene->graph().registry().getTypeConverter(candidateNodeDataType , connectionDataType);
     }
 
     return (converter.get() != nullptr);
@@ -112,7 +112,7 @@ tryConnect() const
   _connection->setNodeToPort(*_node, requiredPort, portIndex);
 
   // 4) Adjust Connection geometry
-  _node->nodeGraphicsObject().moveConnections();
+  nodeGraphicsObject(*_node).moveConnections();
 
   _connection->getNode( PortType::In  )->nodeDataModel()->inputConnectionCreated(  _connection->getPortIndex( PortType::In  ) );
   _connection->getNode( PortType::Out )->nodeDataModel()->outputConnectionCreated( _connection->getPortIndex( PortType::Out ) );
@@ -158,7 +158,7 @@ disconnect(PortType portToDisconnect) const
 
   _connection->setRequiredPort(portToDisconnect);
 
-  _connection->getConnectionGraphicsObject().grabMouse();
+  connectionGraphicsObject(*_connection).grabMouse();
 
   _connection->setTypeConverter( nullptr );
 
@@ -183,7 +183,7 @@ NodeConnectionInteraction::
 connectionEndScenePosition(PortType portType) const
 {
   auto &go =
-    _connection->getConnectionGraphicsObject();
+    connectionGraphicsObject(*_connection);
 
   ConnectionGeometry& geometry = _connection->connectionGeometry();
 
@@ -197,11 +197,11 @@ QPointF
 NodeConnectionInteraction::
 nodePortScenePosition(PortType portType, PortIndex portIndex) const
 {
-  NodeGeometry const &geom = _node->nodeGeometry();
+  NodeGeometry const &geom = nodeGeometry(*_node);
 
   QPointF p = geom.portScenePosition(portIndex, portType);
 
-  NodeGraphicsObject& ngo = _node->nodeGraphicsObject();
+  NodeGraphicsObject& ngo = nodeGraphicsObject(*_node);
 
   return ngo.sceneTransform().map(p);
 }
@@ -212,10 +212,10 @@ NodeConnectionInteraction::
 nodePortIndexUnderScenePoint(PortType portType,
                              QPointF const & scenePoint) const
 {
-  NodeGeometry const &nodeGeom = _node->nodeGeometry();
+  NodeGeometry const &nodeGeom = nodeGeometry(*_node);
 
   QTransform sceneTransform =
-    _node->nodeGraphicsObject().sceneTransform();
+    nodeGraphicsObject(*_node).sceneTransform();
 
   PortIndex portIndex = nodeGeom.checkHitScenePoint(portType,
                                                     scenePoint,
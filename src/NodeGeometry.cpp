@@ -3,16 +3,20 @@
 #include <iostream>
 #include <cmath>
 
+#include <QtWidgets/QWidget>
+
 #include "PortType.hpp"
 #include "NodeState.hpp"
 #include "NodeDataModel.hpp"
 #include "Node.hpp"
 #include "NodeGraphicsObject.hpp"
+#include "NodeLayout.hpp"
 
 #include "StyleCollection.hpp"
 
 using QtNodes::NodeGeometry;
 using QtNodes::NodeDataModel;
+using QtNodes::NodeLayout;
 using QtNodes::PortIndex;
 using QtNodes::PortType;
 using QtNodes::Node;
@@ -20,7 +24,7 @@ using QtNodes::Node;
 static const size_t embeddedWidgetPaddingX = 20;
 
 NodeGeometry::
-NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel)
+NodeGeometry(NodeDataModel * dataModel)
   : _width(100)
   , _height(150)
   , _inputPortWidth(70)
@@ -32,13 +36,7 @@ NodeGeometry(std::unique_ptr<NodeDataModel> const &dataModel)
   , _nSinks(dataModel->nPorts(PortType::In))
   , _draggingPos(-1000, -1000)
   , _dataModel(dataModel)
-  , _fontMetrics(QFont())
-  , _boldFontMetrics(QFont())
-{
-  QFont f; f.setBold(true);
-
-  _boldFontMetrics = QFontMetrics(f);
-}
+{}
 
 unsigned int
 NodeGeometry::nSources() const
@@ -84,7 +82,9 @@ void
 NodeGeometry::
 recalculateSize() const
 {
-  _entryHeight = _fontMetrics.height();
+  _layout = NodeLayout::of(*_dataModel, _font);
+
+  _entryHeight = _layout->entryHeight;
 
   {
 	unsigned int maxNumOfEntries = std::max(nSinks(), nSources());
@@ -99,8 +99,8 @@ recalculateSize() const
 
   _height += captionHeight();
 
-  _inputPortWidth  = portWidth(PortType::In);
-  _outputPortWidth = portWidth(PortType::Out);
+  _inputPortWidth  = _layout->inputPortWidth;
+  _outputPortWidth = _layout->outputPortWidth;
 
   _width = _inputPortWidth +
            _outputPortWidth +
@@ -126,20 +126,24 @@ void
 NodeGeometry::
 recalculateSize(QFont const & font) const
 {
-  QFontMetrics fontMetrics(font);
-  QFont boldFont = font;
+  // Runs on every paint, a font comparison is all it may cost
+  if (_layout && _font == font)
+    return;
 
-  boldFont.setBold(true);
+  _font = font;
 
-  QFontMetrics boldFontMetrics(boldFont);
+  recalculateSize();
+}
 
-  if (_boldFontMetrics != boldFontMetrics)
-  {
-    _fontMetrics     = fontMetrics;
-    _boldFontMetrics = boldFontMetrics;
 
-    recalculateSize();
-  }
+NodeLayout const &
+NodeGeometry::
+layout() const
+{
+  if (!_layout)
+    _layout = NodeLayout::of(*_dataModel, _font);
+
+  return *_layout;
 }
 
 
@@ -285,12 +289,7 @@ unsigned int
 NodeGeometry::
 captionHeight() const
 {
-  if (!_dataModel->captionVisible())
-    return 0;
-
-  QString name = _dataModel->caption();
-
-  return _boldFontMetrics.boundingRect(name).height();
+  return layout().captionHeight;
 }
 
 
@@ -298,12 +297,7 @@ unsigned int
 NodeGeometry::
 captionWidth() const
 {
-  if (!_dataModel->captionVisible())
-    return 0;
-
-  QString name = _dataModel->caption();
-
-  return _boldFontMetrics.boundingRect(name).width();
+  return layout().captionWidth;
 }
 
 
@@ -311,9 +305,7 @@ unsigned int
 NodeGeometry::
 validationHeight() const
 {
-  QString msg = _dataModel->validationMessage();
-
-  return _boldFontMetrics.boundingRect(msg).height();
+  return layout().validationHeight;
 }
 
 
@@ -321,9 +313,7 @@ unsigned int
 NodeGeometry::
 validationWidth() const
 {
-  QString msg = _dataModel->validationMessage();
-
-  return _boldFontMetrics.boundingRect(msg).width();
+  return layout().validationWidth;
 }
 
 
@@ -337,10 +327,10 @@ calculateNodePositionBetweenNodePorts(PortIndex targetPortIndex, PortType target
   //The first line calculates the halfway point between the ports (node position + port position on the node for both nodes averaged).
   //The second line offsets this coordinate with the size of the new node, so that the new nodes center falls on the originally
   //calculated coordinate, instead of it's upper left corner.
-  auto converterNodePos = (sourceNode->nodeGraphicsObject().pos() + sourceNode->nodeGeometry().portScenePosition(sourcePortIndex, sourcePort) +
-    targetNode->nodeGraphicsObject().pos() + targetNode->nodeGeometry().portScenePosition(targetPortIndex, targetPort)) / 2.0f;
-  converterNodePos.setX(converterNodePos.x() - newNode.nodeGeometry().width() / 2.0f);
-  converterNodePos.setY(converterNodePos.y() - newNode.nodeGeometry().height() / 2.0f);
+  auto converterNodePos = (sourceNode->position() + nodeGeometry(*sourceNode).portScenePosition(sourcePortIndex, sourcePort) +
+    targetNode->position() + nodeGeometry(*targetNode).portScenePosition(targetPortIndex, targetPort)) / 2.0f;
+  converterNodePos.setX(converterNodePos.x() - nodeGeometry(newNode).width() / 2.0f);
+  converterNodePos.setY(converterNodePos.y() - nodeGeometry(newNode).height() / 2.0f);
   return converterNodePos;
 }
 
@@ -349,24 +339,6 @@ unsigned int
 NodeGeometry::
 portWidth(PortType portType) const
 {
-  unsigned width = 0;
-
-  for (auto i = 0ul; i < _dataModel->nPorts(portType); ++i)
-  {
-    QString name;
-
-    if (_dataModel->portCaptionVisible(portType, i))
-    {
-      name = _dataModel->portCaption(portType, i);
-    }
-    else
-    {
-      name = _dataModel->dataType(portType, i).name;
-    }
-
-    width = std::max(unsigned(_fontMetrics.width(name)),
-                     width);
-  }
-
-  return width;
+  return portType == PortType::In ? layout().inputPortWidth
+                                  : layout().outputPortWidth;
 }
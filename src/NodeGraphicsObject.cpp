@@ -4,19 +4,22 @@
 #include <cstdlib>
 
 #include <QtWidgets/QtWidgets>
-#include <QtWidgets/QGraphicsEffect>
 
 #include "ConnectionGraphicsObject.hpp"
 #include "ConnectionState.hpp"
 
 #include "FlowScene.hpp"
 #include "NodePainter.hpp"
+#include "NodeShadow.hpp"
 
 #include "Node.hpp"
 #include "NodeDataModel.hpp"
 #include "NodeConnectionInteraction.hpp"
 
 #include "StyleCollection.hpp"
+#include "SceneJournal.hpp"
+#include "SceneIndex.hpp"
+#include "SceneTiles.hpp"
 
 using QtNodes::NodeGraphicsObject;
 using QtNodes::Node;
@@ -27,6 +30,7 @@ NodeGraphicsObject(FlowScene &scene,
                    Node& node)
   : _scene(scene)
   , _node(node)
+  , _geometry(node.nodeDataModel())
   , _locked(false)
   , _proxyWidget(nullptr)
 {
@@ -40,28 +44,27 @@ NodeGraphicsObject(FlowScene &scene,
 
   setCacheMode( QGraphicsItem::DeviceCoordinateCache );
 
+  // The shadow is painted with the body, see NodeShadow
   auto const &nodeStyle = node.nodeDataModel()->nodeStyle();
 
-  {
-    auto effect = new QGraphicsDropShadowEffect;
-    effect->setOffset(4, 4);
-    effect->setBlurRadius(20);
-    effect->setColor(nodeStyle.ShadowColor);
-
-    setGraphicsEffect(effect);
-  }
-
   setOpacity(nodeStyle.Opacity);
 
   setAcceptHoverEvents(true);
 
   setZValue(0);
 
+  setPos(_node.position());
+
   embedQWidget();
 
-  // connect to the move signals to emit the move signals in FlowScene
+  _scene.index().addNode(*this);
+  _scene.tiles().file(*this, SceneTiles::Layer::Nodes);
+
+  recalculateGeometry();
+
+  // The node keeps the position and emits the move signals
   auto onMoveSlot = [this] {
-    _scene.nodeMoved(_node, pos());
+    _node.setPosition(pos());
   };
   connect(this, &QGraphicsObject::xChanged, this, onMoveSlot);
   connect(this, &QGraphicsObject::yChanged, this, onMoveSlot);
@@ -71,7 +74,8 @@ NodeGraphicsObject(FlowScene &scene,
 NodeGraphicsObject::
 ~NodeGraphicsObject()
 {
-  _scene.removeItem(this);
+  _scene.index().removeNode(*this);
+  _scene.tiles().remove(*this);
 }
 
 
@@ -91,12 +95,26 @@ node() const
 }
 
 
+QtNodes::NodeGeometry&
+NodeGraphicsObject::
+geometry()
+{
+  return _geometry;
+}
+
+
+QtNodes::NodeGeometry const&
+NodeGraphicsObject::
+geometry() const
+{
+  return _geometry;
+}
+
+
 void
 NodeGraphicsObject::
 embedQWidget()
 {
-  NodeGeometry & geom = _node.nodeGeometry();
-
   if (auto w = _node.nodeDataModel()->embeddedWidget())
   {
     _proxyWidget = new QGraphicsProxyWidget(this);
@@ -105,7 +123,38 @@ embedQWidget()
 
     _proxyWidget->setPreferredWidth(5);
 
-    geom.recalculateSize();
+	_proxyWidget->setOpacity(1.0);
+	_proxyWidget->setFlag(QGraphicsItem::ItemIgnoresParentOpacity, true);
+  }
+}
+
+
+void
+NodeGraphicsObject::
+releaseEmbeddedWidget()
+{
+  if (!_proxyWidget)
+    return;
+
+  // Not to show up as a window of its own
+  if (auto w = _proxyWidget->widget())
+    w->hide();
+
+  _proxyWidget->setWidget(nullptr);
+}
+
+
+void
+NodeGraphicsObject::
+recalculateGeometry()
+{
+  NodeGeometry & geom = _geometry;
+
+  geom.recalculateSize();
+
+  if (_proxyWidget)
+  {
+    auto w = _proxyWidget->widget();
 
     if (w->sizePolicy().verticalPolicy() & QSizePolicy::ExpandFlag)
     {
@@ -114,12 +163,12 @@ embedQWidget()
     }
 
     _proxyWidget->setPos(geom.widgetPosition());
+  }
 
-    update();
+  _scene.index().invalidateNode(*this);
+  _scene.tiles().refile(*this);
 
-	_proxyWidget->setOpacity(1.0);
-	_proxyWidget->setFlag(QGraphicsItem::ItemIgnoresParentOpacity, true);
-  }
+  update();
 }
 
 
@@ -127,7 +176,21 @@ QRectF
 NodeGraphicsObject::
 boundingRect() const
 {
-  return _node.nodeGeometry().boundingRect();
+  QRectF const body = _geometry.boundingRect();
+
+  return body.united(NodeShadow::rect(body));
+}
+
+
+QPainterPath
+NodeGraphicsObject::
+shape() const
+{
+  // The shadow takes no clicks
+  QPainterPath path;
+  path.addRect(_geometry.boundingRect());
+
+  return path;
 }
 
 
@@ -136,6 +199,8 @@ NodeGraphicsObject::
 setGeometryChanged()
 {
   prepareGeometryChange();
+
+  _scene.index().invalidateNode(*this);
 }
 
 
@@ -152,8 +217,12 @@ moveConnections() const
 
     for (auto const & connections : connectionEntries)
     {
-      for (auto & con : connections)
-        con.second->getConnectionGraphicsObject().move();
+      for (Connection * con : connections)
+      {
+        // Graphics created later are placed on creation
+        if (con->hasGraphicsObject())
+          connectionGraphicsObject(*con).move();
+      }
     }
   }
 }
@@ -179,6 +248,82 @@ getScene()
 }
 
 
+void
+NodeGraphicsObject::
+reactToPossibleConnection(PortType reactingPortType,
+                          NodeDataType const &reactingDataType,
+                          QPointF const &scenePoint)
+{
+  QTransform const t = sceneTransform();
+
+  QPointF p = t.inverted().map(scenePoint);
+
+  _geometry.setDraggingPosition(p);
+
+  update();
+
+  _node.nodeState().setReaction(NodeState::REACTING,
+                                reactingPortType,
+                                reactingDataType);
+}
+
+
+void
+NodeGraphicsObject::
+moved()
+{
+  // Dragged here, see the constructor
+  if (pos() == _node.position())
+    return;
+
+  setPos(_node.position());
+
+  moveConnections();
+}
+
+
+void
+NodeGraphicsObject::
+contentsChanged()
+{
+  setGeometryChanged();
+  _geometry.recalculateSize();
+  _scene.tiles().refile(*this);
+  update();
+  moveConnections();
+}
+
+
+void
+NodeGraphicsObject::
+embeddedWidgetResized()
+{
+  if (auto w = _node.nodeDataModel()->embeddedWidget())
+    w->adjustSize();
+
+  setGeometryChanged();
+  _geometry.recalculateSize();
+  _scene.tiles().refile(*this);
+  moveConnections();
+}
+
+
+void
+NodeGraphicsObject::
+repaint()
+{
+  update();
+}
+
+
+bool
+NodeGraphicsObject::
+selected() const
+{
+  return isSelected();
+}
+
+
 void
 NodeGraphicsObject::
 paint(QPainter * painter,
@@ -187,7 +332,16 @@ paint(QPainter * painter,
 {
   painter->setClipRect(option->exposedRect);
 
-  NodePainter::paint(painter, _node, _scene);
+  // Pull mode: a node on screen wants its data
+  if (_node.nodeState().isDirty())
+    _scene.graph().requestPull(_node);
+
+  // The device cache paints under the view's scale as well
+  qreal const scale =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
+  NodePainter::paint(painter, _node, _scene,
+                     StyleCollection::flowViewStyle().detailLevel(scale));
 }
 
 
@@ -199,6 +353,19 @@ itemChange(GraphicsItemChange change, const QVariant &value)
   {
     moveConnections();
   }
+  else if (change == ItemScenePositionHasChanged)
+  {
+    _scene.index().invalidateNode(*this);
+    _scene.tiles().refile(*this);
+  }
+  else if (change == ItemSceneHasChanged)
+  {
+    _scene.index().invalidateNode(*this);
+  }
+  else if (change == ItemZValueHasChanged)
+  {
+    _scene.tiles().restack(*this);
+  }
 
   return QGraphicsItem::itemChange(change, value);
 }
@@ -222,7 +389,7 @@ mousePressEvent(QGraphicsSceneMouseEvent * event)
 
   for (PortType portToCheck: {PortType::In, PortType::Out})
   {
-    NodeGeometry const & nodeGeometry = _node.nodeGeometry();
+    NodeGeometry const & nodeGeometry = _geometry;
 
     // TODO do not pass sceneTransform
     int const portIndex = nodeGeometry.checkHitScenePoint(portToCheck,
@@ -233,13 +400,13 @@ mousePressEvent(QGraphicsSceneMouseEvent * event)
     {
       NodeState const & nodeState = _node.nodeState();
 
-      std::unordered_map<QUuid, Connection*> connections =
+      auto const connections =
 		nodeState.connections(portToCheck, portIndex);
 
       // start dragging existing connection
       if (!connections.empty() && portToCheck == PortType::In)
       {
-		auto con = connections.begin()->second;
+		auto con = connections[0];
 
 		_scene.undoStack->push( new ConnectionRemoveCommand( *con ) );
 
@@ -255,11 +422,11 @@ mousePressEvent(QGraphicsSceneMouseEvent * event)
           if (!connections.empty() &&
               outPolicy == NodeDataModel::ConnectionPolicy::One)
 		  {
-			auto con = connections.begin()->second;
+			auto con = connections[0];
 
 			_scene.undoStack->push( new ConnectionRemoveCommand( *con ) );
 
-			_scene.deleteConnection( *con );
+			_scene.graph().deleteConnection( *con );
 
 			//con->getNode( PortType::Out )->nodeDataModel()->outputConnectionDeleted( *con );
 			//con->getNode( PortType::In )->nodeDataModel()->inputConnectionDeleted( *con );
@@ -267,22 +434,22 @@ mousePressEvent(QGraphicsSceneMouseEvent * event)
         }
 
         // todo add to FlowScene
-        auto connection = _scene.createConnection(portToCheck,
-                                                  _node,
-                                                  portIndex);
+        auto connection = _scene.graph().createConnection(portToCheck,
+                                                          _node,
+                                                          portIndex);
 
         _node.nodeState().setConnection(portToCheck,
                                         portIndex,
                                         *connection);
 
-        connection->getConnectionGraphicsObject().grabMouse();
+        connectionGraphicsObject(*connection).grabMouse();
       }
     }
   }
 
   {
 	auto pos     = event->pos();
-	auto & geom  = _node.nodeGeometry();
+	auto & geom  = _geometry;
 	auto & state = _node.nodeState();
 
 	if (_node.nodeDataModel()->resizable() &&
@@ -301,7 +468,7 @@ void
 NodeGraphicsObject::
 mouseMoveEvent(QGraphicsSceneMouseEvent * event)
 {
-  auto & geom  = _node.nodeGeometry();
+  auto & geom  = _geometry;
   auto & state = _node.nodeState();
 
   if (state.resizing())
@@ -310,7 +477,7 @@ mouseMoveEvent(QGraphicsSceneMouseEvent * event)
 
     if (auto w = _node.nodeDataModel()->embeddedWidget())
     {
-      prepareGeometryChange();
+      setGeometryChanged();
 
       auto oldSize = w->size();
 
@@ -323,6 +490,7 @@ mouseMoveEvent(QGraphicsSceneMouseEvent * event)
       _proxyWidget->setPos(geom.widgetPosition());
 
       geom.recalculateSize();
+      _scene.tiles().refile(*this);
       update();
 
       moveConnections();
@@ -379,21 +547,20 @@ void
 NodeGraphicsObject::
 hoverEnterEvent(QGraphicsSceneHoverEvent * event)
 {
-  // bring all the colliding nodes to background
-  QList<QGraphicsItem *> overlapItems = collidingItems();
-
-  for (QGraphicsItem *item : overlapItems)
+  // bring all the colliding nodes to background. Only nodes are ever
+  // raised, so connections need not be looked at.
+  for (NodeGraphicsObject * other : _scene.index().nodes(sceneBoundingRect()))
   {
-    if (item->zValue() > 0.0)
+    if (other != this && other->zValue() > 0.0)
     {
-      item->setZValue(0.0);
+      other->setZValue(0.0);
     }
   }
 
   // bring this node forward
   setZValue(1.0);
 
-  _node.nodeGeometry().setHovered(true);
+  _geometry.setHovered(true);
   update();
   _scene.nodeHovered(node(), event->screenPos());
   event->accept();
@@ -404,7 +571,7 @@ void
 NodeGraphicsObject::
 hoverLeaveEvent(QGraphicsSceneHoverEvent * event)
 {
-  _node.nodeGeometry().setHovered(false);
+  _geometry.setHovered(false);
   update();
   _scene.nodeHoverLeft(node());
   event->accept();
@@ -416,7 +583,7 @@ NodeGraphicsObject::
 hoverMoveEvent(QGraphicsSceneHoverEvent * event)
 {
   auto pos    = event->pos();
-  auto & geom = _node.nodeGeometry();
+  auto & geom = _geometry;
 
   if (_node.nodeDataModel()->resizable() &&
       geom.resizeRect().contains(QPoint(pos.x(), pos.y())))
@@ -462,16 +629,36 @@ NodeMoveCommand::NodeMoveCommand( NodeGraphicsObject & nodeGO, QPointF oldPos, Q
 
 void NodeMoveCommand::undo()
 	{
-	auto & nodeGO = scene.nodes().at( id )->nodeGraphicsObject();
-	nodeGO.setPos( oldPos );
-	nodeGO.moveConnections();
+	scene.graph().setNodePosition( *scene.graph().node( id ), oldPos );
+	if( auto journal = scene.graph().journal() )
+		journal->nodeMoved( id, oldPos );
 	setText( QString("Node moved to: (") + QString::number( newPos.x() ) + "," + QString::number( newPos.y() ) + ")" );
 	}
 
 void NodeMoveCommand::redo()
 	{
-	auto & nodeGO = scene.nodes().at( id )->nodeGraphicsObject();
-	nodeGO.setPos( newPos );
-	nodeGO.moveConnections();
+	scene.graph().setNodePosition( *scene.graph().node( id ), newPos );
+	if( auto journal = scene.graph().journal() )
+		journal->nodeMoved( id, newPos );
 	setText( QString( "Node moved to: (" ) + QString::number( newPos.x() ) + "," + QString::number( newPos.y() ) + ")" );
 	}
+
+
+//------------------------------------------------------------------------------
+
+NodeGraphicsObject &
+QtNodes::
+nodeGraphicsObject(Node const & node)
+{
+  Q_ASSERT(node.graphics() != nullptr);
+
+  return static_cast<NodeGraphicsObject&>(*node.graphics());
+}
+
+
+QtNodes::NodeGeometry &
+QtNodes::
+nodeGeometry(Node const & node)
+{
+  return nodeGraphicsObject(node).geometry();
+}
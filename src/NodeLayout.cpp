@@ -0,0 +1,143 @@
+#include "NodeLayout.hpp"
+
+#include <algorithm>
+
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtGui/QFontMetrics>
+
+#include "NodeDataModel.hpp"
+
+using QtNodes::NodeLayout;
+using QtNodes::NodeDataModel;
+using QtNodes::PortType;
+using QtNodes::PortIndex;
+
+namespace
+{
+
+/// Layouts still in use by some node, by the texts and font measured
+QHash<QString, std::weak_ptr<NodeLayout const>> layouts;
+
+/// Size past which the expired entries are dropped
+int pruneAt = 64;
+
+}
+
+
+QString
+NodeLayout::
+portLabel(NodeDataModel const & model, PortType portType, PortIndex index)
+{
+  if (model.portCaptionVisible(portType, index))
+    return model.portCaption(portType, index);
+
+  return model.dataType(portType, index).name;
+}
+
+
+std::vector<NodeLayout::Label> const &
+NodeLayout::
+labels(PortType portType) const
+{
+  return portType == PortType::In ? inLabels : outLabels;
+}
+
+
+std::shared_ptr<NodeLayout const>
+NodeLayout::
+of(NodeDataModel const & model, QFont const & font)
+{
+  QStringList texts;
+
+  texts << font.key()
+        << model.name()
+        << (model.captionVisible() ? model.caption() : QString())
+        << QString::number(static_cast<int>(model.validationState()))
+        << model.validationMessage();
+
+  std::vector<QString> inTexts;
+  std::vector<QString> outTexts;
+
+  for (unsigned int i = 0; i < model.nPorts(PortType::In); ++i)
+    inTexts.push_back(portLabel(model, PortType::In, i));
+
+  for (unsigned int i = 0; i < model.nPorts(PortType::Out); ++i)
+    outTexts.push_back(portLabel(model, PortType::Out, i));
+
+  // The port counts keep labels from sliding between ins and outs
+  texts << QString::number(inTexts.size()) << QString::number(outTexts.size());
+
+  for (QString const & text : inTexts)
+    texts << text;
+
+  for (QString const & text : outTexts)
+    texts << text;
+
+  QString const key = texts.join(QChar(0x1f));
+
+  if (auto layout = layouts.value(key).lock())
+    return layout;
+
+  auto layout = std::make_shared<NodeLayout>();
+
+  layout->font     = font;
+  layout->boldFont = font;
+  layout->boldFont.setBold(true);
+
+  QFontMetrics const metrics(layout->font);
+  QFontMetrics const boldMetrics(layout->boldFont);
+
+  layout->entryHeight = metrics.height();
+
+  if (model.captionVisible())
+  {
+    QRect const captionRect = boldMetrics.boundingRect(model.caption());
+
+    layout->captionWidth  = captionRect.width();
+    layout->captionHeight = captionRect.height();
+  }
+
+  layout->nameRect = boldMetrics.boundingRect(model.name());
+
+  QString const message = model.validationMessage();
+
+  QRect const validationRect = boldMetrics.boundingRect(message);
+
+  layout->validationWidth       = validationRect.width();
+  layout->validationHeight      = validationRect.height();
+  layout->validationMessageRect = metrics.boundingRect(message);
+
+  for (QString const & text : inTexts)
+  {
+    layout->inLabels.push_back({ text, metrics.boundingRect(text) });
+
+    layout->inputPortWidth = std::max(unsigned(metrics.width(text)),
+                                      layout->inputPortWidth);
+  }
+
+  for (QString const & text : outTexts)
+  {
+    layout->outLabels.push_back({ text, metrics.boundingRect(text) });
+
+    layout->outputPortWidth = std::max(unsigned(metrics.width(text)),
+                                       layout->outputPortWidth);
+  }
+
+  if (layouts.size() >= pruneAt)
+  {
+    for (auto it = layouts.begin(); it != layouts.end();)
+    {
+      if (it.value().expired())
+        it = layouts.erase(it);
+      else
+        ++it;
+    }
+
+    pruneAt = std::max(64, 2 * layouts.size());
+  }
+
+  layouts.insert(key, layout);
+
+  return layout;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QtCore/QRect>
+#include <QtCore/QString>
+#include <QtGui/QFont>
+
+#include "PortType.hpp"
+
+namespace QtNodes
+{
+
+class NodeDataModel;
+
+/// Text metrics of a node: everything NodeGeometry and NodePainter used
+/// to get from QFontMetrics. Nodes showing the same texts in the same
+/// font share one layout, which is never modified.
+struct NodeLayout
+{
+  struct Label
+  {
+    QString text;
+
+    /// As QFontMetrics::boundingRect() of the text
+    QRect rect;
+  };
+
+  QFont font;
+  QFont boldFont;
+
+  unsigned int entryHeight = 0;
+
+  /// Of the caption, in the bold font
+  unsigned int captionWidth  = 0;
+  unsigned int captionHeight = 0;
+
+  /// The model name drawn as title, in the bold font
+  QRect nameRect;
+
+  /// Of the validation message, in the bold font
+  unsigned int validationWidth  = 0;
+  unsigned int validationHeight = 0;
+
+  /// The validation message as drawn, in the regular font
+  QRect validationMessageRect;
+
+  unsigned int inputPortWidth  = 0;
+  unsigned int outputPortWidth = 0;
+
+  std::vector<Label> inLabels;
+  std::vector<Label> outLabels;
+
+  std::vector<Label> const &
+  labels(PortType portType) const;
+
+  /// The text drawn next to a port: its caption, or else its type name
+  static QString
+  portLabel(NodeDataModel const & model, PortType portType, PortIndex index);
+
+  /// The shared layout of model's current texts under font. Measured only
+  /// the first time these texts and font are seen.
+  static std::shared_ptr<NodeLayout const>
+  of(NodeDataModel const & model, QFont const & font);
+};
+}
@@ -1,5 +1,6 @@
 #include "NodePainter.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 #include <QtCore/QMargins>
@@ -10,11 +11,15 @@
 #include "NodeGeometry.hpp"
 #include "NodeState.hpp"
 #include "NodeDataModel.hpp"
+#include "NodePainterDelegate.hpp"
 #include "Node.hpp"
 #include "FlowScene.hpp"
+#include "NodeLayout.hpp"
+#include "NodeShadow.hpp"
 
 using QtNodes::NodePainter;
 using QtNodes::NodeGeometry;
+using QtNodes::NodeLayout;
 using QtNodes::NodeGraphicsObject;
 using QtNodes::Node;
 using QtNodes::NodeState;
@@ -25,19 +30,43 @@ void
 NodePainter::
 paint(QPainter* painter,
       Node & node,
-      FlowScene const& scene)
+      FlowScene const& scene,
+      FlowViewStyle::DetailLevel detail)
 {
-  NodeGeometry const& geom = node.nodeGeometry();
+  NodeGeometry const& geom = nodeGeometry(node);
 
   NodeState const& state = node.nodeState();
 
-  NodeGraphicsObject const & graphicsObject = node.nodeGraphicsObject();
+  NodeGraphicsObject const & graphicsObject = nodeGraphicsObject(node);
 
+  // Measures only when the font changed, the rest is drawing
   geom.recalculateSize(painter->font());
 
   //--------------------------------------------
   NodeDataModel const * model = node.nodeDataModel();
 
+  // Zoomed out, ports and labels would be a few pixels wide
+  if (detail != FlowViewStyle::DetailLevel::Full)
+  {
+    bool const antialiased = painter->testRenderHint(QPainter::Antialiasing);
+
+    if (detail == FlowViewStyle::DetailLevel::Low)
+      painter->setRenderHint(QPainter::Antialiasing, false);
+
+    if (detail == FlowViewStyle::DetailLevel::Medium)
+      drawShadow(painter, geom, model);
+
+    drawFlatRect(painter, geom, model, graphicsObject);
+
+    if (detail == FlowViewStyle::DetailLevel::Medium)
+      drawModelName(painter, geom, state, model);
+
+    painter->setRenderHint(QPainter::Antialiasing, antialiased);
+    return;
+  }
+
+  drawShadow(painter, geom, model);
+
   drawNodeRect(painter, geom, model, graphicsObject);
 
   drawConnectionPoints(painter, geom, state, model, scene);
@@ -104,6 +133,48 @@ drawNodeRect(QPainter* painter,
 }
 
 
+void
+NodePainter::
+drawShadow(QPainter* painter,
+           NodeGeometry const& geom,
+           NodeDataModel const* model)
+{
+  NodeStyle const& nodeStyle = model->nodeStyle();
+
+  float diam = nodeStyle.ConnectionPointDiameter;
+
+  QRectF body(-diam, -diam, 2.0 * diam + geom.width(), 2.0 * diam + geom.height());
+
+  NodeShadow::paint(painter, body, nodeStyle.ShadowColor);
+}
+
+
+void
+NodePainter::
+drawFlatRect(QPainter* painter,
+             NodeGeometry const& geom,
+             NodeDataModel const* model,
+             NodeGraphicsObject const & graphicsObject)
+{
+  NodeStyle const& nodeStyle = model->nodeStyle();
+
+  QPen p(graphicsObject.isSelected()
+         ? nodeStyle.SelectedBoundaryColor
+         : nodeStyle.NormalBoundaryColor,
+         nodeStyle.PenWidth);
+
+  // Stays visible however far the view is zoomed out
+  p.setCosmetic(true);
+
+  painter->setPen(p);
+  painter->setBrush(nodeStyle.GradientColor1);
+
+  float diam = nodeStyle.ConnectionPointDiameter;
+
+  painter->drawRect(QRectF(-diam, -diam, 2.0 * diam + geom.width(), 2.0 * diam + geom.height()));
+}
+
+
 void
 NodePainter::
 drawConnectionPoints(QPainter* painter,
@@ -145,11 +216,11 @@ drawConnectionPoints(QPainter* painter,
         {
           if (portType == PortType::In)
           {
-            typeConvertable = scene.registry().getTypeConverter(state.reactingDataType(), dataType) != nullptr;
+            typeConvertable = scene.graph().registry().getTypeConverter(state.reactingDataType(), dataType) != nullptr;
           }
           else
           {
-            typeConvertable = scene.registry().getTypeConverter(dataType, state.reactingDataType()) != nullptr;
+            typeConvertable = scene.graph().registry().getTypeConverter(dataType, state.reactingDataType()) != nullptr;
           }
         }
 
@@ -255,25 +326,16 @@ drawModelName(QPainter * painter,
   if (!model->captionVisible())
     return;
 
-  QString const &name = model->name();
-
-  QFont f = painter->font();
+  NodeLayout const & layout = geom.layout();
 
-  f.setBold(true);
-
-  QFontMetrics metrics(f);
-
-  auto rect = metrics.boundingRect(name);
-
-  QPointF position((geom.width() - rect.width()) / 2.0,
+  QPointF position((geom.width() - layout.nameRect.width()) / 2.0,
                    (geom.spacing() + geom.entryHeight()) / 3.0);
 
-  painter->setFont(f);
+  painter->setFont(layout.boldFont);
   painter->setPen(nodeStyle.FontColor);
-  painter->drawText(position, name);
+  painter->drawText(position, model->name());
 
-  f.setBold(false);
-  painter->setFont(f);
+  painter->setFont(layout.font);
 }
 
 
@@ -284,8 +346,7 @@ drawEntryLabels(QPainter * painter,
                 NodeState const & state,
                 NodeDataModel const * model)
 {
-  QFontMetrics const & metrics =
-    painter->fontMetrics();
+  NodeLayout const & layout = geom.layout();
 
   for(PortType portType: {PortType::Out, PortType::In})
   {
@@ -293,7 +354,10 @@ drawEntryLabels(QPainter * painter,
 
     auto& entries = state.getEntries(portType);
 
-    size_t n = entries.size();
+    auto const & labels = layout.labels(portType);
+
+    // Ports may have been added since the layout was made
+    size_t n = std::min(entries.size(), labels.size());
 
     for (size_t i = 0; i < n; ++i)
     {
@@ -304,18 +368,15 @@ drawEntryLabels(QPainter * painter,
       else
         painter->setPen(nodeStyle.FontColor);
 
-      QString s;
-
-      if (model->portCaptionVisible(portType, i))
-      {
-        s = model->portCaption(portType, i);
-      }
-      else
-      {
-        s = model->dataType(portType, i).name;
-      }
+      // The model may change a caption without asking for a new layout,
+      // so the text is always the live one and only its metrics come
+      // from the layout, when they were taken for the same text
+      QString const s =
+        NodeLayout::portLabel(*model, portType, static_cast<PortIndex>(i));
 
-      auto rect = metrics.boundingRect(s);
+      QRect const rect = s == labels[i].text
+                         ? labels[i].rect
+                         : painter->fontMetrics().boundingRect(s);
 
       p.setY(p.y() + rect.height() / 4.0);
 
@@ -408,16 +469,11 @@ drawValidationRect(QPainter * painter,
     //Drawing the validation message itself
     QString const &errorMsg = model->validationMessage();
 
-    QFont f = painter->font();
-
-    QFontMetrics metrics(f);
-
-    auto rect = metrics.boundingRect(errorMsg);
+    QRect const & rect = geom.layout().validationMessageRect;
 
     QPointF position((geom.width() - rect.width()) / 2.0,
                      geom.height() - (geom.validationHeight() - diam) / 2.0);
 
-    painter->setFont(f);
     painter->setPen(nodeStyle.FontColor);
     painter->drawText(position, errorMsg);
   }
@@ -2,6 +2,8 @@
 
 #include <QtGui/QPainter>
 
+#include "FlowViewStyle.hpp"
+
 namespace QtNodes
 {
 
@@ -25,7 +27,22 @@ public:
   void
   paint(QPainter* painter,
         Node& node,
-        FlowScene const& scene);
+        FlowScene const& scene,
+        FlowViewStyle::DetailLevel detail = FlowViewStyle::DetailLevel::Full);
+
+  static
+  void
+  drawShadow(QPainter* painter,
+             NodeGeometry const& geom,
+             NodeDataModel const* model);
+
+  /// Node body for the lower detail levels: one flat rect
+  static
+  void
+  drawFlatRect(QPainter* painter,
+               NodeGeometry const& geom,
+               NodeDataModel const* model,
+               NodeGraphicsObject const & graphicsObject);
 
   static
   void
@@ -0,0 +1,184 @@
+#include "NodeShadow.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include <QtGui/QPixmap>
+#include <QtGui/QPixmapCache>
+#include <QtWidgets/qdrawutil.h>
+
+using QtNodes::NodeShadow;
+
+// The effect's former settings
+static qreal const   blurRadius = 20.0;
+static QPointF const offset(4.0, 4.0);
+
+// Corner radius of the node body
+static qreal const cornerRadius = 3.0;
+
+// How far the blur reaches, as QPixmapBlurFilter::boundingRectFor
+static int const blurExtent = static_cast<int>(std::ceil(1.5 * blurRadius + 1.0));
+
+// Past this far into the body the shadow no longer changes, so the
+// slices between are stretched
+static int const sliceMargin = 2 * blurExtent;
+
+
+/// Normalized gaussian weights from -reach to reach
+static
+std::vector<float>
+gaussianKernel(int reach, qreal sigma)
+{
+  std::vector<float> kernel(2 * reach + 1);
+
+  float sum = 0.0f;
+
+  for (int i = -reach; i <= reach; ++i)
+  {
+    float const w = static_cast<float>(std::exp(-(i * i) / (2.0 * sigma * sigma)));
+
+    kernel[i + reach] = w;
+    sum += w;
+  }
+
+  for (float & w : kernel)
+    w /= sum;
+
+  return kernel;
+}
+
+
+/// The alpha of image blurred by a separable gaussian, as black.
+/// Reaches about as far as the blur of QPixmapDropShadowFilter did.
+static
+QImage
+blurredAlpha(QImage const & image)
+{
+  int const width  = image.width();
+  int const height = image.height();
+
+  int const reach = blurExtent - 1;
+
+  std::vector<float> const kernel = gaussianKernel(reach, blurRadius / 2.0);
+
+  std::vector<float> alpha(width * height);
+
+  for (int y = 0; y < height; ++y)
+  {
+    QRgb const * line = reinterpret_cast<QRgb const*>(image.constScanLine(y));
+
+    for (int x = 0; x < width; ++x)
+      alpha[y * width + x] = qAlpha(line[x]);
+  }
+
+  std::vector<float> rows(width * height, 0.0f);
+
+  for (int y = 0; y < height; ++y)
+    for (int x = 0; x < width; ++x)
+    {
+      float sum = 0.0f;
+
+      for (int k = std::max(-reach, -x); k <= std::min(reach, width - 1 - x); ++k)
+        sum += kernel[k + reach] * alpha[y * width + x + k];
+
+      rows[y * width + x] = sum;
+    }
+
+  QImage result(width, height, QImage::Format_ARGB32_Premultiplied);
+
+  for (int y = 0; y < height; ++y)
+  {
+    QRgb * line = reinterpret_cast<QRgb*>(result.scanLine(y));
+
+    for (int x = 0; x < width; ++x)
+    {
+      float sum = 0.0f;
+
+      for (int k = std::max(-reach, -y); k <= std::min(reach, height - 1 - y); ++k)
+        sum += kernel[k + reach] * rows[(y + k) * width + x];
+
+      int const a = std::min(255, static_cast<int>(sum + 0.5f));
+
+      line[x] = qRgba(0, 0, 0, a);
+    }
+  }
+
+  return result;
+}
+
+
+static
+QPixmap
+shadowPixmap(QColor const & color)
+{
+  QString const key = QStringLiteral("QtNodes::NodeShadow:%1").arg(color.rgba(), 8, 16);
+
+  QPixmap pixmap;
+
+  if (QPixmapCache::find(key, &pixmap))
+    return pixmap;
+
+  // A body wide enough for the blur to saturate in its middle
+  int const size = 2 * sliceMargin + 1;
+
+  QImage body(size, size, QImage::Format_ARGB32_Premultiplied);
+  body.fill(0);
+
+  {
+    QPainter painter(&body);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(Qt::black);
+    painter.drawRoundedRect(QRectF(blurExtent, blurExtent,
+                                   size - 2 * blurExtent, size - 2 * blurExtent),
+                            cornerRadius, cornerRadius);
+  }
+
+  // As QPixmapDropShadowFilter: blur the alpha, then colour it
+  QImage shadow = blurredAlpha(body);
+
+  {
+    QPainter painter(&shadow);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    painter.fillRect(shadow.rect(), color);
+  }
+
+  pixmap = QPixmap::fromImage(shadow);
+
+  QPixmapCache::insert(key, pixmap);
+
+  return pixmap;
+}
+
+
+QRectF
+NodeShadow::
+rect(QRectF const & body)
+{
+  return body.translated(offset).adjusted(-blurExtent, -blurExtent,
+                                          blurExtent, blurExtent);
+}
+
+
+void
+NodeShadow::
+paint(QPainter * painter, QRectF const & body, QColor const & color)
+{
+  QPixmap const pixmap = shadowPixmap(color);
+
+  QRect const target = rect(body).toAlignedRect();
+
+  // Bodies smaller than the slices get their corners squeezed
+  int const horizontal = std::min(sliceMargin, target.width() / 2);
+  int const vertical   = std::min(sliceMargin, target.height() / 2);
+
+  qDrawBorderPixmap(painter,
+                    target,
+                    QMargins(horizontal, vertical, horizontal, vertical),
+                    pixmap,
+                    pixmap.rect(),
+                    QMargins(sliceMargin, sliceMargin, sliceMargin, sliceMargin));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QtCore/QRectF>
+#include <QtGui/QColor>
+
+class QPainter;
+
+namespace QtNodes
+{
+
+/// Drop shadow under node bodies, drawn the way the
+/// QGraphicsDropShadowEffect nodes used to carry would draw it.
+/// The blurred shadow of one rounded rect is rendered once per colour
+/// and stretched over any body as a nine-slice pixmap, so a node pays
+/// one blit instead of an offscreen render and a blur per repaint.
+class NodeShadow
+{
+public:
+
+  /// Area the shadow of body covers
+  static QRectF
+  rect(QRectF const & body);
+
+  static void
+  paint(QPainter * painter, QRectF const & body, QColor const & color);
+};
+}
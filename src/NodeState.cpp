@@ -1,5 +1,7 @@
 #include "NodeState.hpp"
 
+#include <algorithm>
+
 #include "NodeDataModel.hpp"
 
 #include "Connection.hpp"
@@ -18,6 +20,8 @@ NodeState(std::unique_ptr<NodeDataModel> const &model)
   , _reaction(NOT_REACTING)
   , _reactingPortType(PortType::None)
   , _resizing(false)
+  , _dirtyInputs(model->nPorts(PortType::In), false)
+  , _dirtyInputCount(0)
 {}
 
 
@@ -43,13 +47,18 @@ getEntries(PortType portType)
 }
 
 
-NodeState::ConnectionPtrSet
+NodeState::ConnectionSpan
 NodeState::
 connections(PortType portType, PortIndex portIndex) const
 {
   auto const &connections = getEntries(portType);
 
-  return connections[portIndex];
+  if (portIndex < 0 || static_cast<size_t>(portIndex) >= connections.size())
+    return ConnectionSpan();
+
+  auto const &set = connections[portIndex];
+
+  return ConnectionSpan(set.constData(), static_cast<size_t>(set.size()));
 }
 
 
@@ -61,8 +70,10 @@ setConnection(PortType portType,
 {
   auto &connections = getEntries(portType);
 
-  connections.at(portIndex).insert(std::make_pair(connection.id(),
-                                               &connection));
+  auto &set = connections.at(portIndex);
+
+  if (!set.contains(&connection))
+    set.append(&connection);
 }
 
 
@@ -70,9 +81,14 @@ void
 NodeState::
 eraseConnection(PortType portType,
                 PortIndex portIndex,
-                QUuid id)
+                Connection const& connection)
 {
-  getEntries(portType)[portIndex].erase(id);
+  auto &set = getEntries(portType)[portIndex];
+
+  int const i = set.indexOf(const_cast<Connection*>(&connection));
+
+  if (i != -1)
+    set.remove(i);
 }
 
 
@@ -143,4 +159,45 @@ updateNumPorts( size_t in, size_t out )
 {
   _inConnections.resize( in );
   _outConnections.resize( out );
+
+  _dirtyInputs.resize( in, false );
+  _dirtyInputCount = std::count( _dirtyInputs.begin(), _dirtyInputs.end(), true );
+}
+
+
+void
+NodeState::
+setInputDirty(PortIndex portIndex, bool dirty)
+{
+  if (portIndex < 0 || static_cast<size_t>(portIndex) >= _dirtyInputs.size())
+    return;
+
+  if (_dirtyInputs[portIndex] == dirty)
+    return;
+
+  _dirtyInputs[portIndex] = dirty;
+
+  if (dirty)
+    ++_dirtyInputCount;
+  else
+    --_dirtyInputCount;
+}
+
+
+bool
+NodeState::
+inputDirty(PortIndex portIndex) const
+{
+  if (portIndex < 0 || static_cast<size_t>(portIndex) >= _dirtyInputs.size())
+    return false;
+
+  return _dirtyInputs[portIndex];
+}
+
+
+bool
+NodeState::
+isDirty() const
+{
+  return _dirtyInputCount != 0;
 }
@@ -0,0 +1,361 @@
+#include "SceneContainer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <utility>
+
+#include <QtCore/QCborArray>
+#include <QtCore/QCborMap>
+#include <QtCore/QCborStreamReader>
+#include <QtCore/QCborStreamWriter>
+#include <QtCore/QCborValue>
+#include <QtCore/QtEndian>
+
+using QtNodes::SceneContainer;
+using QtNodes::SceneContainerReader;
+
+static QByteArray const containerMagic("NEFLOWC1", 8);
+
+static qint64 const headerSize = 16;
+
+
+void
+QtNodes::
+writeCborItem(QCborStreamWriter & writer, QJsonObject const & itemJson)
+{
+  writer.startMap(itemJson.size());
+
+  for (auto it = itemJson.begin(); it != itemJson.end(); ++it)
+  {
+    QString const key = it.key();
+
+    writer.append(key);
+
+    if (key == QLatin1String("id") ||
+        key == QLatin1String("in_id") ||
+        key == QLatin1String("out_id"))
+      QCborValue(QUuid(it.value().toString())).toCbor(writer);
+    else
+      QCborValue::fromJsonValue(it.value()).toCbor(writer);
+  }
+
+  writer.endMap();
+}
+
+
+QJsonObject
+QtNodes::
+readCborItem(QCborMap const & itemMap)
+{
+  QJsonObject itemJson;
+
+  for (auto it = itemMap.begin(); it != itemMap.end(); ++it)
+  {
+    QCborValue const value = it.value();
+
+    if (value.isUuid())
+      itemJson[it.key().toString()] = value.toUuid().toString();
+    else
+      itemJson[it.key().toString()] = value.toJsonValue();
+  }
+
+  return itemJson;
+}
+
+
+static
+QCborMap
+blockEntry(qint64 offset, qint64 size)
+{
+  QCborMap entry;
+
+  entry[QStringLiteral("offset")] = offset;
+  entry[QStringLiteral("size")]   = size;
+
+  return entry;
+}
+
+
+//------------------------------------------------------------------------------
+
+bool
+SceneContainer::
+isContainer(QByteArray const & head)
+{
+  return head.startsWith(containerMagic);
+}
+
+
+QByteArray
+SceneContainer::
+write(std::vector<QJsonObject> const & nodes,
+      std::vector<QJsonObject> const & connections,
+      QJsonObject const & extra,
+      QRectF const & viewRect,
+      qreal cellSize)
+{
+  // Row major, so neighbouring cells end up close in the file
+  std::map<std::pair<qint64, qint64>, std::vector<std::size_t>> cells;
+
+  for (std::size_t i = 0; i < nodes.size(); ++i)
+  {
+    QJsonObject const position = nodes[i]["position"].toObject();
+
+    auto const row    = static_cast<qint64>(std::floor(position["y"].toDouble() / cellSize));
+    auto const column = static_cast<qint64>(std::floor(position["x"].toDouble() / cellSize));
+
+    cells[std::make_pair(row, column)].push_back(i);
+  }
+
+  QByteArray data = containerMagic;
+  data.append(QByteArray(headerSize - containerMagic.size(), '\0'));
+
+  QCborArray chunksIndex;
+
+  for (auto const & cell : cells)
+  {
+    qint64 const offset = data.size();
+
+    QCborArray ids;
+    QCborArray positions;
+
+    {
+      QCborStreamWriter writer(&data);
+
+      writer.startArray(cell.second.size());
+
+      for (std::size_t i : cell.second)
+      {
+        QJsonObject const & nodeJson = nodes[i];
+        QJsonObject const   position = nodeJson["position"].toObject();
+
+        writeCborItem(writer, nodeJson);
+
+        ids.append(QCborValue(QUuid(nodeJson["id"].toString())));
+        positions.append(position["x"].toDouble());
+        positions.append(position["y"].toDouble());
+      }
+
+      writer.endArray();
+    }
+
+    QCborMap chunkEntry = blockEntry(offset, data.size() - offset);
+    chunkEntry[QStringLiteral("ids")]       = ids;
+    chunkEntry[QStringLiteral("positions")] = positions;
+
+    chunksIndex.append(chunkEntry);
+  }
+
+  qint64 const connectionsOffset = data.size();
+
+  {
+    QCborStreamWriter writer(&data);
+
+    writer.startArray(connections.size());
+
+    for (QJsonObject const & connectionJson : connections)
+      writeCborItem(writer, connectionJson);
+
+    writer.endArray();
+  }
+
+  qint64 const extraOffset = data.size();
+
+  data.append(QCborValue::fromJsonValue(extra).toCbor());
+
+  QCborMap index;
+
+  index[QStringLiteral("cellSize")]    = cellSize;
+  index[QStringLiteral("chunks")]      = chunksIndex;
+  index[QStringLiteral("connections")] = blockEntry(connectionsOffset, extraOffset - connectionsOffset);
+  index[QStringLiteral("extra")]       = blockEntry(extraOffset, data.size() - extraOffset);
+
+  if (!viewRect.isNull())
+  {
+    index[QStringLiteral("viewRect")] =
+      QCborArray{ viewRect.x(), viewRect.y(), viewRect.width(), viewRect.height() };
+  }
+
+  qint64 const indexOffset = data.size();
+
+  data.append(QCborValue(index).toCbor());
+
+  qToLittleEndian<quint64>(indexOffset, data.data() + containerMagic.size());
+
+  return data;
+}
+
+
+//------------------------------------------------------------------------------
+
+bool
+SceneContainerReader::
+open(QString const & fileName)
+{
+  _file.setFileName(fileName);
+
+  if (!_file.open(QIODevice::ReadOnly))
+    return false;
+
+  _size  = _file.size();
+  _bytes = _file.map(0, _size);
+
+  // Not every file system maps
+  if (_bytes == nullptr)
+  {
+    _data  = _file.readAll();
+    _bytes = reinterpret_cast<uchar const *>(_data.constData());
+    _size  = _data.size();
+  }
+
+  return readIndex();
+}
+
+
+bool
+SceneContainerReader::
+open(QByteArray const & data)
+{
+  _data  = data;
+  _bytes = reinterpret_cast<uchar const *>(_data.constData());
+  _size  = _data.size();
+
+  return readIndex();
+}
+
+
+std::vector<QJsonObject>
+SceneContainerReader::
+readNodes(Chunk const & chunk) const
+{
+  std::vector<QJsonObject> nodes;
+  nodes.reserve(chunk.ids.size());
+
+  QCborStreamReader reader(block(chunk.offset, chunk.size));
+
+  if (!reader.isArray())
+    return nodes;
+
+  reader.enterContainer();
+
+  while (reader.hasNext() && reader.lastError() == QCborError::NoError)
+    nodes.push_back(readCborItem(QCborValue::fromCbor(reader).toMap()));
+
+  return nodes;
+}
+
+
+std::vector<QJsonObject>
+SceneContainerReader::
+readConnections() const
+{
+  std::vector<QJsonObject> connections;
+
+  QCborStreamReader reader(block(_connectionsOffset, _connectionsSize));
+
+  if (!reader.isArray())
+    return connections;
+
+  if (reader.isLengthKnown())
+    connections.reserve(reader.length());
+
+  reader.enterContainer();
+
+  while (reader.hasNext() && reader.lastError() == QCborError::NoError)
+    connections.push_back(readCborItem(QCborValue::fromCbor(reader).toMap()));
+
+  return connections;
+}
+
+
+QJsonObject
+SceneContainerReader::
+readExtra() const
+{
+  return QCborValue::fromCbor(block(_extraOffset, _extraSize)).toMap().toJsonObject();
+}
+
+
+bool
+SceneContainerReader::
+readIndex()
+{
+  _chunks.clear();
+
+  if (_size < headerSize ||
+      !QByteArray::fromRawData(reinterpret_cast<char const *>(_bytes), headerSize).startsWith(containerMagic))
+    return false;
+
+  auto const indexOffset =
+    static_cast<qint64>(qFromLittleEndian<quint64>(_bytes + containerMagic.size()));
+
+  if (indexOffset < headerSize || indexOffset >= _size)
+    return false;
+
+  QCborMap const index =
+    QCborValue::fromCbor(block(indexOffset, _size - indexOffset)).toMap();
+
+  QCborArray const viewRect = index[QStringLiteral("viewRect")].toArray();
+
+  if (viewRect.size() == 4)
+  {
+    _viewRect = QRectF(viewRect[0].toDouble(), viewRect[1].toDouble(),
+                       viewRect[2].toDouble(), viewRect[3].toDouble());
+  }
+
+  for (QCborValue const & value : index[QStringLiteral("chunks")].toArray())
+  {
+    QCborMap const chunkEntry = value.toMap();
+
+    Chunk chunk;
+    chunk.offset = chunkEntry[QStringLiteral("offset")].toInteger();
+    chunk.size   = chunkEntry[QStringLiteral("size")].toInteger();
+
+    for (QCborValue const & id : chunkEntry[QStringLiteral("ids")].toArray())
+      chunk.ids.push_back(id.toUuid());
+
+    QCborArray const positions = chunkEntry[QStringLiteral("positions")].toArray();
+
+    qreal left   = std::numeric_limits<qreal>::max();
+    qreal top    = std::numeric_limits<qreal>::max();
+    qreal right  = std::numeric_limits<qreal>::lowest();
+    qreal bottom = std::numeric_limits<qreal>::lowest();
+
+    for (qsizetype i = 0; i + 1 < positions.size(); i += 2)
+    {
+      left   = std::min(left,   positions[i].toDouble());
+      right  = std::max(right,  positions[i].toDouble());
+      top    = std::min(top,    positions[i + 1].toDouble());
+      bottom = std::max(bottom, positions[i + 1].toDouble());
+    }
+
+    if (left <= right)
+      chunk.bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+
+    _chunks.push_back(std::move(chunk));
+  }
+
+  QCborMap const connections = index[QStringLiteral("connections")].toMap();
+  _connectionsOffset = connections[QStringLiteral("offset")].toInteger();
+  _connectionsSize   = connections[QStringLiteral("size")].toInteger();
+
+  QCborMap const extra = index[QStringLiteral("extra")].toMap();
+  _extraOffset = extra[QStringLiteral("offset")].toInteger();
+  _extraSize   = extra[QStringLiteral("size")].toInteger();
+
+  return true;
+}
+
+
+QByteArray
+SceneContainerReader::
+block(qint64 offset, qint64 size) const
+{
+  if (offset < 0 || size < 0 || offset + size > _size)
+    return QByteArray();
+
+  return QByteArray::fromRawData(reinterpret_cast<char const *>(_bytes) + offset,
+                                 static_cast<int>(size));
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QJsonObject>
+#include <QtCore/QRectF>
+#include <QtCore/QUuid>
+
+class QCborMap;
+class QCborStreamWriter;
+
+namespace QtNodes
+{
+
+/// Writes a Node::save() or Connection::save() object as a CBOR map,
+/// with the ids as 16 byte UUIDs.
+void
+writeCborItem(QCborStreamWriter & writer, QJsonObject const & itemJson);
+
+/// Back to the JSON layout of Node::save() and Connection::save()
+QJsonObject
+readCborItem(QCborMap const & itemMap);
+
+
+/// Chunked scene file. Nodes are grouped by grid cell of their position,
+/// each cell in its own CBOR block, and an index at the end of the file
+/// records every chunk's offset, node ids and node positions:
+///
+///   "NEFLOWC1" | index offset (64 bit LE) | chunks | connections | extra | index
+///
+/// The connections and the entries added through FlowGraph::saving are
+/// blocks of their own.
+class SceneContainer
+{
+public:
+
+  static bool
+  isContainer(QByteArray const & head);
+
+  /// nodes and connections are in the Node::save()/Connection::save() layout
+  static QByteArray
+  write(std::vector<QJsonObject> const & nodes,
+        std::vector<QJsonObject> const & connections,
+        QJsonObject const & extra,
+        QRectF const & viewRect,
+        qreal cellSize = 2048.0);
+};
+
+
+/// Reads a SceneContainer from a memory mapped file, or from memory.
+/// Only the index is decoded up front.
+class SceneContainerReader
+{
+public:
+
+  struct Chunk
+  {
+    /// Bounds of the chunk's node positions
+    QRectF bounds;
+
+    qint64 offset = 0;
+    qint64 size   = 0;
+
+    std::vector<QUuid> ids;
+  };
+
+public:
+
+  bool
+  open(QString const & fileName);
+
+  bool
+  open(QByteArray const & data);
+
+  std::vector<Chunk> const &
+  chunks() const { return _chunks; }
+
+  /// Visible area of the first view at save time; null if there was none
+  QRectF
+  viewRect() const { return _viewRect; }
+
+  std::vector<QJsonObject>
+  readNodes(Chunk const & chunk) const;
+
+  std::vector<QJsonObject>
+  readConnections() const;
+
+  QJsonObject
+  readExtra() const;
+
+private:
+
+  bool
+  readIndex();
+
+  /// Wraps the mapped bytes without copying them
+  QByteArray
+  block(qint64 offset, qint64 size) const;
+
+private:
+
+  QFile      _file;
+  QByteArray _data;
+
+  uchar const * _bytes = nullptr;
+  qint64        _size  = 0;
+
+  std::vector<Chunk> _chunks;
+
+  QRectF _viewRect;
+
+  qint64 _connectionsOffset = 0;
+  qint64 _connectionsSize   = 0;
+  qint64 _extraOffset       = 0;
+  qint64 _extraSize         = 0;
+};
+}
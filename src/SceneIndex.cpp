@@ -0,0 +1,282 @@
+#include "SceneIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtGui/QTransform>
+
+#include "NodeGraphicsObject.hpp"
+#include "ConnectionGraphicsObject.hpp"
+#include "Connection.hpp"
+#include "ConnectionGeometry.hpp"
+
+using QtNodes::SceneIndex;
+using QtNodes::NodeGraphicsObject;
+using QtNodes::ConnectionGraphicsObject;
+using QtNodes::ConnectionGeometry;
+
+/// Every how many polyline points a stretch is filed, as in the hit-test
+/// shape
+static int const curveStride = 3;
+
+/// Half the width of the connection hit-test stroke
+static qreal const curveMargin = 5.0;
+
+
+SceneIndex::
+SceneIndex(qreal cellSize)
+  : _cellSize(cellSize)
+{}
+
+
+void
+SceneIndex::
+addNode(NodeGraphicsObject & node)
+{
+  _nodes.itemCells.emplace(&node, std::vector<CellKey>());
+  _nodes.dirty.insert(&node);
+}
+
+
+void
+SceneIndex::
+removeNode(NodeGraphicsObject & node)
+{
+  unfile(_nodes, &node);
+
+  _nodes.itemCells.erase(&node);
+  _nodes.dirty.erase(&node);
+}
+
+
+void
+SceneIndex::
+invalidateNode(NodeGraphicsObject & node)
+{
+  if (_nodes.itemCells.count(&node))
+    _nodes.dirty.insert(&node);
+}
+
+
+void
+SceneIndex::
+addConnection(ConnectionGraphicsObject & connection)
+{
+  _connections.itemCells.emplace(&connection, std::vector<CellKey>());
+  _connections.dirty.insert(&connection);
+}
+
+
+void
+SceneIndex::
+removeConnection(ConnectionGraphicsObject & connection)
+{
+  unfile(_connections, &connection);
+
+  _connections.itemCells.erase(&connection);
+  _connections.dirty.erase(&connection);
+}
+
+
+void
+SceneIndex::
+invalidateConnection(ConnectionGraphicsObject & connection)
+{
+  if (_connections.itemCells.count(&connection))
+    _connections.dirty.insert(&connection);
+}
+
+
+std::vector<NodeGraphicsObject*>
+SceneIndex::
+nodes(QRectF const & rect) const
+{
+  fileNodes();
+
+  std::vector<NodeGraphicsObject*> result = candidates(_nodes, cellRange(rect));
+
+  // Cells are coarser than the nodes
+  auto outside = [&](NodeGraphicsObject * node)
+  {
+    QRectF const nodeRect = node->sceneBoundingRect();
+
+    // A point query is an empty rect, which intersects nothing
+    return !nodeRect.intersects(rect) && !nodeRect.contains(rect.topLeft());
+  };
+
+  result.erase(std::remove_if(result.begin(), result.end(), outside),
+               result.end());
+
+  return result;
+}
+
+
+std::vector<ConnectionGraphicsObject*>
+SceneIndex::
+connections(QRectF const & rect) const
+{
+  fileConnections();
+
+  return candidates(_connections, cellRange(rect));
+}
+
+
+QRect
+SceneIndex::
+cellRange(QRectF const & rect) const
+{
+  QRectF const r = rect.normalized();
+
+  int const left   = static_cast<int>(std::floor(r.left() / _cellSize));
+  int const top    = static_cast<int>(std::floor(r.top() / _cellSize));
+  int const right  = static_cast<int>(std::floor(r.right() / _cellSize));
+  int const bottom = static_cast<int>(std::floor(r.bottom() / _cellSize));
+
+  return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+
+SceneIndex::CellKey
+SceneIndex::
+cellKey(int x, int y)
+{
+  return (static_cast<CellKey>(static_cast<quint32>(x)) << 32) |
+         static_cast<quint32>(y);
+}
+
+
+template <typename Item>
+void
+SceneIndex::
+unfile(Layer<Item> & layer, Item * item)
+{
+  auto it = layer.itemCells.find(item);
+
+  if (it == layer.itemCells.end())
+    return;
+
+  for (CellKey key : it->second)
+  {
+    auto cell = layer.cells.find(key);
+
+    if (cell == layer.cells.end())
+      continue;
+
+    std::vector<Item*> & items = cell->second;
+
+    auto pos = std::find(items.begin(), items.end(), item);
+
+    if (pos != items.end())
+    {
+      *pos = items.back();
+      items.pop_back();
+    }
+
+    if (items.empty())
+      layer.cells.erase(cell);
+  }
+
+  it->second.clear();
+}
+
+
+template <typename Item>
+std::vector<Item*>
+SceneIndex::
+candidates(Layer<Item> const & layer, QRect const & range)
+{
+  std::vector<Item*> result;
+
+  for (int x = range.left(); x <= range.right(); ++x)
+  {
+    for (int y = range.top(); y <= range.bottom(); ++y)
+    {
+      auto cell = layer.cells.find(cellKey(x, y));
+
+      if (cell != layer.cells.end())
+        result.insert(result.end(), cell->second.begin(), cell->second.end());
+    }
+  }
+
+  // Items spanning several cells are met once per cell
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+
+  return result;
+}
+
+
+void
+SceneIndex::
+fileNodes() const
+{
+  for (NodeGraphicsObject * node : _nodes.dirty)
+  {
+    unfile(_nodes, node);
+
+    std::vector<CellKey> & keys = _nodes.itemCells[node];
+
+    QRect const range = cellRange(node->sceneBoundingRect());
+
+    for (int x = range.left(); x <= range.right(); ++x)
+    {
+      for (int y = range.top(); y <= range.bottom(); ++y)
+      {
+        CellKey const key = cellKey(x, y);
+
+        _nodes.cells[key].push_back(node);
+        keys.push_back(key);
+      }
+    }
+  }
+
+  _nodes.dirty.clear();
+}
+
+
+void
+SceneIndex::
+fileConnections() const
+{
+  for (ConnectionGraphicsObject * connection : _connections.dirty)
+  {
+    unfile(_connections, connection);
+
+    std::vector<CellKey> & keys = _connections.itemCells[connection];
+
+    ConnectionGeometry const & geom = connection->connection().connectionGeometry();
+    QTransform const transform = connection->sceneTransform();
+
+    QPolygonF const & points = geom.polyline();
+
+    QPointF from = transform.map(points.front());
+
+    for (int i = curveStride; i < points.size(); i += curveStride)
+    {
+      QPointF const to = transform.map(points[i]);
+
+      QRectF const segment = QRectF(from, to).normalized()
+                             .adjusted(-curveMargin, -curveMargin,
+                                       curveMargin, curveMargin);
+
+      QRect const range = cellRange(segment);
+
+      for (int x = range.left(); x <= range.right(); ++x)
+      {
+        for (int y = range.top(); y <= range.bottom(); ++y)
+          keys.push_back(cellKey(x, y));
+      }
+
+      from = to;
+    }
+
+    // Neighbouring stretches mostly share their cells
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (CellKey key : keys)
+      _connections.cells[key].push_back(connection);
+  }
+
+  _connections.dirty.clear();
+}
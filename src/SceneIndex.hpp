@@ -0,0 +1,110 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QtCore/QRect>
+#include <QtCore/QRectF>
+
+namespace QtNodes
+{
+
+class NodeGraphicsObject;
+class ConnectionGraphicsObject;
+
+/// Uniform grid over the scene, answering the queries the scene makes
+/// itself: nodes under a point or a rect, connections near one.
+///
+/// Nodes and connections are kept in separate layers, so node queries
+/// never look at a connection. A connection is filed under the cells of
+/// short stretches of its curve, not of its bounding rect, which for a
+/// long diagonal is mostly empty cells.
+///
+/// Items only report that they changed; they are filed again on the next
+/// query, so dragging a node costs nothing until somebody asks.
+class SceneIndex
+{
+public:
+
+  explicit
+  SceneIndex(qreal cellSize = 256.0);
+
+public:
+
+  void
+  addNode(NodeGraphicsObject & node);
+
+  void
+  removeNode(NodeGraphicsObject & node);
+
+  /// The node moved or changed size
+  void
+  invalidateNode(NodeGraphicsObject & node);
+
+  void
+  addConnection(ConnectionGraphicsObject & connection);
+
+  void
+  removeConnection(ConnectionGraphicsObject & connection);
+
+  /// An end of the connection moved
+  void
+  invalidateConnection(ConnectionGraphicsObject & connection);
+
+public:
+
+  /// Nodes whose scene bounding rect intersects rect, in no order
+  std::vector<NodeGraphicsObject*>
+  nodes(QRectF const & rect) const;
+
+  /// Connections whose curve may pass through rect, in no order.
+  /// Callers wanting precision test the shape of each.
+  std::vector<ConnectionGraphicsObject*>
+  connections(QRectF const & rect) const;
+
+private:
+
+  using CellKey = quint64;
+
+  template <typename Item>
+  struct Layer
+  {
+    std::unordered_map<CellKey, std::vector<Item*>> cells;
+
+    /// The cells every item is filed under
+    std::unordered_map<Item*, std::vector<CellKey>> itemCells;
+
+    /// Changed since filed
+    std::unordered_set<Item*> dirty;
+  };
+
+  /// Cell coordinates covering rect, inclusive
+  QRect
+  cellRange(QRectF const & rect) const;
+
+  static CellKey
+  cellKey(int x, int y);
+
+  template <typename Item>
+  static void
+  unfile(Layer<Item> & layer, Item * item);
+
+  template <typename Item>
+  static std::vector<Item*>
+  candidates(Layer<Item> const & layer, QRect const & range);
+
+  void
+  fileNodes() const;
+
+  void
+  fileConnections() const;
+
+private:
+
+  qreal _cellSize;
+
+  mutable Layer<NodeGraphicsObject>       _nodes;
+  mutable Layer<ConnectionGraphicsObject> _connections;
+};
+}
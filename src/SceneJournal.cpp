@@ -0,0 +1,759 @@
+#include "SceneJournal.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QCborArray>
+#include <QtCore/QCborMap>
+#include <QtCore/QCborStreamWriter>
+#include <QtCore/QCborValue>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QMap>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTimer>
+#include <QtCore/QtEndian>
+
+#include "FlowGraph.hpp"
+#include "Connection.hpp"
+#include "Node.hpp"
+#include "NodeDataModel.hpp"
+#include "SceneContainer.hpp"
+
+using QtNodes::SceneJournal;
+
+// Record size (32 bit LE), then checksum (16 bit LE)
+static int const recordHeaderSize = 6;
+
+// GUI time a flush may spend saving nodes and models, the rest waits
+// for the next one
+static qint64 const flushSliceMs = 4;
+
+static
+QByteArray
+modelHash(QJsonObject const & modelJson)
+{
+  return QCryptographicHash::hash(QCborValue::fromJsonValue(modelJson).toCbor(),
+                                  QCryptographicHash::Sha1);
+}
+
+
+namespace
+{
+
+/// Scene state rebuilt from the snapshot and the journal, off the scene
+struct JournalState
+{
+  QMap<QUuid, QJsonObject> nodes;
+  QMap<QUuid, QJsonObject> connections;
+
+  /// The entries added through FlowGraph::saving
+  QJsonObject extra;
+
+  /// Last record folded in
+  quint64 sequence = 0;
+
+  /// Every item of the scene the journal started from has been recorded
+  bool seeded = true;
+
+  static JournalState
+  fromScene(QJsonObject const & sceneJson)
+  {
+    JournalState state;
+
+    for (auto it = sceneJson.begin(); it != sceneJson.end(); ++it)
+    {
+      if (it.key() == QLatin1String("nodes"))
+      {
+        for (QJsonValue const & node : it.value().toArray())
+          state.nodes.insert(QUuid(node.toObject()["id"].toString()), node.toObject());
+      }
+      else if (it.key() == QLatin1String("connections"))
+      {
+        for (QJsonValue const & connection : it.value().toArray())
+          state.connections.insert(QUuid(connection.toObject()["id"].toString()),
+                                   connection.toObject());
+      }
+      else
+      {
+        state.extra[it.key()] = it.value();
+      }
+    }
+
+    return state;
+  }
+
+  QJsonObject
+  toScene() const
+  {
+    QJsonObject sceneJson = extra;
+
+    QJsonArray nodesJson;
+
+    for (QJsonObject const & node : nodes)
+      nodesJson.append(node);
+
+    QJsonArray connectionsJson;
+
+    for (QJsonObject const & connection : connections)
+      connectionsJson.append(connection);
+
+    sceneJson["nodes"]       = nodesJson;
+    sceneJson["connections"] = connectionsJson;
+
+    return sceneJson;
+  }
+
+  /// The snapshot is a CBOR scene file with the sequence as an extra entry
+  bool
+  read(QString const & snapshotPath)
+  {
+    QFile file(snapshotPath);
+
+    if (!file.open(QIODevice::ReadOnly))
+      return false;
+
+    QCborValue document = QCborValue::fromCbor(file.readAll());
+
+    if (document.isTag())
+      document = document.taggedValue();
+
+    if (!document.isMap())
+      return false;
+
+    QCborMap const sceneMap = document.toMap();
+
+    for (auto it = sceneMap.begin(); it != sceneMap.end(); ++it)
+    {
+      QString const key = it.key().toString();
+
+      if (key == QLatin1String("nodes"))
+      {
+        for (QCborValue const & node : it.value().toArray())
+        {
+          QJsonObject const nodeJson = QtNodes::readCborItem(node.toMap());
+          nodes.insert(QUuid(nodeJson["id"].toString()), nodeJson);
+        }
+      }
+      else if (key == QLatin1String("connections"))
+      {
+        for (QCborValue const & connection : it.value().toArray())
+        {
+          QJsonObject const connectionJson = QtNodes::readCborItem(connection.toMap());
+          connections.insert(QUuid(connectionJson["id"].toString()), connectionJson);
+        }
+      }
+      else if (key == QLatin1String("journalSequence"))
+      {
+        sequence = static_cast<quint64>(it.value().toInteger());
+      }
+      else if (key == QLatin1String("journalSeeded"))
+      {
+        seeded = it.value().toBool();
+      }
+      else
+      {
+        extra[key] = it.value().toJsonValue();
+      }
+    }
+
+    return true;
+  }
+
+  /// Replaces the snapshot atomically
+  bool
+  write(QString const & snapshotPath) const
+  {
+    QSaveFile file(snapshotPath);
+
+    if (!file.open(QIODevice::WriteOnly))
+      return false;
+
+    QCborStreamWriter writer(&file);
+
+    writer.append(QCborKnownTags::Signature);
+    writer.startMap();
+
+    writer.append(QLatin1String("nodes"));
+    writer.startArray(nodes.size());
+
+    for (QJsonObject const & node : nodes)
+      QtNodes::writeCborItem(writer, node);
+
+    writer.endArray();
+
+    writer.append(QLatin1String("connections"));
+    writer.startArray(connections.size());
+
+    for (QJsonObject const & connection : connections)
+      QtNodes::writeCborItem(writer, connection);
+
+    writer.endArray();
+
+    for (auto it = extra.begin(); it != extra.end(); ++it)
+    {
+      writer.append(it.key());
+      QCborValue::fromJsonValue(it.value()).toCbor(writer);
+    }
+
+    writer.append(QLatin1String("journalSequence"));
+    writer.append(sequence);
+
+    writer.append(QLatin1String("journalSeeded"));
+    writer.append(seeded);
+
+    writer.endMap();
+
+    return file.commit();
+  }
+
+  /// Folds in the records of a segment newer than the state
+  void
+  replay(QString const & segmentPath)
+  {
+    QFile file(segmentPath);
+
+    if (!file.open(QIODevice::ReadOnly))
+      return;
+
+    QByteArray const data = file.readAll();
+
+    int position = 0;
+
+    while (position + recordHeaderSize <= data.size())
+    {
+      auto const header = reinterpret_cast<uchar const *>(data.constData() + position);
+
+      auto const size     = qFromLittleEndian<quint32>(header);
+      auto const checksum = qFromLittleEndian<quint16>(header + 4);
+
+      if (size > static_cast<quint32>(data.size() - position - recordHeaderSize))
+        break;
+
+      char const * payload = data.constData() + position + recordHeaderSize;
+
+      // Torn by a crash
+      if (qChecksum(payload, size) != checksum)
+        break;
+
+      position += recordHeaderSize + static_cast<int>(size);
+
+      QCborMap const record =
+        QCborValue::fromCbor(QByteArray::fromRawData(payload, static_cast<int>(size))).toMap();
+
+      auto const recordSequence =
+        static_cast<quint64>(record[QStringLiteral("seq")].toInteger());
+
+      // Already in the snapshot
+      if (recordSequence <= sequence)
+        continue;
+
+      apply(record);
+
+      sequence = recordSequence;
+    }
+  }
+
+  void
+  apply(QCborMap const & record)
+  {
+    QString const op = record[QStringLiteral("op")].toString();
+    QUuid const   id = record[QStringLiteral("id")].toUuid();
+
+    if (op == QLatin1String("nodeAdded"))
+    {
+      QJsonObject const nodeJson = record[QStringLiteral("item")].toMap().toJsonObject();
+      nodes.insert(QUuid(nodeJson["id"].toString()), nodeJson);
+    }
+    else if (op == QLatin1String("nodeRemoved"))
+    {
+      nodes.remove(id);
+
+      QString const idString = id.toString();
+
+      for (auto it = connections.begin(); it != connections.end();)
+      {
+        if (it.value()["in_id"].toString() == idString ||
+            it.value()["out_id"].toString() == idString)
+          it = connections.erase(it);
+        else
+          ++it;
+      }
+    }
+    else if (op == QLatin1String("nodeMoved"))
+    {
+      auto it = nodes.find(id);
+
+      if (it != nodes.end())
+      {
+        QJsonObject positionJson;
+        positionJson["x"] = record[QStringLiteral("x")].toDouble();
+        positionJson["y"] = record[QStringLiteral("y")].toDouble();
+
+        it.value()["position"] = positionJson;
+      }
+    }
+    else if (op == QLatin1String("modelChanged"))
+    {
+      auto it = nodes.find(id);
+
+      if (it != nodes.end())
+        it.value()["model"] = record[QStringLiteral("model")].toMap().toJsonObject();
+    }
+    else if (op == QLatin1String("connectionAdded"))
+    {
+      QJsonObject const connectionJson = record[QStringLiteral("item")].toMap().toJsonObject();
+      connections.insert(QUuid(connectionJson["id"].toString()), connectionJson);
+    }
+    else if (op == QLatin1String("connectionRemoved"))
+    {
+      connections.remove(id);
+    }
+    else if (op == QLatin1String("seeded"))
+    {
+      seeded = true;
+    }
+  }
+};
+}
+
+
+//------------------------------------------------------------------------------
+
+SceneJournal::
+SceneJournal(FlowGraph & graph, QString snapshotPath)
+  : _graph(graph)
+  , _snapshotPath(std::move(snapshotPath))
+  , _segmentNumber(0)
+  , _sequence(0)
+  , _flushScheduled(false)
+  , _seeding(false)
+  , _compactionThreshold(8 * 1024 * 1024)
+{}
+
+
+SceneJournal::
+~SceneJournal()
+{
+  writeOut();
+
+  _segment.close();
+
+  waitForCompaction();
+}
+
+
+bool
+SceneJournal::
+start(QJsonObject const & extraJson,
+      std::vector<QUuid> nodeIds,
+      std::vector<QUuid> connectionIds)
+{
+  waitForCompaction();
+
+  // Left over from an earlier journal
+  for (quint64 number : segmentNumbers())
+    QFile::remove(segmentPath(number));
+
+  QFile::remove(_snapshotPath);
+
+  // The items come as records, a few per flush
+  JournalState base = JournalState::fromScene(extraJson);
+  base.seeded = false;
+
+  _modelHashes.clear();
+  _changedModels.clear();
+
+  _seedNodes       = std::move(nodeIds);
+  _seedConnections = std::move(connectionIds);
+  _seeding         = true;
+
+  _sequence = 0;
+
+  if (!openSegment(1))
+    return false;
+
+  scheduleFlush();
+
+  QString const snapshotPath = _snapshotPath;
+
+  _compaction = QtConcurrent::run([snapshotPath, base]()
+  {
+    return base.write(snapshotPath);
+  });
+
+  return true;
+}
+
+
+bool
+SceneJournal::
+resume(QJsonObject & sceneJson)
+{
+  waitForCompaction();
+
+  JournalState state;
+
+  if (!state.read(_snapshotPath))
+    return false;
+
+  std::vector<quint64> const numbers = segmentNumbers();
+
+  for (quint64 number : numbers)
+    state.replay(segmentPath(number));
+
+  // Stopped before the whole scene was recorded
+  if (!state.seeded)
+    return false;
+
+  sceneJson = state.toScene();
+
+  _sequence = state.sequence;
+
+  _modelHashes.clear();
+
+  for (auto it = state.nodes.begin(); it != state.nodes.end(); ++it)
+    _modelHashes[it.key()] = modelHash(it.value()["model"].toObject());
+
+  return openSegment(numbers.empty() ? 1 : numbers.back() + 1);
+}
+
+
+void
+SceneJournal::
+nodeAdded(QJsonObject const & nodeJson)
+{
+  QCborMap record;
+  record[QStringLiteral("op")]   = QStringLiteral("nodeAdded");
+  record[QStringLiteral("item")] = QCborValue::fromJsonValue(nodeJson);
+
+  append(std::move(record));
+
+  QUuid const id(nodeJson["id"].toString());
+
+  _modelHashes[id] = modelHash(nodeJson["model"].toObject());
+}
+
+
+void
+SceneJournal::
+nodeRemoved(QUuid const & id)
+{
+  QCborMap record;
+  record[QStringLiteral("op")] = QStringLiteral("nodeRemoved");
+  record[QStringLiteral("id")] = QCborValue(id);
+
+  append(std::move(record));
+
+  _modelHashes.erase(id);
+  _changedModels.erase(id);
+}
+
+
+void
+SceneJournal::
+nodeMoved(QUuid const & id, QPointF const & position)
+{
+  QCborMap record;
+  record[QStringLiteral("op")] = QStringLiteral("nodeMoved");
+  record[QStringLiteral("id")] = QCborValue(id);
+  record[QStringLiteral("x")]  = position.x();
+  record[QStringLiteral("y")]  = position.y();
+
+  append(std::move(record));
+}
+
+
+void
+SceneJournal::
+connectionAdded(QJsonObject const & connectionJson)
+{
+  QCborMap record;
+  record[QStringLiteral("op")]   = QStringLiteral("connectionAdded");
+  record[QStringLiteral("item")] = QCborValue::fromJsonValue(connectionJson);
+
+  append(std::move(record));
+}
+
+
+void
+SceneJournal::
+connectionRemoved(QUuid const & id)
+{
+  QCborMap record;
+  record[QStringLiteral("op")] = QStringLiteral("connectionRemoved");
+  record[QStringLiteral("id")] = QCborValue(id);
+
+  append(std::move(record));
+}
+
+
+void
+SceneJournal::
+modelChanged(QUuid const & id)
+{
+  _changedModels.insert(id);
+
+  scheduleFlush();
+}
+
+
+void
+SceneJournal::
+compact()
+{
+  if (_compaction.isRunning())
+    return;
+
+  writeOut();
+
+  std::vector<QString> sealed;
+
+  for (quint64 number : segmentNumbers())
+  {
+    if (number <= _segmentNumber)
+      sealed.push_back(segmentPath(number));
+  }
+
+  if (!openSegment(_segmentNumber + 1))
+    return;
+
+  QString const snapshotPath = _snapshotPath;
+
+  _compaction = QtConcurrent::run([snapshotPath, sealed]()
+  {
+    JournalState state;
+
+    if (!state.read(snapshotPath))
+      return false;
+
+    for (QString const & segment : sealed)
+      state.replay(segment);
+
+    if (!state.write(snapshotPath))
+      return false;
+
+    // Only once the snapshot holds their records
+    for (QString const & segment : sealed)
+      QFile::remove(segment);
+
+    return true;
+  });
+}
+
+
+void
+SceneJournal::
+setCompactionThreshold(qint64 bytes)
+{
+  _compactionThreshold = bytes;
+}
+
+
+void
+SceneJournal::
+waitForCompaction()
+{
+  _compaction.waitForFinished();
+}
+
+
+void
+SceneJournal::
+append(QCborMap record)
+{
+  record[QStringLiteral("seq")] = static_cast<qint64>(++_sequence);
+
+  QByteArray const payload = record.toCborValue().toCbor();
+
+  char header[recordHeaderSize];
+  qToLittleEndian<quint32>(payload.size(), header);
+  qToLittleEndian<quint16>(qChecksum(payload.constData(), payload.size()), header + 4);
+
+  _segment.write(header, recordHeaderSize);
+  _segment.write(payload);
+
+  scheduleFlush();
+}
+
+
+void
+SceneJournal::
+scheduleFlush()
+{
+  if (_flushScheduled)
+    return;
+
+  _flushScheduled = true;
+
+  QTimer::singleShot(0, this, [this]() { flush(); });
+}
+
+
+void
+SceneJournal::
+flush()
+{
+  QDeadlineTimer const deadline(flushSliceMs);
+
+  bool const done = seed(deadline) && saveChangedModels(deadline);
+
+  _segment.flush();
+
+  _flushScheduled = false;
+
+  if (!done)
+    scheduleFlush();
+
+  if (_compactionThreshold > 0 && _segment.size() >= _compactionThreshold)
+    compact();
+}
+
+
+void
+SceneJournal::
+writeOut()
+{
+  // An unfinished seeding is left, such a journal is never resumed
+  saveChangedModels(QDeadlineTimer(QDeadlineTimer::Forever));
+
+  // To the OS, which keeps it through a crash of the process
+  _segment.flush();
+}
+
+
+bool
+SceneJournal::
+seed(QDeadlineTimer const & deadline)
+{
+  if (!_seeding)
+    return true;
+
+  // Items removed since start() were journaled as removed, items changed
+  // meanwhile are recorded as they are now
+  while (!_seedNodes.empty())
+  {
+    if (deadline.hasExpired())
+      return false;
+
+    QUuid const id = _seedNodes.back();
+    _seedNodes.pop_back();
+
+    if (Node * node = _graph.node(id))
+      nodeAdded(node->save());
+  }
+
+  while (!_seedConnections.empty())
+  {
+    if (deadline.hasExpired())
+      return false;
+
+    QUuid const id = _seedConnections.back();
+    _seedConnections.pop_back();
+
+    if (Connection * connection = _graph.connection(id))
+    {
+      QJsonObject const connectionJson = connection->save();
+
+      if (!connectionJson.isEmpty())
+        connectionAdded(connectionJson);
+    }
+  }
+
+  _seeding = false;
+
+  QCborMap record;
+  record[QStringLiteral("op")] = QStringLiteral("seeded");
+
+  append(std::move(record));
+
+  return true;
+}
+
+
+bool
+SceneJournal::
+saveChangedModels(QDeadlineTimer const & deadline)
+{
+  while (!_changedModels.empty())
+  {
+    if (deadline.hasExpired())
+      return false;
+
+    QUuid const id = *_changedModels.begin();
+    _changedModels.erase(_changedModels.begin());
+
+    Node * node = _graph.node(id);
+
+    if (!node)
+      continue;
+
+    QJsonObject const modelJson = node->nodeDataModel()->save();
+    QByteArray const  hash      = modelHash(modelJson);
+
+    QByteArray & lastHash = _modelHashes[id];
+
+    if (lastHash == hash)
+      continue;
+
+    lastHash = hash;
+
+    QCborMap record;
+    record[QStringLiteral("op")]    = QStringLiteral("modelChanged");
+    record[QStringLiteral("id")]    = QCborValue(id);
+    record[QStringLiteral("model")] = QCborValue::fromJsonValue(modelJson);
+
+    append(std::move(record));
+  }
+
+  return true;
+}
+
+
+bool
+SceneJournal::
+openSegment(quint64 number)
+{
+  _segment.close();
+  _segment.setFileName(segmentPath(number));
+
+  _segmentNumber = number;
+
+  return _segment.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+
+QString
+SceneJournal::
+segmentPath(quint64 number) const
+{
+  return _snapshotPath + QStringLiteral(".journal.") + QString::number(number);
+}
+
+
+std::vector<quint64>
+SceneJournal::
+segmentNumbers() const
+{
+  QFileInfo const info(_snapshotPath);
+  QString const   prefix = info.fileName() + QStringLiteral(".journal.");
+
+  std::vector<quint64> numbers;
+
+  for (QString const & name : info.absoluteDir().entryList({ prefix + QLatin1Char('*') }, QDir::Files))
+  {
+    bool ok = false;
+    quint64 const number = name.mid(prefix.size()).toULongLong(&ok);
+
+    if (ok)
+      numbers.push_back(number);
+  }
+
+  std::sort(numbers.begin(), numbers.end());
+
+  return numbers;
+}
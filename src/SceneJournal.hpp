@@ -0,0 +1,157 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QFuture>
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtCore/QPointF>
+#include <QtCore/QUuid>
+
+#include "QUuidStdHash.hpp"
+
+class QCborMap;
+class QDeadlineTimer;
+
+namespace QtNodes
+{
+
+class FlowGraph;
+
+/// Append-only record of the changes made through the undo commands, for
+/// crash recovery. Next to the snapshot file the records go to numbered
+/// segments, "<snapshot>.journal.<n>". Compaction seals the current
+/// segment and folds the sealed ones into a new snapshot on a worker
+/// thread; the scene itself is never serialized for it.
+///
+/// Every record is framed by its size and a checksum, so a record torn
+/// by a crash ends the replay instead of corrupting it.
+///
+/// Nothing saves the whole scene on the GUI thread: the items present at
+/// start() are recorded a few at a time, and a flush spends at most a
+/// few milliseconds saving changed models, leaving the rest for the next.
+class SceneJournal
+  : public QObject
+{
+public:
+
+  SceneJournal(FlowGraph & graph, QString snapshotPath);
+
+  /// Writes out the pending records and waits for a running compaction
+  ~SceneJournal() override;
+
+public:
+
+  /// Starts over with a snapshot of the scene file entries other than the
+  /// items, written on a worker thread. The given nodes and connections
+  /// are then recorded from the event loop, in slices.
+  bool
+  start(QJsonObject const & extraJson,
+        std::vector<QUuid> nodeIds,
+        std::vector<QUuid> connectionIds);
+
+  /// Rebuilds the last journaled state into sceneJson and appends to a
+  /// new segment from there. False without a snapshot, or if the journal
+  /// stopped before start() had recorded every item.
+  bool
+  resume(QJsonObject & sceneJson);
+
+  void
+  nodeAdded(QJsonObject const & nodeJson);
+
+  void
+  nodeRemoved(QUuid const & id);
+
+  void
+  nodeMoved(QUuid const & id, QPointF const & position);
+
+  void
+  connectionAdded(QJsonObject const & connectionJson);
+
+  void
+  connectionRemoved(QUuid const & id);
+
+  /// The model is saved when the records are written out, and journaled
+  /// only if its state differs from the last one journaled
+  void
+  modelChanged(QUuid const & id);
+
+  /// Seals the current segment and folds it into the snapshot. Does
+  /// nothing while a compaction is running.
+  void
+  compact();
+
+  /// Segment size past which compact() runs by itself
+  void
+  setCompactionThreshold(qint64 bytes);
+
+  void
+  waitForCompaction();
+
+private:
+
+  void
+  append(QCborMap record);
+
+  void
+  scheduleFlush();
+
+  void
+  flush();
+
+  /// Saves the changed models and hands the records to the OS
+  void
+  writeOut();
+
+  /// Records items left from start() until the deadline. True once all
+  /// are recorded.
+  bool
+  seed(QDeadlineTimer const & deadline);
+
+  /// True once no changed model is left
+  bool
+  saveChangedModels(QDeadlineTimer const & deadline);
+
+  bool
+  openSegment(quint64 number);
+
+  QString
+  segmentPath(quint64 number) const;
+
+  /// Numbers of the segments on disk, in order
+  std::vector<quint64>
+  segmentNumbers() const;
+
+private:
+
+  FlowGraph & _graph;
+
+  QString _snapshotPath;
+
+  QFile   _segment;
+  quint64 _segmentNumber;
+
+  quint64 _sequence;
+
+  bool _flushScheduled;
+
+  std::unordered_set<QUuid> _changedModels;
+
+  /// Items of the scene at start() not recorded yet
+  std::vector<QUuid> _seedNodes;
+  std::vector<QUuid> _seedConnections;
+
+  bool _seeding;
+
+  /// Hash of the last journaled state of every model
+  std::unordered_map<QUuid, QByteArray> _modelHashes;
+
+  QFuture<bool> _compaction;
+
+  qint64 _compactionThreshold;
+};
+}
@@ -0,0 +1,383 @@
+#include "SceneTiles.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <QtWidgets/QGraphicsScene>
+
+#include "memory.hpp"
+
+using QtNodes::SceneTiles;
+using QtNodes::SceneTile;
+
+/// A tile grows by whole steps, so a node dragged out of its tile does
+/// not grow it on every mouse move, and a node measured again while
+/// painting, with the view's font, still fits
+static qreal const growthStep = 128.0;
+
+
+namespace QtNodes
+{
+
+/// Draws nothing, but has contents: Qt tests the bounding rect of an item
+/// with contents, and skips the items it contains when that misses
+class SceneTile
+  : public QGraphicsItem
+{
+public:
+
+  enum { Type = UserType + 0x4e54 };
+
+  SceneTile(QGraphicsScene & scene, qreal z, quint64 order)
+    : order(order)
+  {
+    setFlag(QGraphicsItem::ItemContainsChildrenInShape, true);
+    setAcceptedMouseButtons(Qt::NoButton);
+    setZValue(z);
+
+    scene.addItem(this);
+  }
+
+  int
+  type() const override
+  {
+    return Type;
+  }
+
+  QRectF
+  boundingRect() const override
+  {
+    return _rect;
+  }
+
+  void
+  paint(QPainter*, QStyleOptionGraphicsItem const*, QWidget*) override
+  {}
+
+  /// Grows to hold rect; false if it did already
+  bool
+  include(QRectF const & rect)
+  {
+    if (rect.isEmpty() || _rect.contains(rect))
+      return false;
+
+    QRectF const united = _rect.isNull() ? rect : _rect.united(rect);
+
+    auto down = [](qreal v) { return std::floor(v / growthStep) * growthStep; };
+    auto up   = [](qreal v) { return std::ceil(v / growthStep) * growthStep; };
+
+    prepareGeometryChange();
+
+    _rect = QRectF(QPointF(down(united.left()), down(united.top())),
+                   QPointF(up(united.right()), up(united.bottom())));
+
+    return true;
+  }
+
+  /// When the tile was added to the scene, which stacks tiles of equal z
+  /// by it
+  quint64 const order;
+
+  /// Items filed under the tile
+  std::size_t count = 0;
+
+private:
+
+  QRectF _rect;
+};
+}
+
+
+SceneTiles::
+SceneTiles(QGraphicsScene & scene, qreal tileSize)
+  : _scene(scene)
+  , _tileSize(tileSize)
+{}
+
+
+SceneTiles::
+~SceneTiles()
+{
+  // A tile deletes its children, which belong to their nodes and
+  // connections
+  for (auto & layer : _tiles)
+  {
+    for (auto & tile : layer)
+    {
+      for (QGraphicsItem * item : tile.second->childItems())
+        item->setParentItem(nullptr);
+    }
+  }
+}
+
+
+void
+SceneTiles::
+file(QGraphicsItem & item, Layer layer)
+{
+  Q_ASSERT(_filings.count(&item) == 0);
+
+  QRectF const rect = itemRect(item);
+  TileKey const key = tileKey(rect);
+
+  SceneTile & tile = tileAt(layer, key);
+
+  // Filed before reparenting, which may notify a move
+  _filings.emplace(&item, Filing{ layer, key, &tile, _nextOrder++ });
+
+  ++tile.count;
+  item.setParentItem(&tile);
+
+  if (tile.include(rect))
+    grown(layer, tile);
+
+  if (item.zValue() > tile.zValue())
+    tile.setZValue(item.zValue());
+}
+
+
+void
+SceneTiles::
+remove(QGraphicsItem & item)
+{
+  auto it = _filings.find(&item);
+
+  if (it == _filings.end())
+  {
+    if (item.scene() == &_scene)
+      _scene.removeItem(&item);
+
+    return;
+  }
+
+  Filing const filing = it->second;
+  _filings.erase(it);
+
+  --filing.tile->count;
+
+  // Leaves the tile without becoming a top-level item first
+  if (item.scene() == &_scene)
+    _scene.removeItem(&item);
+
+  release(filing.layer, filing.key);
+}
+
+
+void
+SceneTiles::
+refile(QGraphicsItem & item)
+{
+  auto it = _filings.find(&item);
+
+  if (it == _filings.end())
+    return;
+
+  Filing & filing = it->second;
+
+  QRectF const rect = itemRect(item);
+  TileKey const key = tileKey(rect);
+
+  if (key != filing.key)
+  {
+    SceneTile & tile = tileAt(filing.layer, key);
+
+    SceneTile * const oldTile = filing.tile;
+    TileKey const oldKey = filing.key;
+
+    // Up to date before reparenting, which may notify a move again
+    filing.key   = key;
+    filing.tile  = &tile;
+    filing.order = _nextOrder++;
+
+    --oldTile->count;
+    ++tile.count;
+
+    item.setParentItem(&tile);
+
+    stack(*oldTile);
+    release(filing.layer, oldKey);
+
+    if (item.zValue() > tile.zValue())
+      tile.setZValue(item.zValue());
+  }
+
+  if (filing.tile->include(rect))
+    grown(filing.layer, *filing.tile);
+}
+
+
+void
+SceneTiles::
+restack(QGraphicsItem & item)
+{
+  auto it = _filings.find(&item);
+
+  if (it != _filings.end())
+    stack(*it->second.tile);
+}
+
+
+bool
+SceneTiles::
+drawnAbove(QGraphicsItem const & a, QGraphicsItem const & b) const
+{
+  auto const fa = _filings.find(&a);
+  auto const fb = _filings.find(&b);
+
+  if (fa == _filings.end() || fb == _filings.end())
+    return a.zValue() > b.zValue();
+
+  SceneTile const & ta = *fa->second.tile;
+  SceneTile const & tb = *fb->second.tile;
+
+  // Qt stacks the tiles, then the items within each
+  if (&ta != &tb)
+  {
+    if (ta.zValue() != tb.zValue())
+      return ta.zValue() > tb.zValue();
+
+    return ta.order > tb.order;
+  }
+
+  if (a.zValue() != b.zValue())
+    return a.zValue() > b.zValue();
+
+  return fa->second.order > fb->second.order;
+}
+
+
+QRectF
+SceneTiles::
+bounds(Layer layer) const
+{
+  return _bounds[static_cast<int>(layer)];
+}
+
+
+void
+SceneTiles::
+setBoundsChanged(Layer layer, std::function<void()> callback)
+{
+  _boundsChanged[static_cast<int>(layer)] = std::move(callback);
+}
+
+
+bool
+SceneTiles::
+isTile(QGraphicsItem const & item)
+{
+  return item.type() == SceneTile::Type;
+}
+
+
+SceneTiles::TileKey
+SceneTiles::
+tileKey(QRectF const & itemRect) const
+{
+  QPointF const center = itemRect.center();
+
+  int const x = static_cast<int>(std::floor(center.x() / _tileSize));
+  int const y = static_cast<int>(std::floor(center.y() / _tileSize));
+
+  return (static_cast<TileKey>(static_cast<quint32>(x)) << 32) |
+         static_cast<quint32>(y);
+}
+
+
+SceneTile &
+SceneTiles::
+tileAt(Layer layer, TileKey key)
+{
+  auto & tiles = _tiles[static_cast<int>(layer)];
+
+  std::unique_ptr<SceneTile> & tile = tiles[key];
+
+  if (!tile)
+  {
+    qreal const z = (layer == Layer::Connections) ? -1.0 : 0.0;
+
+    tile = detail::make_unique<SceneTile>(_scene, z, _nextOrder++);
+  }
+
+  return *tile;
+}
+
+
+void
+SceneTiles::
+release(Layer layer, TileKey key)
+{
+  auto & tiles = _tiles[static_cast<int>(layer)];
+
+  auto it = tiles.find(key);
+
+  if (it == tiles.end() || it->second->count > 0)
+    return;
+
+  tiles.erase(it);
+
+  // The only way the layer shrinks
+  QRectF bounds;
+
+  for (auto const & tile : tiles)
+    bounds |= tile.second->boundingRect();
+
+  int const index = static_cast<int>(layer);
+
+  if (bounds != _bounds[index])
+  {
+    _bounds[index] = bounds;
+
+    if (_boundsChanged[index])
+      _boundsChanged[index]();
+  }
+}
+
+
+void
+SceneTiles::
+grown(Layer layer, SceneTile const & tile)
+{
+  int const index = static_cast<int>(layer);
+
+  QRectF const bounds = _bounds[index] | tile.boundingRect();
+
+  if (bounds != _bounds[index])
+  {
+    _bounds[index] = bounds;
+
+    if (_boundsChanged[index])
+      _boundsChanged[index]();
+  }
+}
+
+
+void
+SceneTiles::
+stack(SceneTile & tile)
+{
+  QList<QGraphicsItem*> const items = tile.childItems();
+
+  if (items.isEmpty())
+    return;
+
+  qreal z = std::numeric_limits<qreal>::lowest();
+
+  for (QGraphicsItem * item : items)
+    z = std::max(z, item->zValue());
+
+  if (z != tile.zValue())
+    tile.setZValue(z);
+}
+
+
+QRectF
+SceneTiles::
+itemRect(QGraphicsItem const & item)
+{
+  // Tiles are at the origin, the parent's coordinates are the scene's.
+  // Embedded widgets are children of their node.
+  return item.mapRectToParent(item.boundingRect() | item.childrenBoundingRect());
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include <QtWidgets/QGraphicsItem>
+
+class QGraphicsScene;
+
+namespace QtNodes
+{
+
+class SceneTile;
+
+/// Files the node and connection graphics under coarse tile items, so
+/// that Qt's own traversals -- hit tests, hover, painting -- skip whole
+/// tiles away from the point or the exposed rect instead of testing
+/// every item. The scene stays on QGraphicsScene::NoIndex.
+///
+/// Tiles sit at the scene origin, so an item's position in its tile is
+/// its scene position. A tile bounds its items: it grows as they move or
+/// resize, and goes with its last item. Connections have tiles of their
+/// own, stacked below the nodes' ones.
+class SceneTiles
+{
+public:
+
+  enum class Layer
+  {
+    Connections,
+    Nodes
+  };
+
+  explicit
+  SceneTiles(QGraphicsScene & scene, qreal tileSize = 2048.0);
+
+  ~SceneTiles();
+
+public:
+
+  /// Moves an item of the scene under the tile of its position
+  void
+  file(QGraphicsItem & item, Layer layer);
+
+  /// Takes the item out of its tile and out of the scene
+  void
+  remove(QGraphicsItem & item);
+
+  /// The item moved or changed size: it changes tiles, or its tile grows
+  void
+  refile(QGraphicsItem & item);
+
+  /// The item's z changed. A tile is stacked at the highest z of its
+  /// items, so a raised node is drawn over its neighbours' tiles too.
+  void
+  restack(QGraphicsItem & item);
+
+  /// Whether a is drawn over b, as Qt stacks them through their tiles
+  bool
+  drawnAbove(QGraphicsItem const & a, QGraphicsItem const & b) const;
+
+  /// Scene rect of the layer's tiles, which hold its items; null without
+  /// any
+  QRectF
+  bounds(Layer layer) const;
+
+  /// Called after bounds(layer) changed
+  void
+  setBoundsChanged(Layer layer, std::function<void()> callback);
+
+  static bool
+  isTile(QGraphicsItem const & item);
+
+private:
+
+  using TileKey = quint64;
+
+  struct Filing
+  {
+    Layer       layer;
+    TileKey     key;
+    SceneTile * tile;
+
+    /// Order of filing into the tile, which is how Qt stacks the tile's
+    /// items of equal z
+    quint64 order;
+  };
+
+  TileKey
+  tileKey(QRectF const & itemRect) const;
+
+  SceneTile &
+  tileAt(Layer layer, TileKey key);
+
+  /// Deletes the tile if its last item left
+  void
+  release(Layer layer, TileKey key);
+
+  /// The tile grew
+  void
+  grown(Layer layer, SceneTile const & tile);
+
+  /// At the highest z of its items
+  static void
+  stack(SceneTile & tile);
+
+  static QRectF
+  itemRect(QGraphicsItem const & item);
+
+private:
+
+  QGraphicsScene & _scene;
+
+  qreal _tileSize;
+
+  std::unordered_map<TileKey, std::unique_ptr<SceneTile>> _tiles[2];
+
+  QRectF _bounds[2];
+
+  std::function<void()> _boundsChanged[2];
+
+  std::unordered_map<QGraphicsItem const*, Filing> _filings;
+
+  quint64 _nextOrder = 0;
+};
+}
@@ -0,0 +1,465 @@
+#include "TopologicalScheduler.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using QtNodes::TopologicalScheduler;
+using QtNodes::Node;
+
+static
+void
+eraseOne(std::vector<unsigned int> & slots, unsigned int slot)
+{
+  auto it = std::find(slots.begin(), slots.end(), slot);
+
+  if (it != slots.end())
+  {
+    *it = slots.back();
+    slots.pop_back();
+  }
+}
+
+
+TopologicalScheduler::
+TopologicalScheduler()
+  : _cyclic(false)
+  , _cacheValid(false)
+  , _epoch(0)
+{}
+
+
+void
+TopologicalScheduler::
+addNode(Node& node)
+{
+  if (_slots.count(&node) != 0)
+    return;
+
+  unsigned int s;
+
+  if (!_freeSlots.empty())
+  {
+    s = _freeSlots.back();
+    _freeSlots.pop_back();
+  }
+  else
+  {
+    s = static_cast<unsigned int>(_vertices.size());
+    _vertices.emplace_back();
+  }
+
+  Vertex & v = _vertices[s];
+  v = Vertex();
+  v.node = &node;
+
+  _slots[&node] = s;
+
+  // A node without edges is valid anywhere, so the end of the order will do
+  if (!_cyclic)
+  {
+    v.position = static_cast<unsigned int>(_orderSlots.size());
+    _orderSlots.push_back(s);
+  }
+
+  invalidate();
+}
+
+
+void
+TopologicalScheduler::
+removeNode(Node& node)
+{
+  auto it = _slots.find(&node);
+  if (it == _slots.end())
+    return;
+
+  unsigned int const s = it->second;
+  unsigned int const position = _vertices[s].position;
+
+  detach(s);
+  _slots.erase(it);
+
+  // Removing a vertex keeps the relative order of all the others
+  if (!_cyclic)
+  {
+    _orderSlots.erase(_orderSlots.begin() + position);
+
+    for (unsigned int i = position; i < _orderSlots.size(); ++i)
+      _vertices[_orderSlots[i]].position = i;
+  }
+
+  invalidate();
+}
+
+
+void
+TopologicalScheduler::
+removeNodes(std::vector<Node*> const & nodes)
+{
+  std::vector<bool> removed(_vertices.size(), false);
+
+  for (Node * node : nodes)
+  {
+    auto it = _slots.find(node);
+    if (it == _slots.end())
+      continue;
+
+    removed[it->second] = true;
+
+    detach(it->second);
+    _slots.erase(it);
+  }
+
+  // One pass over the order instead of one per vertex
+  if (!_cyclic)
+  {
+    _orderSlots.erase(std::remove_if(_orderSlots.begin(), _orderSlots.end(),
+                                     [&](unsigned int s) { return removed[s]; }),
+                      _orderSlots.end());
+
+    for (unsigned int i = 0; i < _orderSlots.size(); ++i)
+      _vertices[_orderSlots[i]].position = i;
+  }
+
+  invalidate();
+}
+
+
+void
+TopologicalScheduler::
+detach(unsigned int s)
+{
+  Vertex & v = _vertices[s];
+
+  for (unsigned int succ : v.successors)
+  {
+    if (succ != s)
+      eraseOne(_vertices[succ].predecessors, s);
+  }
+
+  for (unsigned int pred : v.predecessors)
+  {
+    if (pred != s)
+      eraseOne(_vertices[pred].successors, s);
+  }
+
+  v = Vertex();
+  _freeSlots.push_back(s);
+}
+
+
+void
+TopologicalScheduler::
+addEdge(Node& from, Node& to)
+{
+  unsigned int const u = slot(from);
+  unsigned int const w = slot(to);
+
+  if (u == std::numeric_limits<unsigned int>::max() ||
+      w == std::numeric_limits<unsigned int>::max())
+    return;
+
+  _vertices[u].successors.push_back(w);
+  _vertices[w].predecessors.push_back(u);
+
+  if (_cyclic)
+  {
+    invalidate();
+    return;
+  }
+
+  if (u == w)
+  {
+    _cyclic = true;
+    invalidate();
+    return;
+  }
+
+  // The common case: the edge agrees with the current order
+  if (_vertices[u].position < _vertices[w].position)
+    return;
+
+  if (!reorder(u, w))
+    _cyclic = true;
+
+  invalidate();
+}
+
+
+void
+TopologicalScheduler::
+removeEdge(Node& from, Node& to)
+{
+  unsigned int const u = slot(from);
+  unsigned int const w = slot(to);
+
+  if (u == std::numeric_limits<unsigned int>::max() ||
+      w == std::numeric_limits<unsigned int>::max())
+    return;
+
+  auto & successors = _vertices[u].successors;
+  if (std::find(successors.begin(), successors.end(), w) == successors.end())
+    return;
+
+  eraseOne(successors, w);
+  eraseOne(_vertices[w].predecessors, u);
+
+  // An acyclic order stays valid without the edge. A cyclic graph may have
+  // just lost its cycle, which the next rebuild finds out.
+  if (_cyclic)
+    invalidate();
+}
+
+
+void
+TopologicalScheduler::
+clear()
+{
+  _vertices.clear();
+  _freeSlots.clear();
+  _slots.clear();
+  _orderSlots.clear();
+  _cyclic = false;
+  _order.clear();
+  _cyclicNodes.clear();
+  _cacheValid = true;
+}
+
+
+std::vector<Node*> const &
+TopologicalScheduler::
+order() const
+{
+  if (!_cacheValid)
+    rebuild();
+
+  return _order;
+}
+
+
+std::vector<Node*> const &
+TopologicalScheduler::
+cyclicNodes() const
+{
+  if (!_cacheValid)
+    rebuild();
+
+  return _cyclicNodes;
+}
+
+
+bool
+TopologicalScheduler::
+hasCycle() const
+{
+  return !cyclicNodes().empty();
+}
+
+
+unsigned int
+TopologicalScheduler::
+position(Node const& node) const
+{
+  unsigned int const s = slot(node);
+
+  if (s == std::numeric_limits<unsigned int>::max())
+    return s;
+
+  if (!_cacheValid)
+    rebuild();
+
+  return _vertices[s].position;
+}
+
+
+unsigned int
+TopologicalScheduler::
+slot(Node const& node) const
+{
+  auto it = _slots.find(&node);
+
+  if (it == _slots.end())
+    return std::numeric_limits<unsigned int>::max();
+
+  return it->second;
+}
+
+
+/// Pearce-Kelly repair for a new edge u -> w with position(w) < position(u).
+/// Only the vertices between the two positions are visited. Returns false
+/// when w already reaches u, i.e. the edge closes a cycle.
+bool
+TopologicalScheduler::
+reorder(unsigned int u, unsigned int w)
+{
+  unsigned int const lowerBound = _vertices[w].position;
+  unsigned int const upperBound = _vertices[u].position;
+
+  ++_epoch;
+
+  std::vector<unsigned int> forward;
+  std::vector<unsigned int> backward;
+  std::vector<unsigned int> stack;
+
+  stack.push_back(w);
+  _vertices[w].mark = _epoch;
+
+  while (!stack.empty())
+  {
+    unsigned int n = stack.back();
+    stack.pop_back();
+    forward.push_back(n);
+
+    for (unsigned int s : _vertices[n].successors)
+    {
+      if (s == u)
+        return false;
+
+      Vertex & sv = _vertices[s];
+
+      if (sv.mark != _epoch && sv.position < upperBound)
+      {
+        sv.mark = _epoch;
+        stack.push_back(s);
+      }
+    }
+  }
+
+  stack.push_back(u);
+  _vertices[u].mark = _epoch;
+
+  while (!stack.empty())
+  {
+    unsigned int n = stack.back();
+    stack.pop_back();
+    backward.push_back(n);
+
+    for (unsigned int p : _vertices[n].predecessors)
+    {
+      Vertex & pv = _vertices[p];
+
+      if (pv.mark != _epoch && pv.position > lowerBound)
+      {
+        pv.mark = _epoch;
+        stack.push_back(p);
+      }
+    }
+  }
+
+  auto byPosition = [this](unsigned int a, unsigned int b)
+  {
+    return _vertices[a].position < _vertices[b].position;
+  };
+
+  std::sort(forward.begin(), forward.end(), byPosition);
+  std::sort(backward.begin(), backward.end(), byPosition);
+
+  // Everything upstream of u moves in front of everything downstream of w,
+  // reusing the positions the two sets already occupy.
+  std::vector<unsigned int> positions;
+  positions.reserve(forward.size() + backward.size());
+
+  for (unsigned int s : backward)
+    positions.push_back(_vertices[s].position);
+  for (unsigned int s : forward)
+    positions.push_back(_vertices[s].position);
+
+  std::sort(positions.begin(), positions.end());
+
+  std::size_t i = 0;
+
+  for (unsigned int s : backward)
+  {
+    _vertices[s].position = positions[i];
+    _orderSlots[positions[i]] = s;
+    ++i;
+  }
+
+  for (unsigned int s : forward)
+  {
+    _vertices[s].position = positions[i];
+    _orderSlots[positions[i]] = s;
+    ++i;
+  }
+
+  return true;
+}
+
+
+void
+TopologicalScheduler::
+rebuild() const
+{
+  _order.clear();
+  _cyclicNodes.clear();
+
+  if (!_cyclic)
+  {
+    _order.reserve(_orderSlots.size());
+
+    for (unsigned int s : _orderSlots)
+      _order.push_back(_vertices[s].node);
+
+    _cacheValid = true;
+    return;
+  }
+
+  // Kahn's algorithm over the live vertices
+  std::vector<unsigned int> inDegree(_vertices.size(), 0);
+
+  for (Vertex const & v : _vertices)
+  {
+    if (v.node == nullptr)
+      continue;
+
+    for (unsigned int s : v.successors)
+      ++inDegree[s];
+  }
+
+  std::vector<unsigned int> ready;
+  ready.reserve(_slots.size());
+
+  for (unsigned int s = 0; s < _vertices.size(); ++s)
+  {
+    if (_vertices[s].node != nullptr && inDegree[s] == 0)
+      ready.push_back(s);
+  }
+
+  for (std::size_t head = 0; head < ready.size(); ++head)
+  {
+    for (unsigned int s : _vertices[ready[head]].successors)
+    {
+      if (--inDegree[s] == 0)
+        ready.push_back(s);
+    }
+  }
+
+  _order.reserve(ready.size());
+
+  for (unsigned int i = 0; i < ready.size(); ++i)
+  {
+    _vertices[ready[i]].position = i;
+    _order.push_back(_vertices[ready[i]].node);
+  }
+
+  if (ready.size() == _slots.size())
+  {
+    _cyclic     = false;
+    _orderSlots = std::move(ready);
+  }
+  else
+  {
+    unsigned int rank = static_cast<unsigned int>(ready.size());
+
+    for (unsigned int s = 0; s < _vertices.size(); ++s)
+    {
+      if (_vertices[s].node != nullptr && inDegree[s] != 0)
+      {
+        _vertices[s].position = rank++;
+        _cyclicNodes.push_back(_vertices[s].node);
+      }
+    }
+  }
+
+  _cacheValid = true;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+namespace QtNodes
+{
+
+class Node;
+
+/// Keeps a dense adjacency of the scene's nodes and a topological order of
+/// them. The order is repaired incrementally when an edge is added
+/// (Pearce-Kelly), and removing edges or nodes never invalidates it.
+/// An edge closing a cycle is detected, the order is then rebuilt
+/// (Kahn) on the next query until the cycle is broken again.
+class TopologicalScheduler
+{
+public:
+
+  TopologicalScheduler();
+
+public:
+
+  void
+  addNode(Node& node);
+
+  void
+  removeNode(Node& node);
+
+  /// Same as removing the nodes one by one, with a single pass over the
+  /// order
+  void
+  removeNodes(std::vector<Node*> const & nodes);
+
+  /// Adds an edge from the node owning the output port to the node owning
+  /// the input port. Parallel edges are counted.
+  void
+  addEdge(Node& from, Node& to);
+
+  /// Removes one edge from -> to. Unknown edges are ignored.
+  void
+  removeEdge(Node& from, Node& to);
+
+  void
+  clear();
+
+public:
+
+  /// Nodes ordered so that every node comes after all of its upstream nodes.
+  /// Nodes on a cycle, or downstream of one, are not part of the order.
+  std::vector<Node*> const &
+  order() const;
+
+  /// Nodes left out of order() because of a cycle.
+  std::vector<Node*> const &
+  cyclicNodes() const;
+
+  bool
+  hasCycle() const;
+
+  /// Rank of the node in the scheduler's order. Nodes left out
+  /// because of a cycle rank after every ordered node.
+  unsigned int
+  position(Node const& node) const;
+
+private:
+
+  struct Vertex
+  {
+    Node* node = nullptr;
+
+    std::vector<unsigned int> successors;
+    std::vector<unsigned int> predecessors;
+
+    unsigned int position = 0;
+    unsigned int mark     = 0;
+  };
+
+  unsigned int
+  slot(Node const& node) const;
+
+  /// Drops the vertex's edges and frees its slot
+  void
+  detach(unsigned int s);
+
+  bool
+  reorder(unsigned int from, unsigned int to);
+
+  void
+  rebuild() const;
+
+  void
+  invalidate() const { _cacheValid = false; }
+
+private:
+
+  mutable std::vector<Vertex> _vertices;
+
+  std::vector<unsigned int> _freeSlots;
+
+  std::unordered_map<Node const*, unsigned int> _slots;
+
+  /// Live slots in topological order, valid while _cyclic is false.
+  mutable std::vector<unsigned int> _orderSlots;
+
+  /// Set once an edge closed a cycle; cleared by rebuild() when Kahn's
+  /// algorithm succeeds again.
+  mutable bool _cyclic;
+
+  mutable bool _cacheValid;
+  mutable std::vector<Node*> _order;
+  mutable std::vector<Node*> _cyclicNodes;
+
+  unsigned int _epoch;
+};
+}
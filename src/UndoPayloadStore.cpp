@@ -0,0 +1,342 @@
+#include "UndoPayloadStore.hpp"
+
+#include <QtCore/QCborMap>
+#include <QtCore/QCborValue>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QJsonValue>
+#include <QtCore/QTemporaryFile>
+
+#include "memory.hpp"
+
+using QtNodes::UndoPayload;
+using QtNodes::UndoPayloadStore;
+using QtNodes::SharedUndoPayload;
+using QtNodes::UndoNodeRecord;
+using QtNodes::UndoConnectionRecord;
+
+UndoPayload::
+~UndoPayload()
+{
+  if (_store)
+    _store->release(*this);
+}
+
+
+QJsonObject
+UndoPayload::
+json() const
+{
+  QByteArray data = _data;
+
+  if (_fileOffset >= 0)
+  {
+    if (!_store)
+      return QJsonObject();
+
+    data = _store->readSpilled(*this);
+  }
+
+  if (_compressed)
+    data = qUncompress(data);
+
+  return QCborValue::fromCbor(data).toMap().toJsonObject();
+}
+
+
+int
+UndoPayload::
+size() const
+{
+  return _size;
+}
+
+
+//------------------------------------------------------------------------------
+
+UndoPayloadStore::
+UndoPayloadStore()
+  : _serial(0)
+  , _memoryBudget(64 * 1024 * 1024)
+  , _memoryUsage(0)
+  , _spilledBytes(0)
+{}
+
+
+UndoPayloadStore::
+~UndoPayloadStore()
+{
+  // Payloads still referenced by commands become self-contained
+  for (UndoPayload * payload : _payloads)
+  {
+    if (payload->_fileOffset >= 0)
+    {
+      payload->_data       = readSpilled(*payload);
+      payload->_fileOffset = -1;
+    }
+
+    payload->_store = nullptr;
+  }
+}
+
+
+SharedUndoPayload
+UndoPayloadStore::
+store(QJsonObject const & json)
+{
+  QByteArray const cbor = QCborValue::fromJsonValue(json).toCbor();
+  QByteArray const hash = QCryptographicHash::hash(cbor, QCryptographicHash::Sha1);
+
+  auto it = _payloads.find(hash);
+
+  if (it != _payloads.end())
+  {
+    UndoPayload * payload = it.value();
+
+    // Referenced again, so it's recent history
+    if (payload->_fileOffset < 0)
+    {
+      _resident.erase(payload->_serial);
+      payload->_serial = ++_serial;
+      _resident.emplace(payload->_serial, payload);
+    }
+
+    return payload->_self.lock();
+  }
+
+  std::shared_ptr<UndoPayload> payload(new UndoPayload());
+
+  payload->_store  = this;
+  payload->_self   = payload;
+  payload->_hash   = hash;
+  payload->_data   = cbor;
+  payload->_size   = cbor.size();
+  payload->_serial = ++_serial;
+
+  _payloads.insert(hash, payload.get());
+  _resident.emplace(payload->_serial, payload.get());
+  _memoryUsage += cbor.size();
+
+  enforceBudget();
+
+  return payload;
+}
+
+
+void
+UndoPayloadStore::
+setMemoryBudget(qint64 bytes)
+{
+  _memoryBudget = bytes;
+
+  enforceBudget();
+}
+
+
+qint64
+UndoPayloadStore::
+memoryBudget() const
+{
+  return _memoryBudget;
+}
+
+
+qint64
+UndoPayloadStore::
+memoryUsage() const
+{
+  return _memoryUsage;
+}
+
+
+qint64
+UndoPayloadStore::
+spilledBytes() const
+{
+  return _spilledBytes;
+}
+
+
+void
+UndoPayloadStore::
+release(UndoPayload & payload)
+{
+  _payloads.remove(payload._hash);
+
+  if (payload._fileOffset < 0)
+  {
+    _resident.erase(payload._serial);
+    _memoryUsage -= payload._data.size();
+  }
+  else
+  {
+    // The file space is only reclaimed with the file
+    _spilledBytes -= payload._fileSize;
+  }
+}
+
+
+void
+UndoPayloadStore::
+enforceBudget()
+{
+  if (_memoryBudget <= 0 || _memoryUsage <= _memoryBudget)
+    return;
+
+  // Compression first, it's cheaper to read back
+  for (auto const & entry : _resident)
+  {
+    if (_memoryUsage <= _memoryBudget)
+      return;
+
+    UndoPayload & payload = *entry.second;
+
+    if (payload._compressionTried)
+      continue;
+
+    payload._compressionTried = true;
+
+    QByteArray compressed = qCompress(payload._data);
+
+    if (compressed.size() < payload._data.size())
+    {
+      _memoryUsage -= payload._data.size() - compressed.size();
+
+      payload._data       = std::move(compressed);
+      payload._compressed = true;
+    }
+  }
+
+  while (_memoryUsage > _memoryBudget && !_resident.empty())
+  {
+    if (!spill(*_resident.begin()->second))
+      return;
+  }
+}
+
+
+bool
+UndoPayloadStore::
+spill(UndoPayload & payload)
+{
+  if (!_spillFile)
+  {
+    _spillFile = detail::make_unique<QTemporaryFile>();
+
+    if (!_spillFile->open())
+    {
+      _spillFile.reset();
+      return false;
+    }
+  }
+
+  qint64 const offset = _spillFile->size();
+
+  if (!_spillFile->seek(offset) ||
+      _spillFile->write(payload._data) != payload._data.size())
+    return false;
+
+  _resident.erase(payload._serial);
+  _memoryUsage  -= payload._data.size();
+  _spilledBytes += payload._data.size();
+
+  payload._fileOffset = offset;
+  payload._fileSize   = payload._data.size();
+  payload._data       = QByteArray();
+
+  return true;
+}
+
+
+QByteArray
+UndoPayloadStore::
+readSpilled(UndoPayload const & payload) const
+{
+  if (!_spillFile || !_spillFile->seek(payload._fileOffset))
+    return QByteArray();
+
+  return _spillFile->read(payload._fileSize);
+}
+
+
+//------------------------------------------------------------------------------
+
+UndoNodeRecord
+UndoNodeRecord::
+fromJson(QJsonObject const & nodeJson, UndoPayloadStore & store)
+{
+  UndoNodeRecord record;
+
+  record.id = QUuid(nodeJson["id"].toString());
+
+  QJsonObject const positionJson = nodeJson["position"].toObject();
+  record.position = QPointF(positionJson["x"].toDouble(),
+                            positionJson["y"].toDouble());
+
+  record.model = store.store(nodeJson["model"].toObject());
+
+  return record;
+}
+
+
+QJsonObject
+UndoNodeRecord::
+toJson() const
+{
+  QJsonObject nodeJson;
+
+  nodeJson["id"] = id.toString();
+
+  nodeJson["model"] = model ? model->json() : QJsonObject();
+
+  QJsonObject positionJson;
+  positionJson["x"] = position.x();
+  positionJson["y"] = position.y();
+  nodeJson["position"] = positionJson;
+
+  return nodeJson;
+}
+
+
+UndoConnectionRecord
+UndoConnectionRecord::
+fromJson(QJsonObject const & connectionJson)
+{
+  UndoConnectionRecord record;
+
+  record.id = QUuid(connectionJson["id"].toString());
+
+  if (connectionJson.contains("in_id"))
+  {
+    record.inNodeId     = QUuid(connectionJson["in_id"].toString());
+    record.inPortIndex  = connectionJson["in_index"].toInt();
+    record.outNodeId    = QUuid(connectionJson["out_id"].toString());
+    record.outPortIndex = connectionJson["out_index"].toInt();
+  }
+
+  record.converter = connectionJson["converter"].toObject();
+
+  return record;
+}
+
+
+QJsonObject
+UndoConnectionRecord::
+toJson() const
+{
+  QJsonObject connectionJson;
+
+  connectionJson["id"] = id.toString();
+
+  if (!inNodeId.isNull())
+  {
+    connectionJson["in_id"]     = inNodeId.toString();
+    connectionJson["in_index"]  = inPortIndex;
+    connectionJson["out_id"]    = outNodeId.toString();
+    connectionJson["out_index"] = outPortIndex;
+  }
+
+  if (!converter.isEmpty())
+    connectionJson["converter"] = converter;
+
+  return connectionJson;
+}
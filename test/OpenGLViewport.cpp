@@ -0,0 +1,111 @@
+#include <QtTest/QtTest>
+
+#include <QtWidgets/QOpenGLWidget>
+
+#include <nodes/FlowGraph>
+#include <nodes/FlowScene>
+#include <nodes/FlowView>
+
+#include "TestModels.hpp"
+
+using QtNodes::FlowGraph;
+using QtNodes::FlowScene;
+using QtNodes::FlowView;
+using TestModels::buildDiamond;
+
+/// The OpenGL viewport draws a graph with nodes and connections through
+/// the connection layer, and going back to raster leaves the layer as it
+/// was before
+class OpenGLViewport
+  : public QObject
+{
+  Q_OBJECT
+
+private:
+
+  /// The diamond, laid out in a row so its connections have length
+  static
+  void
+  buildFixture(FlowScene & scene)
+  {
+    FlowGraph & graph = scene.graph();
+
+    buildDiamond(graph);
+
+    int column = 0;
+
+    for (auto const & node : graph.nodes())
+    {
+      graph.setNodePosition(*node, QPointF(250.0 * column, 40.0 * column));
+      ++column;
+    }
+  }
+
+  /// Repaints the viewport; false if it is a GL one without a context
+  static
+  bool
+  renderFrame(FlowView & view)
+  {
+    view.viewport()->repaint();
+
+    auto widget = qobject_cast<QOpenGLWidget*>(view.viewport());
+
+    if (!widget)
+      return true;
+
+    return widget->isValid() && !widget->grabFramebuffer().isNull();
+  }
+
+private Q_SLOTS:
+
+  void
+  restoresConnectionLayer_data()
+  {
+    QTest::addColumn<bool>("layerBefore");
+
+    QTest::newRow("layer off") << false;
+    QTest::newRow("layer on")  << true;
+  }
+
+  void
+  restoresConnectionLayer()
+  {
+    QFETCH(bool, layerBefore);
+
+    FlowScene scene;
+    buildFixture(scene);
+
+    QCOMPARE(scene.graph().nodes().size(), std::size_t(5));
+    QCOMPARE(scene.graph().connections().size(), std::size_t(5));
+
+    scene.setConnectionLayerEnabled(layerBefore);
+
+    FlowView view(&scene);
+    view.resize(800, 600);
+    view.show();
+
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    QCOMPARE(view.rendering(), FlowView::Rendering::Raster);
+    QVERIFY(renderFrame(view));
+
+    view.setRendering(FlowView::Rendering::OpenGL);
+    QApplication::processEvents();
+
+    QVERIFY(qobject_cast<QOpenGLWidget*>(view.viewport()));
+    QVERIFY2(renderFrame(view), "Cannot create an OpenGL context");
+    QVERIFY(scene.connectionLayerEnabled());
+    QVERIFY(scene.connectionLayer());
+
+    view.setRendering(FlowView::Rendering::Raster);
+    QApplication::processEvents();
+
+    QVERIFY(!qobject_cast<QOpenGLWidget*>(view.viewport()));
+    QVERIFY(renderFrame(view));
+    QCOMPARE(scene.connectionLayerEnabled(), layerBefore);
+    QCOMPARE(scene.connectionLayer() != nullptr, layerBefore);
+  }
+};
+
+QTEST_MAIN(OpenGLViewport)
+
+#include "OpenGLViewport.moc"
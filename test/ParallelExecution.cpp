@@ -0,0 +1,88 @@
+#include <QtTest/QtTest>
+
+#include <nodes/FlowGraph>
+
+#include "TestModels.hpp"
+
+using QtNodes::FlowGraph;
+using TestModels::Diamond;
+using TestModels::buildDiamond;
+using TestModels::NumberModel;
+
+/// Parallel execution gives the sinks the data push mode gives them, and
+/// its evaluations are counted like serial ones
+class ParallelExecution
+  : public QObject
+{
+  Q_OBJECT
+
+private:
+
+  static
+  double
+  sinkValue(Diamond const & diamond)
+  {
+    auto result = static_cast<NumberModel*>(diamond.sink->nodeDataModel())->result();
+
+    return result ? result->value() : qQNaN();
+  }
+
+private Q_SLOTS:
+
+  void
+  parallelMatchesPush()
+  {
+    FlowGraph push;
+    Diamond const pushed = buildDiamond(push);
+
+    QTRY_VERIFY_WITH_TIMEOUT(push.isIdle(), 5000);
+    QCOMPARE(sinkValue(pushed), -90.0);
+
+    FlowGraph parallel;
+    parallel.setExecutionMode(FlowGraph::ExecutionMode::Parallel);
+
+    Diamond const computed = buildDiamond(parallel);
+
+    QTRY_VERIFY_WITH_TIMEOUT(parallel.isIdle(), 5000);
+    QCOMPARE(sinkValue(computed), sinkValue(pushed));
+  }
+
+  void
+  parallelEvaluationsAreCounted()
+  {
+    FlowGraph graph;
+    graph.setProfiling(true);
+    graph.setExecutionMode(FlowGraph::ExecutionMode::Parallel);
+
+    Diamond const diamond = buildDiamond(graph);
+
+    QTRY_VERIFY_WITH_TIMEOUT(graph.isIdle(), 5000);
+
+    QCOMPARE(diamond.left->evaluationCount(), 1u);
+    QCOMPARE(diamond.right->evaluationCount(), 1u);
+    QVERIFY(diamond.sink->evaluationCount() >= 1u);
+  }
+
+  void
+  flushedInputsAreCounted()
+  {
+    FlowGraph graph;
+    graph.setProfiling(true);
+    graph.setExecutionMode(FlowGraph::ExecutionMode::Parallel);
+
+    Diamond const diamond = buildDiamond(graph);
+
+    // Applies what is queued on this thread, the rest runs serially
+    graph.setExecutionMode(FlowGraph::ExecutionMode::Synchronous);
+
+    QTRY_VERIFY_WITH_TIMEOUT(graph.isIdle(), 5000);
+
+    QCOMPARE(sinkValue(diamond), -90.0);
+    QCOMPARE(diamond.left->evaluationCount(), 1u);
+    QCOMPARE(diamond.right->evaluationCount(), 1u);
+  }
+};
+
+QTEST_GUILESS_MAIN(ParallelExecution)
+
+#include "ParallelExecution.moc"
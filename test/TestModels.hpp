@@ -0,0 +1,253 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include <QtCore/QJsonObject>
+
+#include <nodes/FlowGraph>
+#include <nodes/Node>
+#include <nodes/NodeData>
+#include <nodes/NodeDataModel>
+
+/// Small numeric models for the tests. They are thread safe, so the
+/// parallel executor runs them on its threads.
+namespace TestModels
+{
+
+using QtNodes::FlowGraph;
+using QtNodes::Node;
+using QtNodes::NodeData;
+using QtNodes::NodeDataModel;
+using QtNodes::NodeDataType;
+using QtNodes::PortIndex;
+using QtNodes::PortType;
+
+class NumberData
+  : public NodeData
+{
+public:
+
+  explicit
+  NumberData(double value)
+    : _value(value)
+  {}
+
+  NodeDataType
+  type() const override { return NodeDataType{ "number", "Number" }; }
+
+  QJsonValue
+  toJson() const override { return _value; }
+
+  double
+  value() const { return _value; }
+
+private:
+
+  double _value;
+};
+
+
+/// Base of the models: one output holding the last result, guarded
+/// against the GUI thread reading it while a worker computes
+class NumberModel
+  : public NodeDataModel
+{
+public:
+
+  bool
+  portRequired(PortIndex) const override { return true; }
+
+  NodeDataType
+  dataType(PortType, PortIndex) const override { return NodeDataType{ "number", "Number" }; }
+
+  std::shared_ptr<NodeData>
+  outData(PortIndex) override
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _result;
+  }
+
+  QWidget *
+  embeddedWidget() override { return nullptr; }
+
+  bool
+  threadSafe() const override { return true; }
+
+  /// Null until every input arrived
+  std::shared_ptr<NumberData>
+  result() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _result;
+  }
+
+protected:
+
+  void
+  setResult(std::shared_ptr<NumberData> result)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _result = std::move(result);
+    }
+
+    Q_EMIT dataUpdated(0);
+  }
+
+private:
+
+  mutable std::mutex _mutex;
+
+  std::shared_ptr<NumberData> _result;
+};
+
+
+/// Saved value, no inputs
+class Source
+  : public NumberModel
+{
+public:
+
+  explicit
+  Source(double value = 0.0)
+  {
+    setResult(std::make_shared<NumberData>(value));
+  }
+
+  QString caption() const override { return "Source"; }
+
+  QString name() const override { return "Source"; }
+
+  unsigned int
+  nPorts(PortType portType) const override { return portType == PortType::Out ? 1 : 0; }
+
+  void
+  setInData(std::shared_ptr<NodeData>, PortIndex) override {}
+
+  QJsonObject
+  save() const override
+  {
+    QJsonObject modelJson = NodeDataModel::save();
+    modelJson["value"] = result()->value();
+    return modelJson;
+  }
+
+  void
+  restore(QJsonObject const & modelJson) override
+  {
+    setResult(std::make_shared<NumberData>(modelJson["value"].toDouble()));
+  }
+};
+
+
+/// Input times a saved factor
+class Scale
+  : public NumberModel
+{
+public:
+
+  explicit
+  Scale(double factor = 1.0)
+    : _factor(factor)
+  {}
+
+  QString caption() const override { return "Scale"; }
+
+  QString name() const override { return "Scale"; }
+
+  unsigned int
+  nPorts(PortType) const override { return 1; }
+
+  void
+  setInData(std::shared_ptr<NodeData> nodeData, PortIndex) override
+  {
+    auto number = std::dynamic_pointer_cast<NumberData>(nodeData);
+
+    setResult(number ? std::make_shared<NumberData>(number->value() * _factor) : nullptr);
+  }
+
+  QJsonObject
+  save() const override
+  {
+    QJsonObject modelJson = NodeDataModel::save();
+    modelJson["factor"] = _factor;
+    return modelJson;
+  }
+
+  void
+  restore(QJsonObject const & modelJson) override
+  {
+    _factor = modelJson["factor"].toDouble();
+  }
+
+private:
+
+  double _factor;
+};
+
+
+/// Sum of both inputs
+class Add
+  : public NumberModel
+{
+public:
+
+  QString caption() const override { return "Add"; }
+
+  QString name() const override { return "Add"; }
+
+  unsigned int
+  nPorts(PortType portType) const override { return portType == PortType::In ? 2 : 1; }
+
+  void
+  setInData(std::shared_ptr<NodeData> nodeData, PortIndex port) override
+  {
+    _inputs[port] = std::dynamic_pointer_cast<NumberData>(nodeData);
+
+    if (_inputs[0] && _inputs[1])
+      setResult(std::make_shared<NumberData>(_inputs[0]->value() + _inputs[1]->value()));
+    else
+      setResult(nullptr);
+  }
+
+private:
+
+  /// Only touched by setInData, which the executor runs one at a time
+  std::shared_ptr<NumberData> _inputs[2];
+};
+
+
+struct Diamond
+{
+  Node * left;
+  Node * right;
+  Node * sink;
+};
+
+
+/// 3 -> (x2, x-5) -> + -> x10, so -90 reaches the sink. Built in a
+/// batch, every output is pushed once.
+inline
+Diamond
+buildDiamond(FlowGraph & graph)
+{
+  graph.beginBatch();
+
+  Node & source = graph.createNode(std::make_unique<Source>(3.0));
+  Node & left   = graph.createNode(std::make_unique<Scale>(2.0));
+  Node & right  = graph.createNode(std::make_unique<Scale>(-5.0));
+  Node & add    = graph.createNode(std::make_unique<Add>());
+  Node & sink   = graph.createNode(std::make_unique<Scale>(10.0));
+
+  graph.createConnection(add,   0, left,   0);
+  graph.createConnection(add,   1, right,  0);
+  graph.createConnection(sink,  0, add,    0);
+  graph.createConnection(left,  0, source, 0);
+  graph.createConnection(right, 0, source, 0);
+
+  graph.commitBatch();
+
+  return Diamond{ &left, &right, &sink };
+}
+}
@@ -0,0 +1,835 @@
+/// Evaluates a saved flow without a window and writes what its sinks hold.
+///
+///   NodeEditorRunner [-p plugin]... [-o output.json] [--timeout seconds]
+///                    [--render frames [--opengl] [--connection-layer]]
+///                    [--time-formats] [--time-teardown] [--time-delete]
+///                    scene.flow
+///
+/// Models come from plugins: shared libraries exporting
+///
+///   extern "C" void registerModels(QtNodes::DataModelRegistry & registry);
+///
+/// The graph is restored with FlowGraph::loadFromMemory, which pushes every
+/// output once, in topological order, and the runner then waits until the
+/// graph is idle, so that type converters and the parallel executor have
+/// reported back. It runs under a QCoreApplication, so models must not
+/// create their embedded widgets before embeddedWidget() is called.
+///
+/// Per-node timings and the wall time go to stderr. The sinks, nodes whose
+/// outputs are not connected, go as JSON to stdout or to the output file:
+/// the data of each output port, see NodeData::toJson, or the model's
+/// saved state for nodes without outputs.
+///
+/// With --render the runner starts a QApplication instead, and the evaluated
+/// graph is then shown by a FlowScene in a FlowView and repainted while
+/// panning, fitted and at 1:1, and the time per frame goes to stderr,
+/// along with the time to find the items under a point. Under
+/// Xvfb with LIBGL_ALWAYS_SOFTWARE=1, --opengl renders on Mesa's llvmpipe,
+/// which compares the GL viewport with the raster one on machines
+/// without a GPU.
+///
+/// --time-formats saves the evaluated graph in each SceneFormat and loads
+/// it back into a graph of its own, and reports the size and the times.
+/// The chunked file is saved as if a 1920x1080 view showed the middle of
+/// the graph, and the time until that region is restored is reported too.
+/// --time-teardown times FlowGraph::clear() against deleting the items one
+/// at a time, which is how scenes used to be cleared. --time-delete times
+/// FlowGraph::removeNodes() on half the nodes against removing them one
+/// at a time, which is how selections used to be deleted.
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QLibrary>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFunctions>
+#include <QtWidgets/QApplication>
+#include <QtWidgets/QOpenGLWidget>
+
+#include <nodes/DataModelRegistry>
+#include <nodes/FlowGraph>
+#include <nodes/FlowScene>
+#include <nodes/FlowView>
+#include <nodes/Node>
+#include <nodes/NodeData>
+#include <nodes/NodeDataModel>
+#include <nodes/internal/GraphFrontEnd.hpp>
+
+using QtNodes::Connection;
+using QtNodes::DataModelRegistry;
+using QtNodes::FlowGraph;
+using QtNodes::FlowScene;
+using QtNodes::FlowView;
+using QtNodes::GraphFrontEnd;
+using QtNodes::Node;
+using QtNodes::NodeData;
+using QtNodes::NodeDataModel;
+using QtNodes::PortType;
+
+using RegisterModels = void (*)(DataModelRegistry &);
+
+static
+bool
+loadPlugin(QString const & fileName, DataModelRegistry & registry, QTextStream & log)
+{
+  // Never unloaded, the models live until exit
+  QLibrary library(fileName);
+
+  auto registerModels =
+    reinterpret_cast<RegisterModels>(library.resolve("registerModels"));
+
+  if (!registerModels)
+  {
+    log << "Cannot load plugin " << fileName << ": " << library.errorString() << '\n';
+    return false;
+  }
+
+  registerModels(registry);
+
+  return true;
+}
+
+
+/// Whether --render was given, before there is an application to parse
+/// the arguments with
+static
+bool
+renderingRequested(int argc, char * argv[])
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (QByteArray(argv[i]).startsWith("--render"))
+      return true;
+  }
+
+  return false;
+}
+
+
+/// Runs the event loop until the graph is idle. False if the deadline
+/// passes first.
+static
+bool
+waitForIdle(FlowGraph const & graph, QDeadlineTimer const & deadline)
+{
+  // Wakes the loop to check the deadline when nothing reports back
+  QTimer wakeUp;
+  wakeUp.start(100);
+
+  while (!graph.isIdle())
+  {
+    if (deadline.hasExpired())
+      return false;
+
+    QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+  }
+
+  return true;
+}
+
+
+/// The data of every output port, or the model's state if it has none
+static
+QJsonObject
+saveSink(Node & node)
+{
+  NodeDataModel * model = node.nodeDataModel();
+
+  QJsonObject sinkJson;
+  sinkJson["id"] = node.id().toString();
+
+  unsigned int const nOut = model->nPorts(PortType::Out);
+
+  if (nOut == 0)
+  {
+    sinkJson["model"] = model->save();
+    return sinkJson;
+  }
+
+  sinkJson["name"] = model->name();
+
+  QJsonArray outputsJson;
+
+  for (unsigned int i = 0; i < nOut; ++i)
+  {
+    std::shared_ptr<NodeData> const data = model->outData(i);
+
+    QJsonObject outputJson;
+    outputJson["port"] = static_cast<int>(i);
+
+    if (data)
+    {
+      outputJson["type"] = data->type().id;
+      outputJson["data"] = data->toJson();
+    }
+    else
+    {
+      outputJson["data"] = QJsonValue();
+    }
+
+    outputsJson.append(outputJson);
+  }
+
+  sinkJson["outputs"] = outputsJson;
+
+  return sinkJson;
+}
+
+
+/// Milliseconds f takes
+template <typename F>
+static
+double
+timeMs(F f)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  f();
+
+  return timer.nsecsElapsed() / 1e6;
+}
+
+
+/// Shows nothing, but tells a chunked save which region is on screen
+class RegionFrontEnd
+  : public GraphFrontEnd
+{
+public:
+
+  explicit
+  RegionFrontEnd(QRectF const & rect)
+    : _rect(rect)
+  {}
+
+  void
+  showNode(Node &) override {}
+
+  void
+  showConnection(Connection &) override {}
+
+  void
+  removingItems() override {}
+
+  QRectF
+  visibleRect() const override { return _rect; }
+
+private:
+
+  QRectF _rect;
+};
+
+
+/// Saves the graph as a chunked file, with a 1920x1080 view on the middle
+/// of its node positions, and loads it from the file into a graph of its
+/// own. Logs the time until load() returns, with the region around the
+/// view restored, and until loadFinished(), with every node restored and
+/// the data pushed.
+static
+bool
+timeChunked(FlowGraph & graph,
+            std::shared_ptr<DataModelRegistry> const & registry,
+            QTextStream & log)
+{
+  QRectF positions;
+
+  for (auto const & node : graph.nodes())
+    positions |= QRectF(graph.getNodePosition(*node), QSizeF(1.0, 1.0));
+
+  QRectF view(0.0, 0.0, 1920.0, 1080.0);
+  view.moveCenter(positions.center());
+
+  RegionFrontEnd region(view);
+
+  QByteArray data;
+
+  // Only the save asks the front end
+  graph.setFrontEnd(&region);
+
+  double const saving = timeMs([&]()
+  {
+    data = graph.saveToMemory(FlowGraph::SceneFormat::Chunked);
+  });
+
+  graph.setFrontEnd(nullptr);
+
+  QTemporaryFile file(QDir::tempPath() + "/NodeEditorRunner-XXXXXX.flow");
+
+  if (!file.open() || file.write(data) != data.size() || !file.flush())
+  {
+    log << "Cannot write " << file.fileName() << '\n';
+    return false;
+  }
+
+  FlowGraph loaded(registry);
+
+  bool finished = false;
+
+  QObject::connect(&loaded, &FlowGraph::loadFinished, [&]() { finished = true; });
+
+  QElapsedTimer timer;
+  timer.start();
+
+  if (!loaded.load(file.fileName()))
+  {
+    log << "Cannot load " << file.fileName() << '\n';
+    return false;
+  }
+
+  double const firstRegion = timer.nsecsElapsed() / 1e6;
+  std::size_t const regionNodes = loaded.nodes().size();
+
+  // The rest streams in from the event loop
+  while (!finished)
+    QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+  double const loading = timer.nsecsElapsed() / 1e6;
+
+  log << "chunked\t"
+      << data.size() << '\t'
+      << QString::number(saving, 'f', 3) << '\t'
+      << QString::number(loading, 'f', 3) << '\n';
+
+  log << "chunked first region\t"
+      << QString::number(firstRegion, 'f', 3) << " ms\t"
+      << regionNodes << " of " << graph.nodes().size() << " nodes\n";
+
+  if (loaded.nodes().size() != graph.nodes().size() ||
+      loaded.connections().size() != graph.connections().size())
+  {
+    log << "chunked does not round-trip\n";
+    return false;
+  }
+
+  waitForIdle(loaded, QDeadlineTimer(QDeadlineTimer::Forever));
+
+  return true;
+}
+
+
+/// Saves the graph in each format and loads it into a graph of its own.
+/// The load is timed until loadFromMemory returns, once every node is
+/// restored and its data pushed; what models compute on other threads
+/// after is not. The chunked file is loaded from disk, see timeChunked.
+/// False if a format does not round-trip.
+static
+bool
+timeFormats(FlowGraph & graph,
+            std::shared_ptr<DataModelRegistry> const & registry,
+            QTextStream & log)
+{
+  struct Format
+  {
+    char const *          name;
+    FlowGraph::SceneFormat format;
+  };
+
+  Format const formats[] = {
+    { "json", FlowGraph::SceneFormat::Json },
+    { "cbor", FlowGraph::SceneFormat::Cbor }
+  };
+
+  log << "format\tbytes\tsave ms\tload ms\n";
+
+  for (Format const & format : formats)
+  {
+    QByteArray data;
+
+    double const saving = timeMs([&]()
+    {
+      data = graph.saveToMemory(format.format);
+    });
+
+    FlowGraph loaded(registry);
+
+    double const loading = timeMs([&]()
+    {
+      loaded.loadFromMemory(data);
+    });
+
+    log << format.name << '\t'
+        << data.size() << '\t'
+        << QString::number(saving, 'f', 3) << '\t'
+        << QString::number(loading, 'f', 3) << '\n';
+
+    if (loaded.nodes().size() != graph.nodes().size() ||
+        loaded.connections().size() != graph.connections().size())
+    {
+      log << format.name << " does not round-trip\n";
+      return false;
+    }
+
+    // Not timed, nor is tearing the copy down
+    waitForIdle(loaded, QDeadlineTimer(QDeadlineTimer::Forever));
+  }
+
+  return timeChunked(graph, registry, log);
+}
+
+
+/// A graph of its own, loaded from data and evaluated, to time an
+/// operation on
+static
+std::unique_ptr<FlowGraph>
+loadCopy(QByteArray const & data, std::shared_ptr<DataModelRegistry> const & registry)
+{
+  auto copy = std::make_unique<FlowGraph>(registry);
+
+  copy->loadFromMemory(data);
+
+  waitForIdle(*copy, QDeadlineTimer(QDeadlineTimer::Forever));
+
+  return copy;
+}
+
+
+/// Tears a copy of the graph down with clear(), and another one item by
+/// item: every connection, then every node, each deleted connection
+/// pushing empty data downstream. The latter is timed until its copy is
+/// idle again.
+static
+void
+timeTeardown(FlowGraph const & graph,
+             std::shared_ptr<DataModelRegistry> const & registry,
+             QTextStream & log)
+{
+  QByteArray const data = graph.saveToMemory();
+
+  std::unique_ptr<FlowGraph> const itemByItem = loadCopy(data, registry);
+
+  double const deleting = timeMs([&]()
+  {
+    FlowGraph & copy = *itemByItem;
+
+    while (!copy.connections().empty())
+      copy.deleteConnection(**copy.connections().begin());
+
+    while (!copy.nodes().empty())
+      copy.removeNode(**copy.nodes().begin());
+
+    waitForIdle(copy, QDeadlineTimer(QDeadlineTimer::Forever));
+  });
+
+  std::unique_ptr<FlowGraph> const cleared = loadCopy(data, registry);
+
+  double const clearing = timeMs([&]()
+  {
+    cleared->clear();
+  });
+
+  log << "teardown item by item\t" << QString::number(deleting, 'f', 3) << " ms\n";
+  log << "teardown clear\t" << QString::number(clearing, 'f', 3) << " ms\n";
+}
+
+
+/// Removes every other node from a copy of the graph with removeNodes(),
+/// and from another one node by node with removeNode(), each deleted
+/// connection pushing empty data downstream. Both are timed until their
+/// copy is idle again.
+static
+void
+timeDelete(FlowGraph const & graph,
+           std::shared_ptr<DataModelRegistry> const & registry,
+           QTextStream & log)
+{
+  QByteArray const data = graph.saveToMemory();
+
+  // Spread over the graph, so most removed nodes border surviving ones
+  std::vector<QUuid> removed;
+
+  for (std::size_t i = 0; i < graph.nodes().size(); i += 2)
+    removed.push_back(graph.nodes().begin()[i]->id());
+
+  std::unique_ptr<FlowGraph> const nodeByNode = loadCopy(data, registry);
+
+  double const removing = timeMs([&]()
+  {
+    FlowGraph & copy = *nodeByNode;
+
+    for (QUuid const & id : removed)
+      copy.removeNode(*copy.node(id));
+
+    waitForIdle(copy, QDeadlineTimer(QDeadlineTimer::Forever));
+  });
+
+  std::unique_ptr<FlowGraph> const batched = loadCopy(data, registry);
+
+  double const batchRemoving = timeMs([&]()
+  {
+    FlowGraph & copy = *batched;
+
+    std::vector<Node*> nodes;
+    nodes.reserve(removed.size());
+
+    for (QUuid const & id : removed)
+      nodes.push_back(copy.node(id));
+
+    copy.removeNodes(nodes);
+
+    waitForIdle(copy, QDeadlineTimer(QDeadlineTimer::Forever));
+  });
+
+  log << "delete " << removed.size() << " nodes one by one\t"
+      << QString::number(removing, 'f', 3) << " ms\n";
+  log << "delete " << removed.size() << " nodes in one batch\t"
+      << QString::number(batchRemoving, 'f', 3) << " ms\n";
+}
+
+
+/// Pixels the view pans between frames
+static qreal const panStep = 8.0;
+
+/// Points per side of the viewport grid the hit test is timed on
+static int const hitTestGrid = 32;
+
+
+/// Repaints the view frames times while pan moves it back and forth, and
+/// returns the milliseconds per frame
+template <typename Pan>
+static
+double
+timeFrames(FlowView & view, int frames, Pan pan)
+{
+  auto widget = qobject_cast<QOpenGLWidget*>(view.viewport());
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for (int i = 0; i < frames; ++i)
+  {
+    // Back and forth, so every frame shows about the same
+    pan((i % 2 == 0) ? panStep : 0.0);
+
+    view.viewport()->repaint();
+  }
+
+  // GL commands may still be queued
+  if (widget)
+  {
+    widget->makeCurrent();
+    widget->context()->functions()->glFinish();
+    widget->doneCurrent();
+  }
+
+  return timer.nsecsElapsed() / 1e6 / std::max(frames, 1);
+}
+
+
+/// Shows the scene in a view and repaints it frames times, fitted and then
+/// at 1:1 around its middle, where only the items in view need drawing.
+/// Then times what hover and clicks ask the scene, the items under a
+/// point. False if the view cannot be drawn.
+static
+bool
+timeRendering(FlowScene & scene, int frames, FlowView::Rendering rendering, QTextStream & log)
+{
+  FlowView view;
+  view.setRendering(rendering);
+  view.setScene(&scene);
+  view.resize(1280, 800);
+  view.show();
+
+  QApplication::processEvents();
+
+  auto widget = qobject_cast<QOpenGLWidget*>(view.viewport());
+
+  if (rendering == FlowView::Rendering::OpenGL)
+  {
+    if (!widget || !widget->isValid())
+    {
+      log << "Cannot create an OpenGL context\n";
+      return false;
+    }
+
+    widget->makeCurrent();
+
+    log << "renderer "
+        << reinterpret_cast<char const *>(
+             widget->context()->functions()->glGetString(GL_RENDERER))
+        << '\n';
+
+    widget->doneCurrent();
+  }
+
+  // The nodes, not the items bounding rect, which takes in the tiles
+  // holding them
+  QRectF bounds;
+
+  for (auto const & node : scene.graph().nodes())
+    bounds |= QRectF(scene.graph().getNodePosition(*node), scene.getNodeSize(*node));
+
+  view.setSceneRect(bounds);
+  view.fitInView(bounds, Qt::KeepAspectRatio);
+
+  double const fitted = timeFrames(view, frames, [&](qreal dx)
+  {
+    view.setSceneRect(bounds.translated(dx, 0.0));
+  });
+
+  log << "render fitted\t" << frames << " frames\t"
+      << QString::number(fitted, 'f', 3) << " ms/frame\n";
+
+  view.setSceneRect(bounds);
+  view.resetTransform();
+
+  double const zoomed = timeFrames(view, frames, [&](qreal dx)
+  {
+    view.centerOn(bounds.center() + QPointF(dx, 0.0));
+  });
+
+  log << "render 1:1\t" << frames << " frames\t"
+      << QString::number(zoomed, 'f', 3) << " ms/frame\n";
+
+  QSize const viewport = view.viewport()->size();
+
+  std::size_t found = 0;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for (int x = 0; x < hitTestGrid; ++x)
+  {
+    for (int y = 0; y < hitTestGrid; ++y)
+    {
+      QPoint const point(viewport.width() * x / hitTestGrid,
+                         viewport.height() * y / hitTestGrid);
+
+      found += view.items(point).size();
+    }
+  }
+
+  qint64 const elapsed = timer.nsecsElapsed();
+
+  log << "hit test\t" << hitTestGrid * hitTestGrid << " points\t"
+      << QString::number(elapsed / 1e3 / (hitTestGrid * hitTestGrid), 'f', 3)
+      << " us/point, " << found << " items found\n";
+
+  return true;
+}
+
+
+int
+main(int argc, char * argv[])
+{
+  std::unique_ptr<QCoreApplication> app;
+
+  // Only the view needs widgets, and a platform for them
+  if (renderingRequested(argc, argv))
+  {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    app.reset(new QApplication(argc, argv));
+  }
+  else
+  {
+    app.reset(new QCoreApplication(argc, argv));
+  }
+
+  QCoreApplication::setApplicationName("NodeEditorRunner");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Evaluates a saved flow and writes its sink outputs.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("scene", "The .flow file to evaluate.");
+
+  QCommandLineOption pluginOption({ "p", "plugin" },
+                                  "Shared library registering models.", "library");
+  QCommandLineOption outputOption({ "o", "output" },
+                                  "Sink outputs file, stdout by default.", "file");
+  QCommandLineOption timeoutOption("timeout",
+                                   "Give up waiting for the evaluation after this long.", "seconds");
+
+  QCommandLineOption renderOption("render",
+                                  "Time this many repaints of the scene in a view.", "frames");
+  QCommandLineOption openGLOption("opengl",
+                                  "Render through an OpenGL viewport.");
+  QCommandLineOption layerOption("connection-layer",
+                                 "Draw the connections through the connection layer, "
+                                 "which the OpenGL viewport always does.");
+
+  QCommandLineOption formatsOption("time-formats",
+                                   "Time saving and loading the graph in each format.");
+  QCommandLineOption teardownOption("time-teardown",
+                                    "Time clearing the graph against deleting it item by item.");
+  QCommandLineOption deleteOption("time-delete",
+                                  "Time removing half the nodes in one batch against one by one.");
+
+  parser.addOption(pluginOption);
+  parser.addOption(outputOption);
+  parser.addOption(timeoutOption);
+  parser.addOption(renderOption);
+  parser.addOption(openGLOption);
+  parser.addOption(layerOption);
+  parser.addOption(formatsOption);
+  parser.addOption(teardownOption);
+  parser.addOption(deleteOption);
+
+  parser.process(*app);
+
+  QTextStream log(stderr);
+
+  if (parser.positionalArguments().size() != 1)
+  {
+    parser.showHelp(1);
+  }
+
+  auto registry = std::make_shared<DataModelRegistry>();
+
+  for (QString const & plugin : parser.values(pluginOption))
+  {
+    if (!loadPlugin(plugin, *registry, log))
+      return 1;
+  }
+
+  QString const sceneFileName = parser.positionalArguments().first();
+
+  QFile sceneFile(sceneFileName);
+
+  if (!sceneFile.open(QIODevice::ReadOnly))
+  {
+    log << "Cannot open " << sceneFileName << '\n';
+    return 1;
+  }
+
+  FlowGraph graph(registry);
+  graph.setProfiling(true);
+
+  QElapsedTimer wallTime;
+  wallTime.start();
+
+  try
+  {
+    graph.loadFromMemory(sceneFile.readAll());
+  }
+  catch (std::exception const & e)
+  {
+    log << "Cannot load " << sceneFileName << ": " << e.what() << '\n';
+    return 1;
+  }
+
+  QDeadlineTimer const deadline = parser.isSet(timeoutOption) ?
+                                 QDeadlineTimer(parser.value(timeoutOption).toInt() * 1000) :
+                                 QDeadlineTimer(QDeadlineTimer::Forever);
+
+  // Queued updates, converters and models reporting back from other threads
+  if (!waitForIdle(graph, deadline))
+  {
+    log << "Timed out waiting for " << sceneFileName << " to be evaluated\n";
+    return 1;
+  }
+
+  qint64 const elapsed = wallTime.nsecsElapsed();
+
+  QJsonArray sinksJson;
+
+  log << "node\tmodel\tevaluations\tms\n";
+
+  auto report = [&](Node * node)
+  {
+    NodeDataModel * model = node->nodeDataModel();
+
+    log << node->id().toString() << '\t'
+        << model->name() << '\t'
+        << node->evaluationCount() << '\t'
+        << QString::number(node->evaluationTime() / 1e6, 'f', 3) << '\n';
+
+    auto const & outEntries = node->nodeState().getEntries(PortType::Out);
+
+    bool const sink = std::all_of(outEntries.begin(), outEntries.end(),
+                                  [](QtNodes::NodeState::ConnectionPtrSet const & connections)
+                                  { return connections.empty(); });
+
+    if (sink)
+      sinksJson.append(saveSink(*node));
+  };
+
+  graph.iterateOverNodeDataDependentOrder([&](NodeDataModel * model)
+  {
+    report(model->parent);
+  });
+
+  // Left out of the dependent order
+  std::vector<Node*> const cyclic = graph.nodesInCycles();
+
+  if (!cyclic.empty())
+  {
+    log << "warning: the graph has cycles\n";
+
+    for (Node * node : cyclic)
+      report(node);
+  }
+
+  log << "total\t\t\t" << QString::number(elapsed / 1e6, 'f', 3) << '\n';
+
+  FlowGraph::LoadStatistics const & statistics = graph.lastLoadStatistics();
+
+  log << "inputs fed " << statistics.evaluations
+      << ", saved by deferring propagation " << statistics.savedEvaluations << '\n';
+
+  log << "connections " << graph.connections().size()
+      << ", " << graph.connectionBlockSize() << " B pooled each\n";
+
+  if (parser.isSet(formatsOption) && !timeFormats(graph, registry, log))
+    return 1;
+
+  if (parser.isSet(teardownOption))
+    timeTeardown(graph, registry, log);
+
+  if (parser.isSet(deleteOption))
+    timeDelete(graph, registry, log);
+
+  if (parser.isSet(renderOption))
+  {
+    FlowView::Rendering const rendering = parser.isSet(openGLOption) ?
+                                          FlowView::Rendering::OpenGL :
+                                          FlowView::Rendering::Raster;
+
+    // Gives the graph its graphics until it goes
+    FlowScene scene(graph);
+
+    scene.setConnectionLayerEnabled(parser.isSet(layerOption));
+
+    if (!timeRendering(scene, parser.value(renderOption).toInt(), rendering, log))
+      return 1;
+  }
+
+  QJsonObject outputJson;
+  outputJson["sinks"] = sinksJson;
+
+  QByteArray const output = QJsonDocument(outputJson).toJson();
+
+  if (parser.isSet(outputOption))
+  {
+    QFile outputFile(parser.value(outputOption));
+
+    if (!outputFile.open(QIODevice::WriteOnly) ||
+        outputFile.write(output) != output.size())
+    {
+      log << "Cannot write " << outputFile.fileName() << '\n';
+      return 1;
+    }
+  }
+  else
+  {
+    std::fwrite(output.constData(), 1, output.size(), stdout);
+  }
+
+  return 0;
+}